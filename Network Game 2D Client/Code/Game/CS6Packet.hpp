@@ -2,8 +2,14 @@
 #ifndef INCLUDED_CS6_PACKET_HPP
 #define INCLUDED_CS6_PACKET_HPP
 
+//-----------------------------------------------------------------------------------------------
+#include <stddef.h>
+#include "SequenceNumber.hpp"
+
 //Communication Protocol:
 //   Client->Server: Ack
+//   Server->Client: Challenge (new clients only)
+//   Client->Server: Ack echoing the challenge cookie
 //   Server->Client: Reset
 //   Client->Server: Ack
 
@@ -19,19 +25,35 @@
 //   ALL Clients->Server: Ack
 //   Server->ALL Clients: Reset
 
+//Client updates also repeat the states from the client's last few updates, so the server still
+//gets the states of isolated lost packets. Nothing else sends those bytes at all
+
+//On a lossy link the server also follows a session's reliable packets with Parity, the XOR of
+//up to MAX_PARITY_GROUP_PACKETS of them, so the client can rebuild any one that went missing
+
+//Acks for Reset, GameOver and Victory ride in the header of the next packet going the same way
+//when one is due within a few milliseconds, and are only sent as their own Ack packet otherwise
+
 //-----------------------------------------------------------------------------------------------
 typedef unsigned char PacketType;
+static const PacketType TYPE_None = 0;
 static const PacketType TYPE_Acknowledge = 10;
 static const PacketType TYPE_Victory = 11;
 static const PacketType TYPE_Update = 12;
 static const PacketType TYPE_Reset = 13;
 static const PacketType TYPE_GameOver = 14;
+static const PacketType TYPE_Challenge = 15;
+static const PacketType TYPE_Parity = 16;
+static const unsigned short INVALID_PLAYER_ID = 0xffff;
+static const unsigned int MAX_PREVIOUS_UPDATE_STATES = 3;
+static const unsigned int MAX_PARITY_GROUP_PACKETS = 4;
 
 //-----------------------------------------------------------------------------------------------
 struct AckPacketGame
 {
 	PacketType packetType;
-	unsigned int packetNumber;
+	SequenceNumber packetNumber;
+	unsigned long long cookie;
 };
 
 //-----------------------------------------------------------------------------------------------
@@ -58,12 +80,30 @@ struct UpdatePacketGame
 	//range 0-359
 };
 
+//-----------------------------------------------------------------------------------------------
+//An earlier state, as its difference from the state sent after it. Positions and velocities are in
+//eighths of a pixel
+struct PreviousStateGame
+{
+	unsigned short millisecondsEarlier;
+	short xPositionDelta;
+	short yPositionDelta;
+	short xVelocityDelta;
+	short yVelocityDelta;
+};
+
 //-----------------------------------------------------------------------------------------------
 struct VictoryPacketGame
 {
 	unsigned char playerColorAndID[ 3 ];
 };
 
+//-----------------------------------------------------------------------------------------------
+struct ChallengePacketGame
+{
+	unsigned long long cookie;
+};
+
 
 
 //-----------------------------------------------------------------------------------------------
@@ -73,22 +113,61 @@ struct CS6Packet
 
 	PacketType packetType;
 	unsigned char playerColorAndID[ 3 ];
-	unsigned int packetNumber;
+	SequenceNumber packetNumber;
+	//Identity of the player the packet is about. The color bytes above are only for drawing
+	unsigned short playerID;
 	double timestamp;
+	//Newest timestamp the sender has from the receiver, and how long it held it before sending
+	//this one. Zero until it has heard anything. Lets each side estimate the other's clock
+	double echoTimestamp;
+	float echoHoldSeconds;
+	//Type and number of a reliable packet from the receiver that this one also acks, with the
+	//type TYPE_None when it carries no ack
+	PacketType ackedPacketType;
+	SequenceNumber ackedPacketNumber;
 	union PacketData
 	{
 		AckPacketGame acknowledged;
 		ResetPacketGame reset;
 		UpdatePacketGame updated;
 		VictoryPacketGame victorious;
+		ChallengePacketGame challenge;
 	} data;
+	//Only sent on client updates, newest first, and only as far as numPreviousStates reaches
+	unsigned char numPreviousStates;
+	PreviousStateGame previousStates[ MAX_PREVIOUS_UPDATE_STATES ];
+};
+
+//-----------------------------------------------------------------------------------------------
+static const unsigned int CS6_PACKET_BYTES_WITHOUT_HISTORY = offsetof( CS6Packet, numPreviousStates );
+
+//-----------------------------------------------------------------------------------------------
+//Not a CS6Packet: only the type byte is shared, and it carries no sequence number of its own.
+//parityBytes is the XOR of the listed packets exactly as they were sent, none of which are updates
+struct CS6ParityPacket
+{
+	PacketType packetType;
+	unsigned char numPackets;
+	SequenceNumber packetNumbers[ MAX_PARITY_GROUP_PACKETS ];
+	unsigned char parityBytes[ CS6_PACKET_BYTES_WITHOUT_HISTORY ];
 };
 
 
 //-----------------------------------------------------------------------------------------------
 inline bool CS6Packet::operator<( const CS6Packet& other ) const
 {
-	return this->packetNumber < other.packetNumber;
+	return IsSequenceMoreRecent( other.packetNumber, this->packetNumber );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The packet type is checked first, so numPreviousStates only has to be set on updates
+inline unsigned int GetNumberOfBytesToSend( const CS6Packet& packet )
+{
+	if( packet.packetType != TYPE_Update || packet.numPreviousStates == 0 )
+		return CS6_PACKET_BYTES_WITHOUT_HISTORY;
+
+	return offsetof( CS6Packet, previousStates ) + packet.numPreviousStates * sizeof( PreviousStateGame );
 }
 
 #endif //INCLUDED_CS6_PACKET_HPP
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include "ClockSync.hpp"
+#include <math.h>
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+ClockSync::ClockSync()
+{
+	Reset();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ClockSync::Reset()
+{
+	m_numSamples = 0;
+	m_nextSampleIndex = 0;
+	m_lastSampleTime = 0.0;
+	m_lastRemoteSendTime = 0.0;
+	m_lastRemoteArrivalTime = 0.0;
+	m_offsetSeconds = 0.0;
+	m_offsetReferenceTime = 0.0;
+	m_driftRate = 0.0;
+	m_roundTripSeconds = 0.0;
+	m_errorBoundSeconds = 0.0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ClockSync::ReceiveTimestamps( double remoteSendTime, double echoedLocalTime, float echoHoldSeconds, double localArrivalTime )
+{
+	//Only the newest packet from the peer is echoed back, so a late arrival doesn't replace it
+	if( remoteSendTime > m_lastRemoteSendTime )
+	{
+		m_lastRemoteSendTime = remoteSendTime;
+		m_lastRemoteArrivalTime = localArrivalTime;
+	}
+
+	//Zero means the peer had nothing of ours to echo yet
+	if( echoedLocalTime <= 0.0 || echoedLocalTime > localArrivalTime )
+		return;
+
+	if( m_numSamples > 0 && ( localArrivalTime - m_lastSampleTime ) < MIN_SECONDS_BETWEEN_CLOCK_SYNC_SAMPLES )
+		return;
+
+	double remoteReceiveTime = remoteSendTime - echoHoldSeconds;
+	double roundTripSeconds = ( localArrivalTime - echoedLocalTime ) - echoHoldSeconds;
+	if( roundTripSeconds > MAX_CLOCK_SYNC_ROUND_TRIP_SECONDS )
+		return;
+
+	if( roundTripSeconds < 0.0 )
+		roundTripSeconds = 0.0;
+
+	ClockSyncSample& sample = m_samples[ m_nextSampleIndex ];
+	sample.m_localTime = ( echoedLocalTime + localArrivalTime ) * 0.5;
+	sample.m_offsetSeconds = ( ( remoteReceiveTime - echoedLocalTime ) + ( remoteSendTime - localArrivalTime ) ) * 0.5;
+	sample.m_roundTripSeconds = roundTripSeconds;
+
+	m_nextSampleIndex = ( m_nextSampleIndex + 1 ) % NUM_CLOCK_SYNC_SAMPLES;
+	if( m_numSamples < NUM_CLOCK_SYNC_SAMPLES )
+		++m_numSamples;
+
+	m_lastSampleTime = localArrivalTime;
+	UpdateEstimate();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ClockSync::GetEchoTimestamps( double localSendTime, double& out_echoTimestamp, float& out_echoHoldSeconds ) const
+{
+	if( m_lastRemoteSendTime <= 0.0 )
+	{
+		out_echoTimestamp = 0.0;
+		out_echoHoldSeconds = 0.f;
+		return;
+	}
+
+	out_echoTimestamp = m_lastRemoteSendTime;
+	out_echoHoldSeconds = (float) ( localSendTime - m_lastRemoteArrivalTime );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ClockSync::HasEstimate() const
+{
+	return m_numSamples > 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double ClockSync::GetOffsetSeconds( double localTime ) const
+{
+	return m_offsetSeconds + m_driftRate * ( localTime - m_offsetReferenceTime );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double ClockSync::GetDriftRate() const
+{
+	return m_driftRate;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double ClockSync::GetRoundTripSeconds() const
+{
+	return m_roundTripSeconds;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//How far off the offset may be: half the best round trip, since the exchange can't tell which
+//leg the delay was spent on, plus the scatter of the samples around the fitted drift
+double ClockSync::GetErrorBoundSeconds() const
+{
+	return m_errorBoundSeconds;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double ClockSync::ConvertRemoteToLocalTime( double remoteTime ) const
+{
+	double roughLocalTime = remoteTime - m_offsetSeconds;
+	return remoteTime - GetOffsetSeconds( roughLocalTime );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double ClockSync::ConvertLocalToRemoteTime( double localTime ) const
+{
+	return localTime + GetOffsetSeconds( localTime );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double ClockSync::GetSampleWeight( const ClockSyncSample& sample, double bestRoundTripSeconds ) const
+{
+	double extraDelaySeconds = sample.m_roundTripSeconds - bestRoundTripSeconds + MIN_CLOCK_SYNC_ROUND_TRIP_WEIGHTING_SECONDS;
+	return 1.0 / ( extraDelaySeconds * extraDelaySeconds );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ClockSync::UpdateEstimate()
+{
+	//Queueing only ever adds delay, so the sample with the shortest round trip has the least
+	//asymmetry in it and anchors the offset
+	const ClockSyncSample* bestSample = &m_samples[ 0 ];
+	double oldestTime = m_samples[ 0 ].m_localTime;
+	double newestTime = m_samples[ 0 ].m_localTime;
+	for( unsigned int sampleIndex = 0; sampleIndex < m_numSamples; ++sampleIndex )
+	{
+		const ClockSyncSample& sample = m_samples[ sampleIndex ];
+		if( sample.m_roundTripSeconds < bestSample->m_roundTripSeconds )
+			bestSample = &sample;
+
+		if( sample.m_localTime < oldestTime )
+			oldestTime = sample.m_localTime;
+		if( sample.m_localTime > newestTime )
+			newestTime = sample.m_localTime;
+	}
+
+	//Drift is the slope of offset over time, fitted by least squares once the samples span long
+	//enough for it to rise above the noise. Samples are weighted by how quick their round trip
+	//was, for the same reason the quickest one anchors the offset
+	m_driftRate = 0.0;
+	if( ( newestTime - oldestTime ) >= MIN_SECONDS_FOR_CLOCK_DRIFT_ESTIMATE )
+	{
+		double totalWeight = 0.0;
+		double meanTime = 0.0;
+		double meanOffset = 0.0;
+		for( unsigned int sampleIndex = 0; sampleIndex < m_numSamples; ++sampleIndex )
+		{
+			double weight = GetSampleWeight( m_samples[ sampleIndex ], bestSample->m_roundTripSeconds );
+			totalWeight += weight;
+			meanTime += weight * ( m_samples[ sampleIndex ].m_localTime - oldestTime );
+			meanOffset += weight * m_samples[ sampleIndex ].m_offsetSeconds;
+		}
+
+		meanTime = oldestTime + meanTime / totalWeight;
+		meanOffset /= totalWeight;
+
+		double covariance = 0.0;
+		double variance = 0.0;
+		for( unsigned int sampleIndex = 0; sampleIndex < m_numSamples; ++sampleIndex )
+		{
+			double weight = GetSampleWeight( m_samples[ sampleIndex ], bestSample->m_roundTripSeconds );
+			double timeFromMean = m_samples[ sampleIndex ].m_localTime - meanTime;
+			covariance += weight * timeFromMean * ( m_samples[ sampleIndex ].m_offsetSeconds - meanOffset );
+			variance += weight * timeFromMean * timeFromMean;
+		}
+
+		m_driftRate = covariance / variance;
+		if( m_driftRate > MAX_CLOCK_DRIFT_RATE )
+			m_driftRate = MAX_CLOCK_DRIFT_RATE;
+		else if( m_driftRate < -MAX_CLOCK_DRIFT_RATE )
+			m_driftRate = -MAX_CLOCK_DRIFT_RATE;
+	}
+
+	m_offsetSeconds = bestSample->m_offsetSeconds;
+	m_offsetReferenceTime = bestSample->m_localTime;
+	m_roundTripSeconds = bestSample->m_roundTripSeconds;
+
+	double sumSquaredError = 0.0;
+	for( unsigned int sampleIndex = 0; sampleIndex < m_numSamples; ++sampleIndex )
+	{
+		double error = m_samples[ sampleIndex ].m_offsetSeconds - GetOffsetSeconds( m_samples[ sampleIndex ].m_localTime );
+		sumSquaredError += error * error;
+	}
+
+	m_errorBoundSeconds = m_roundTripSeconds * 0.5 + sqrt( sumSquaredError / m_numSamples );
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef include_ClockSync
+#define include_ClockSync
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int NUM_CLOCK_SYNC_SAMPLES = 64;
+const double MIN_SECONDS_BETWEEN_CLOCK_SYNC_SAMPLES = 1.0;
+const double MAX_CLOCK_SYNC_ROUND_TRIP_SECONDS = 2.0;
+const double MIN_SECONDS_FOR_CLOCK_DRIFT_ESTIMATE = 30.0;
+const double MIN_CLOCK_SYNC_ROUND_TRIP_WEIGHTING_SECONDS = 0.001;
+const double MAX_CLOCK_DRIFT_RATE = 0.0005;
+
+
+//-----------------------------------------------------------------------------------------------
+struct ClockSyncSample
+{
+	double	m_localTime;
+	double	m_offsetSeconds;
+	double	m_roundTripSeconds;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//NTP-style estimate of how far a peer's clock runs from ours, where the offset is remote time
+//minus local time. Each packet carries its send time plus an echo of the newest timestamp it has
+//from us and how long it held it, which gives all four timestamps of an NTP exchange for free
+class ClockSync
+{
+public:
+	ClockSync();
+	void Reset();
+	void ReceiveTimestamps( double remoteSendTime, double echoedLocalTime, float echoHoldSeconds, double localArrivalTime );
+	void GetEchoTimestamps( double localSendTime, double& out_echoTimestamp, float& out_echoHoldSeconds ) const;
+	bool HasEstimate() const;
+	double GetOffsetSeconds( double localTime ) const;
+	double GetDriftRate() const;
+	double GetRoundTripSeconds() const;
+	double GetErrorBoundSeconds() const;
+	double ConvertRemoteToLocalTime( double remoteTime ) const;
+	double ConvertLocalToRemoteTime( double localTime ) const;
+
+private:
+	double GetSampleWeight( const ClockSyncSample& sample, double bestRoundTripSeconds ) const;
+	void UpdateEstimate();
+
+	ClockSyncSample		m_samples[ NUM_CLOCK_SYNC_SAMPLES ];
+	unsigned int		m_numSamples;
+	unsigned int		m_nextSampleIndex;
+	double				m_lastSampleTime;
+	double				m_lastRemoteSendTime;
+	double				m_lastRemoteArrivalTime;
+	double				m_offsetSeconds;
+	double				m_offsetReferenceTime;
+	double				m_driftRate;
+	double				m_roundTripSeconds;
+	double				m_errorBoundSeconds;
+};
+
+
+#endif // include_ClockSync
\ No newline at end of file
@@ -238,6 +238,14 @@ bool ConsoleFunctionShowLobbyGames( const ConsoleCommandArgs& )
 }
 
 
+//-----------------------------------------------------------------------------------------------
+bool ConsoleFunctionShowClockSync( const ConsoleCommandArgs& )
+{
+	g_game.m_world.ShowClockSync();
+	return true;
+}
+
+
 //-----------------------------------------------------------------------------------------------
 bool ConsoleFunctionCreateLobbyGame( const ConsoleCommandArgs& )
 {
@@ -319,6 +327,7 @@ void LoadDeveloperConsole()
 	g_developerConsole.AddCommandFuncPtr( "changeIP", ConsoleFunctionChangeIP );
 	g_developerConsole.AddCommandFuncPtr( "changePort", ConsoleFunctionChangePortNumber );
 	g_developerConsole.AddCommandFuncPtr( "showGames", ConsoleFunctionShowLobbyGames );
+	g_developerConsole.AddCommandFuncPtr( "showClock", ConsoleFunctionShowClockSync );
 	g_developerConsole.AddCommandFuncPtr( "createGame", ConsoleFunctionCreateLobbyGame );
 	g_developerConsole.AddCommandFuncPtr( "joinGame", ConsoleFunctionJoinLobbyGame );
 }
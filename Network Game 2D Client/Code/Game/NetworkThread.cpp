@@ -0,0 +1,113 @@
+#include "NetworkThread.hpp"
+#include <process.h>
+#include "../Engine/Time.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+void NetworkThreadEntryFunc( void* data )
+{
+	NetworkThread* networkThread = static_cast< NetworkThread* >( data );
+
+	while( networkThread->m_isRunning )
+	{
+		if( networkThread->m_client->WaitForPacketFromServer( NETWORK_THREAD_WAIT_MICROSECONDS ) )
+			networkThread->ReceivePackets();
+	}
+
+	SetEvent( networkThread->m_exitedEvent );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+NetworkThread::NetworkThread()
+	: m_client( nullptr )
+	, m_nextPacketNumber( 0 )
+	, m_isRunning( 0 )
+	, m_exitedEvent( NULL )
+	, m_numDroppedPackets( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void NetworkThread::Start( UDPClient* client )
+{
+	m_client = client;
+	m_exitedEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+	InterlockedExchange( &m_isRunning, 1 );
+
+	_beginthread( NetworkThreadEntryFunc, 0, this );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Blocks until the thread has let go of the socket, so the caller is free to close it afterwards
+void NetworkThread::Stop()
+{
+	if( !m_isRunning )
+		return;
+
+	InterlockedExchange( &m_isRunning, 0 );
+	WaitForSingleObject( m_exitedEvent, INFINITE );
+	CloseHandle( m_exitedEvent );
+	m_exitedEvent = NULL;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Handed out atomically so any thread can stamp an outgoing packet
+SequenceNumber NetworkThread::TakeNextPacketNumber()
+{
+	return (SequenceNumber) ( InterlockedIncrement( &m_nextPacketNumber ) - 1 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const ReceivedPacket* NetworkThread::PeekReceivedPacket() const
+{
+	return m_receivedPackets.PeekElement();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void NetworkThread::PopReceivedPacket()
+{
+	m_receivedPackets.PopElement();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int NetworkThread::GetNumberOfDroppedPackets() const
+{
+	return m_numDroppedPackets;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void NetworkThread::ReceivePackets()
+{
+	ReceivedPacket overflowPacket;
+	for( ;; )
+	{
+		//With the queue full the packet still has to come off the socket, but it is dropped
+		//unacknowledged so the server sends it again
+		ReceivedPacket* receivedPacket = m_receivedPackets.GetNextElementToFill();
+		bool isQueueFull = ( receivedPacket == nullptr );
+		if( isQueueFull )
+			receivedPacket = &overflowPacket;
+
+		if( !m_client->ReceivePacketFromServer( receivedPacket->m_bytes, sizeof( receivedPacket->m_bytes ) ) )
+			return;
+
+		if( isQueueFull )
+		{
+			++m_numDroppedPackets;
+			continue;
+		}
+
+		receivedPacket->m_arrivalTimeSeconds = GetCurrentTimeSeconds();
+		m_receivedPackets.PushElement();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef include_NetworkThread
+#define include_NetworkThread
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "UDPClient.hpp"
+#include "CS6Packet.hpp"
+#include "SPSCQueue.hpp"
+#include "LobbyPacket.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int RECEIVED_PACKET_QUEUE_CAPACITY = 1024;
+const long NETWORK_THREAD_WAIT_MICROSECONDS = 1000;
+const unsigned int MAX_RECEIVED_PACKET_BYTES = sizeof( CS6Packet ) > sizeof( LobbyPacket ) ? sizeof( CS6Packet ) : sizeof( LobbyPacket );
+
+
+//-----------------------------------------------------------------------------------------------
+//The network thread doesn't know whether we are in the lobby or a game, so the main thread
+//decides which view of the packet to read
+struct ReceivedPacket
+{
+	union
+	{
+		CS6Packet		m_gamePacket;
+		CS6ParityPacket	m_parityPacket;
+		LobbyPacket		m_lobbyPacket;
+		char			m_bytes[ MAX_RECEIVED_PACKET_BYTES ];
+	};
+	double				m_arrivalTimeSeconds;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+void NetworkThreadEntryFunc( void* data );
+
+
+//-----------------------------------------------------------------------------------------------
+//Drains the client socket on its own thread, so packets are stamped when they arrive rather than
+//when the next frame gets to them
+class NetworkThread
+{
+	friend void NetworkThreadEntryFunc( void* data );
+
+public:
+	NetworkThread();
+	void Start( UDPClient* client );
+	void Stop();
+	SequenceNumber TakeNextPacketNumber();
+	const ReceivedPacket* PeekReceivedPacket() const;
+	void PopReceivedPacket();
+	unsigned int GetNumberOfDroppedPackets() const;
+
+private:
+	void ReceivePackets();
+
+	UDPClient*														m_client;
+	SPSCQueue< ReceivedPacket, RECEIVED_PACKET_QUEUE_CAPACITY >		m_receivedPackets;
+	volatile LONG													m_nextPacketNumber;
+	volatile LONG													m_isRunning;
+	HANDLE															m_exitedEvent;
+	unsigned int													m_numDroppedPackets;
+};
+
+
+#endif // include_NetworkThread
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "ParityGroup.hpp"
+#include <string.h>
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+ParityEncoder::ParityEncoder()
+{
+	Clear();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ParityEncoder::Clear()
+{
+	memset( &m_parityPacket, 0, sizeof( m_parityPacket ) );
+	m_parityPacket.packetType = TYPE_Parity;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Returns true once the group is full and should be sent
+bool ParityEncoder::AddPacket( const CS6Packet& packet )
+{
+	if( m_parityPacket.numPackets >= MAX_PARITY_GROUP_PACKETS )
+		return true;
+
+	const unsigned char* packetBytes = (const unsigned char*) &packet;
+	for( unsigned int byteIndex = 0; byteIndex < CS6_PACKET_BYTES_WITHOUT_HISTORY; ++byteIndex )
+	{
+		m_parityPacket.parityBytes[ byteIndex ] ^= packetBytes[ byteIndex ];
+	}
+
+	m_parityPacket.packetNumbers[ m_parityPacket.numPackets ] = packet.packetNumber;
+	++m_parityPacket.numPackets;
+
+	return m_parityPacket.numPackets == MAX_PARITY_GROUP_PACKETS;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ParityEncoder::IsEmpty() const
+{
+	return m_parityPacket.numPackets == 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Hands over the group so far and starts a new one
+void ParityEncoder::TakeParityPacket( CS6ParityPacket& out_parityPacket )
+{
+	out_parityPacket = m_parityPacket;
+	Clear();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+ParityDecoder::ParityDecoder()
+{
+	Clear();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ParityDecoder::Clear()
+{
+	m_numRememberedPackets = 0;
+	m_nextSlot = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ParityDecoder::RememberPacket( const CS6Packet& packet )
+{
+	memcpy( m_packetBytes[ m_nextSlot ], &packet, CS6_PACKET_BYTES_WITHOUT_HISTORY );
+	m_packetNumbers[ m_nextSlot ] = packet.packetNumber;
+	m_nextSlot = ( m_nextSlot + 1 ) % NUM_REMEMBERED_PARITY_PACKETS;
+	if( m_numRememberedPackets < NUM_REMEMBERED_PARITY_PACKETS )
+		++m_numRememberedPackets;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//False unless exactly one packet of the group is missing. The rebuilt packet is remembered too,
+//so a second parity packet naming it won't rebuild it again
+bool ParityDecoder::RebuildMissingPacket( const CS6ParityPacket& parityPacket, CS6Packet& out_packet )
+{
+	if( parityPacket.numPackets == 0 || parityPacket.numPackets > MAX_PARITY_GROUP_PACKETS )
+		return false;
+
+	unsigned char rebuiltBytes[ CS6_PACKET_BYTES_WITHOUT_HISTORY ];
+	memcpy( rebuiltBytes, parityPacket.parityBytes, CS6_PACKET_BYTES_WITHOUT_HISTORY );
+
+	unsigned int numMissingPackets = 0;
+	SequenceNumber missingPacketNumber = 0;
+	for( unsigned int groupIndex = 0; groupIndex < parityPacket.numPackets; ++groupIndex )
+	{
+		int slot = FindRememberedPacket( parityPacket.packetNumbers[ groupIndex ] );
+		if( slot < 0 )
+		{
+			++numMissingPackets;
+			missingPacketNumber = parityPacket.packetNumbers[ groupIndex ];
+			continue;
+		}
+
+		for( unsigned int byteIndex = 0; byteIndex < CS6_PACKET_BYTES_WITHOUT_HISTORY; ++byteIndex )
+		{
+			rebuiltBytes[ byteIndex ] ^= m_packetBytes[ slot ][ byteIndex ];
+		}
+	}
+
+	if( numMissingPackets != 1 )
+		return false;
+
+	memset( &out_packet, 0, sizeof( out_packet ) );
+	memcpy( &out_packet, rebuiltBytes, CS6_PACKET_BYTES_WITHOUT_HISTORY );
+	if( out_packet.packetNumber != missingPacketNumber || out_packet.packetType == TYPE_Update )
+		return false;
+
+	RememberPacket( out_packet );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int ParityDecoder::FindRememberedPacket( SequenceNumber packetNumber ) const
+{
+	for( unsigned int slot = 0; slot < m_numRememberedPackets; ++slot )
+	{
+		if( m_packetNumbers[ slot ] == packetNumber )
+			return (int) slot;
+	}
+
+	return -1;
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef include_ParityGroup
+#define include_ParityGroup
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "CS6Packet.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int NUM_REMEMBERED_PARITY_PACKETS = 16;
+
+
+//-----------------------------------------------------------------------------------------------
+//Folds the reliable packets sent to one client into a running XOR until the group is full or
+//the sender decides to close it early
+class ParityEncoder
+{
+public:
+	ParityEncoder();
+	void Clear();
+	bool AddPacket( const CS6Packet& packet );
+	bool IsEmpty() const;
+	void TakeParityPacket( CS6ParityPacket& out_parityPacket );
+
+private:
+	CS6ParityPacket		m_parityPacket;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Keeps the last few reliable packets that arrived, so a parity packet missing exactly one of
+//its group can give that one back
+class ParityDecoder
+{
+public:
+	ParityDecoder();
+	void Clear();
+	void RememberPacket( const CS6Packet& packet );
+	bool RebuildMissingPacket( const CS6ParityPacket& parityPacket, CS6Packet& out_packet );
+
+private:
+	int FindRememberedPacket( SequenceNumber packetNumber ) const;
+
+	unsigned char		m_packetBytes[ NUM_REMEMBERED_PARITY_PACKETS ][ CS6_PACKET_BYTES_WITHOUT_HISTORY ];
+	SequenceNumber		m_packetNumbers[ NUM_REMEMBERED_PARITY_PACKETS ];
+	unsigned int		m_numRememberedPackets;
+	unsigned int		m_nextSlot;
+};
+
+
+#endif // include_ParityGroup
\ No newline at end of file
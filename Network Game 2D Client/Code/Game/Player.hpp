@@ -10,13 +10,13 @@
 //-----------------------------------------------------------------------------------------------
 struct Player
 {
-	Color3b		m_color;
-	Vector2		m_currentPosition;
-	Vector2		m_lastUpdatePosition;
-	Vector2		m_currentVelocity;
-	Vector2		m_lastUpdateVelocity;
-	float		m_orientationDegrees;
-	double		m_timeOfLastUpdate;
+	unsigned short	m_playerID;
+	Color3b			m_color;
+	Vector2			m_currentPosition;
+	Vector2			m_lastUpdatePosition;
+	Vector2			m_currentVelocity;
+	float			m_orientationDegrees;
+	double			m_timeOfLastUpdate;
 };
 
 
@@ -0,0 +1,140 @@
+#ifndef include_ReceiveBatch
+#define include_ReceiveBatch
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "SequenceNumber.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int MAX_PACKETS_PER_RECEIVE_BATCH = 256;
+
+
+//-----------------------------------------------------------------------------------------------
+//Fixed-size buffer that one frame's received packets are drained into, each with the time it
+//arrived. Packets are ordered through an index array, so draining never allocates
+template< typename T_PacketType >
+class ReceiveBatch
+{
+public:
+	ReceiveBatch();
+	void Clear();
+	T_PacketType* GetNextPacketToFill();
+	void CommitPacket( double arrivalTimeSeconds );
+	void SortPackets();
+	unsigned int GetNumberOfPackets() const;
+	const T_PacketType& GetPacket( unsigned int orderIndex ) const;
+	double GetArrivalTime( unsigned int orderIndex ) const;
+
+private:
+	struct PacketOrder
+	{
+		PacketOrder( const ReceiveBatch* batch ) : m_batch( batch ) {}
+		bool operator()( unsigned short lhs, unsigned short rhs ) const;
+
+		const ReceiveBatch*		m_batch;
+	};
+
+	T_PacketType	m_packets[ MAX_PACKETS_PER_RECEIVE_BATCH ];
+	double			m_arrivalTimes[ MAX_PACKETS_PER_RECEIVE_BATCH ];
+	unsigned short	m_order[ MAX_PACKETS_PER_RECEIVE_BATCH ];
+	unsigned int	m_numPackets;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+ReceiveBatch< T_PacketType >::ReceiveBatch()
+	: m_numPackets( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+void ReceiveBatch< T_PacketType >::Clear()
+{
+	m_numPackets = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+T_PacketType* ReceiveBatch< T_PacketType >::GetNextPacketToFill()
+{
+	if( m_numPackets >= MAX_PACKETS_PER_RECEIVE_BATCH )
+		return nullptr;
+
+	return &m_packets[ m_numPackets ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+void ReceiveBatch< T_PacketType >::CommitPacket( double arrivalTimeSeconds )
+{
+	m_arrivalTimes[ m_numPackets ] = arrivalTimeSeconds;
+	m_order[ m_numPackets ] = (unsigned short) m_numPackets;
+	++m_numPackets;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+void ReceiveBatch< T_PacketType >::SortPackets()
+{
+	//Insertion sort: batches arrive nearly in order, and it stays well behaved even when the
+	//wrapping sequence comparison is not a strict ordering across a whole batch
+	PacketOrder isOrderedBefore( this );
+	for( unsigned int sortIndex = 1; sortIndex < m_numPackets; ++sortIndex )
+	{
+		unsigned short packetIndex = m_order[ sortIndex ];
+		unsigned int insertIndex = sortIndex;
+		while( insertIndex > 0 && isOrderedBefore( packetIndex, m_order[ insertIndex - 1 ] ) )
+		{
+			m_order[ insertIndex ] = m_order[ insertIndex - 1 ];
+			--insertIndex;
+		}
+
+		m_order[ insertIndex ] = packetIndex;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+unsigned int ReceiveBatch< T_PacketType >::GetNumberOfPackets() const
+{
+	return m_numPackets;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+const T_PacketType& ReceiveBatch< T_PacketType >::GetPacket( unsigned int orderIndex ) const
+{
+	return m_packets[ m_order[ orderIndex ] ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+double ReceiveBatch< T_PacketType >::GetArrivalTime( unsigned int orderIndex ) const
+{
+	return m_arrivalTimes[ m_order[ orderIndex ] ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+bool ReceiveBatch< T_PacketType >::PacketOrder::operator()( unsigned short lhs, unsigned short rhs ) const
+{
+	if( m_batch->m_packets[ lhs ].packetNumber != m_batch->m_packets[ rhs ].packetNumber )
+		return IsSequenceMoreRecent( m_batch->m_packets[ rhs ].packetNumber, m_batch->m_packets[ lhs ].packetNumber );
+
+	return lhs < rhs;
+}
+
+
+#endif // include_ReceiveBatch
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "RemotePlayers.hpp"
+#include <emmintrin.h>
+#include "../Engine/MathFunctions.hpp"
+#include "../Engine/NewMacroDef.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+void RemotePlayers::Clear()
+{
+	m_playerIDs.clear();
+	m_timerIndices.clear();
+	m_colors.clear();
+	m_orientationDegrees.clear();
+	m_positionX.clear();
+	m_positionY.clear();
+	m_lastUpdatePositionX.clear();
+	m_lastUpdatePositionY.clear();
+	m_velocityX.clear();
+	m_velocityY.clear();
+	m_timeOfLastUpdate.clear();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int RemotePlayers::AddPlayer( unsigned short playerID, unsigned int timerIndex )
+{
+	m_playerIDs.push_back( playerID );
+	m_timerIndices.push_back( timerIndex );
+	m_colors.push_back( Color3b() );
+	m_orientationDegrees.push_back( 0.f );
+	m_positionX.push_back( 0.f );
+	m_positionY.push_back( 0.f );
+	m_lastUpdatePositionX.push_back( 0.f );
+	m_lastUpdatePositionY.push_back( 0.f );
+	m_velocityX.push_back( 0.f );
+	m_velocityY.push_back( 0.f );
+	m_timeOfLastUpdate.push_back( 0.0 );
+
+	return m_playerIDs.size() - 1;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Swaps the last player into the hole, so only the player that moved needs its index fixed up
+void RemotePlayers::RemovePlayerAtIndex( unsigned int playerIndex )
+{
+	unsigned int lastIndex = m_playerIDs.size() - 1;
+
+	m_playerIDs[ playerIndex ] = m_playerIDs[ lastIndex ];
+	m_timerIndices[ playerIndex ] = m_timerIndices[ lastIndex ];
+	m_colors[ playerIndex ] = m_colors[ lastIndex ];
+	m_orientationDegrees[ playerIndex ] = m_orientationDegrees[ lastIndex ];
+	m_positionX[ playerIndex ] = m_positionX[ lastIndex ];
+	m_positionY[ playerIndex ] = m_positionY[ lastIndex ];
+	m_lastUpdatePositionX[ playerIndex ] = m_lastUpdatePositionX[ lastIndex ];
+	m_lastUpdatePositionY[ playerIndex ] = m_lastUpdatePositionY[ lastIndex ];
+	m_velocityX[ playerIndex ] = m_velocityX[ lastIndex ];
+	m_velocityY[ playerIndex ] = m_velocityY[ lastIndex ];
+	m_timeOfLastUpdate[ playerIndex ] = m_timeOfLastUpdate[ lastIndex ];
+
+	m_playerIDs.pop_back();
+	m_timerIndices.pop_back();
+	m_colors.pop_back();
+	m_orientationDegrees.pop_back();
+	m_positionX.pop_back();
+	m_positionY.pop_back();
+	m_lastUpdatePositionX.pop_back();
+	m_lastUpdatePositionY.pop_back();
+	m_velocityX.pop_back();
+	m_velocityY.pop_back();
+	m_timeOfLastUpdate.pop_back();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int RemotePlayers::GetNumberOfPlayers() const
+{
+	return m_playerIDs.size();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Extrapolates every player from its last update and clamps it to the map. Update times stay in
+//double precision until the per-player delta is taken, so precision doesn't drift as the clock grows
+void RemotePlayers::ApplyDeadReckoning( double currentTimeSeconds, float maxX, float maxY )
+{
+	unsigned int numPlayers = m_playerIDs.size();
+	unsigned int playerIndex = 0;
+
+	__m128d currentTime = _mm_set1_pd( currentTimeSeconds );
+	__m128 minPosition = _mm_setzero_ps();
+	__m128 maxPositionX = _mm_set1_ps( maxX );
+	__m128 maxPositionY = _mm_set1_ps( maxY );
+	for( ; playerIndex + 4 <= numPlayers; playerIndex += 4 )
+	{
+		__m128d deltaSecondsLow = _mm_sub_pd( currentTime, _mm_loadu_pd( &m_timeOfLastUpdate[ playerIndex ] ) );
+		__m128d deltaSecondsHigh = _mm_sub_pd( currentTime, _mm_loadu_pd( &m_timeOfLastUpdate[ playerIndex + 2 ] ) );
+		__m128 deltaSeconds = _mm_movelh_ps( _mm_cvtpd_ps( deltaSecondsLow ), _mm_cvtpd_ps( deltaSecondsHigh ) );
+
+		__m128 positionX = _mm_add_ps( _mm_loadu_ps( &m_lastUpdatePositionX[ playerIndex ] ), _mm_mul_ps( _mm_loadu_ps( &m_velocityX[ playerIndex ] ), deltaSeconds ) );
+		__m128 positionY = _mm_add_ps( _mm_loadu_ps( &m_lastUpdatePositionY[ playerIndex ] ), _mm_mul_ps( _mm_loadu_ps( &m_velocityY[ playerIndex ] ), deltaSeconds ) );
+
+		_mm_storeu_ps( &m_positionX[ playerIndex ], _mm_min_ps( _mm_max_ps( positionX, minPosition ), maxPositionX ) );
+		_mm_storeu_ps( &m_positionY[ playerIndex ], _mm_min_ps( _mm_max_ps( positionY, minPosition ), maxPositionY ) );
+	}
+
+	for( ; playerIndex < numPlayers; ++playerIndex )
+	{
+		float deltaSeconds = (float) ( currentTimeSeconds - m_timeOfLastUpdate[ playerIndex ] );
+		float positionX = m_lastUpdatePositionX[ playerIndex ] + m_velocityX[ playerIndex ] * deltaSeconds;
+		float positionY = m_lastUpdatePositionY[ playerIndex ] + m_velocityY[ playerIndex ] * deltaSeconds;
+
+		m_positionX[ playerIndex ] = ClampFloat( positionX, 0.f, maxX );
+		m_positionY[ playerIndex ] = ClampFloat( positionY, 0.f, maxY );
+	}
+}
\ No newline at end of file
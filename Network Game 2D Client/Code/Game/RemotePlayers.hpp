@@ -0,0 +1,36 @@
+#ifndef include_RemotePlayers
+#define include_RemotePlayers
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <vector>
+#include "Color3b.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+//Every other player in the game, kept as parallel arrays so dead reckoning can stream through
+//positions, velocities and update times four players at a time
+class RemotePlayers
+{
+public:
+	void Clear();
+	unsigned int AddPlayer( unsigned short playerID, unsigned int timerIndex );
+	void RemovePlayerAtIndex( unsigned int playerIndex );
+	unsigned int GetNumberOfPlayers() const;
+	void ApplyDeadReckoning( double currentTimeSeconds, float maxX, float maxY );
+
+	std::vector< unsigned short >	m_playerIDs;
+	std::vector< unsigned int >		m_timerIndices;
+	std::vector< Color3b >			m_colors;
+	std::vector< float >			m_orientationDegrees;
+	std::vector< float >			m_positionX;
+	std::vector< float >			m_positionY;
+	std::vector< float >			m_lastUpdatePositionX;
+	std::vector< float >			m_lastUpdatePositionY;
+	std::vector< float >			m_velocityX;
+	std::vector< float >			m_velocityY;
+	std::vector< double >			m_timeOfLastUpdate;
+};
+
+
+#endif // include_RemotePlayers
\ No newline at end of file
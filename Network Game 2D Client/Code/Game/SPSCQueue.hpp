@@ -0,0 +1,89 @@
+#ifndef include_SPSCQueue
+#define include_SPSCQueue
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <windows.h>
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int CACHE_LINE_BYTES = 64;
+
+
+//-----------------------------------------------------------------------------------------------
+//Fixed-size ring shared by exactly one producer thread and one consumer thread. Each index has a
+//single writer, so an element is published by bumping the producer's index after it is filled
+//and released by bumping the consumer's index after it is read. The two indices sit on their own
+//cache lines so the threads don't keep stealing the same line from each other. T_Capacity must be
+//a power of two
+template< typename T_ElementType, unsigned int T_Capacity >
+class SPSCQueue
+{
+public:
+	SPSCQueue();
+	T_ElementType* GetNextElementToFill();
+	void PushElement();
+	const T_ElementType* PeekElement() const;
+	void PopElement();
+
+private:
+	T_ElementType	m_elements[ T_Capacity ];
+	char			m_paddingBeforePushCount[ CACHE_LINE_BYTES ];
+	volatile LONG	m_pushCount;
+	char			m_paddingAfterPushCount[ CACHE_LINE_BYTES ];
+	volatile LONG	m_popCount;
+	char			m_paddingAfterPopCount[ CACHE_LINE_BYTES ];
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_ElementType, unsigned int T_Capacity >
+SPSCQueue< T_ElementType, T_Capacity >::SPSCQueue()
+	: m_pushCount( 0 )
+	, m_popCount( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Producer only. Returns nullptr while the consumer still holds every slot
+template< typename T_ElementType, unsigned int T_Capacity >
+T_ElementType* SPSCQueue< T_ElementType, T_Capacity >::GetNextElementToFill()
+{
+	if( (unsigned long) ( m_pushCount - m_popCount ) >= T_Capacity )
+		return nullptr;
+
+	return &m_elements[ m_pushCount & ( T_Capacity - 1 ) ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_ElementType, unsigned int T_Capacity >
+void SPSCQueue< T_ElementType, T_Capacity >::PushElement()
+{
+	InterlockedExchange( &m_pushCount, m_pushCount + 1 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Consumer only. Returns nullptr when the queue is empty
+template< typename T_ElementType, unsigned int T_Capacity >
+const T_ElementType* SPSCQueue< T_ElementType, T_Capacity >::PeekElement() const
+{
+	if( m_popCount == m_pushCount )
+		return nullptr;
+
+	return &m_elements[ m_popCount & ( T_Capacity - 1 ) ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_ElementType, unsigned int T_Capacity >
+void SPSCQueue< T_ElementType, T_Capacity >::PopElement()
+{
+	InterlockedExchange( &m_popCount, m_popCount + 1 );
+}
+
+
+#endif // include_SPSCQueue
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef include_TimerWheel
+#define include_TimerWheel
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <vector>
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int NUM_TIMER_WHEEL_LEVELS = 4;
+const unsigned int TIMER_WHEEL_SLOT_BITS = 6;
+const unsigned int NUM_TIMER_WHEEL_SLOTS = 1 << TIMER_WHEEL_SLOT_BITS;
+const double SECONDS_PER_TIMER_WHEEL_TICK = 0.01;
+const unsigned int TIMER_KIND_SHIFT = 24;
+const unsigned int TIMER_INDEX_MASK = ( 1 << TIMER_KIND_SHIFT ) - 1;
+
+
+//-----------------------------------------------------------------------------------------------
+//Timer ids carry a small kind in the top bits so one wheel can serve several kinds of deadline
+inline unsigned int MakeTimerID( unsigned int timerKind, unsigned int timerIndex )
+{
+	return ( timerKind << TIMER_KIND_SHIFT ) | ( timerIndex & TIMER_INDEX_MASK );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline unsigned int GetTimerKind( unsigned int timerID )
+{
+	return timerID >> TIMER_KIND_SHIFT;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline unsigned int GetTimerIndex( unsigned int timerID )
+{
+	return timerID & TIMER_INDEX_MASK;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Hierarchical timing wheel. Each level is NUM_TIMER_WHEEL_SLOTS times coarser than the one below,
+//and a timer is pushed down a level whenever the wheel below it wraps around. Adding a timer is
+//O(1), and advancing only touches the slots that time has passed over, so the cost of a tick does
+//not grow with the number of idle timers
+class TimerWheel
+{
+public:
+	TimerWheel();
+	void Initialize( double startTimeSeconds, double secondsPerTick );
+	void AddTimer( unsigned int timerID, double deadlineSeconds );
+	void AdvanceTime( double currentTimeSeconds, std::vector< unsigned int >& out_expiredTimerIDs );
+	unsigned int GetNumberOfTimers() const;
+
+private:
+	struct Timer
+	{
+		unsigned int		m_timerID;
+		unsigned long long	m_deadlineTick;
+	};
+
+	void InsertTimer( const Timer& timer );
+	void CascadeTimers( unsigned int level );
+
+	std::vector< Timer >	m_slots[ NUM_TIMER_WHEEL_LEVELS ][ NUM_TIMER_WHEEL_SLOTS ];
+	std::vector< Timer >	m_cascadingTimers;
+	double					m_secondsPerTick;
+	unsigned long long		m_currentTick;
+	unsigned int			m_numTimers;
+};
+
+
+#endif // include_TimerWheel
\ No newline at end of file
@@ -1,7 +1,18 @@
 #include "UDPClient.hpp"
+#include <WS2tcpip.h>
+#include "../Engine/Time.hpp"
 #include "../Engine/NewMacroDef.hpp"
 
 
+//-----------------------------------------------------------------------------------------------
+UDPClient::UDPClient()
+	: m_maxDatagramBytes( GetMaxDatagramBytesForMTU( DEFAULT_MTU_BYTES ) )
+	, m_nextMessageID( 0 )
+{
+
+}
+
+
 //-----------------------------------------------------------------------------------------------
 bool UDPClient::ConnectToServer( const std::string& serverIPAddress, unsigned short serverPortNumber )
 {
@@ -26,6 +37,12 @@ bool UDPClient::ConnectToServer( const std::string& serverIPAddress, unsigned sh
 		return false;
 	}
 
+	//A datagram too big for the path is refused rather than split up by IP
+	DWORD dontFragment = TRUE;
+	setsockopt( m_socket, IPPROTO_IP, IP_DONTFRAGMENT, (const char*) &dontFragment, sizeof( dontFragment ) );
+
+	m_reassembler.Initialize();
+
 	m_serverIPAddress = serverIPAddress;
 	m_serverPortNumber = serverPortNumber;
 
@@ -42,26 +59,90 @@ void UDPClient::DisconnectFromServer()
 
 
 //-----------------------------------------------------------------------------------------------
+void UDPClient::SetMTU( unsigned int mtuBytes )
+{
+	m_maxDatagramBytes = GetMaxDatagramBytesForMTU( mtuBytes );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Returns true once a packet is waiting to be read, or false if the timeout passed first
+bool UDPClient::WaitForPacketFromServer( long timeoutMicroseconds )
+{
+	fd_set readSockets;
+	FD_ZERO( &readSockets );
+	FD_SET( m_socket, &readSockets );
+
+	struct timeval timeout;
+	timeout.tv_sec = timeoutMicroseconds / 1000000;
+	timeout.tv_usec = timeoutMicroseconds % 1000000;
+
+	return select( 0, &readSockets, nullptr, nullptr, &timeout ) > 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Fragments are collected until their message is whole, so this only returns complete packets
 bool UDPClient::ReceivePacketFromServer( char* out_packetInfo, int packetLength )
 {
 	struct sockaddr_in clientAddr;
-	int clientLen = sizeof( clientAddr );
-
-	if( recvfrom( m_socket, out_packetInfo, packetLength, 0, (struct sockaddr*) &clientAddr, &clientLen ) < 0 )
+	for( ;; )
 	{
-		return false;
+		int clientLen = sizeof( clientAddr );
+		int datagramBytes = recvfrom( m_socket, m_receiveBuffer, sizeof( m_receiveBuffer ), 0, (struct sockaddr*) &clientAddr, &clientLen );
+		if( datagramBytes < 0 )
+		{
+			return false;
+		}
+
+		const char* message = m_receiveBuffer;
+		unsigned int messageBytes = datagramBytes;
+		if( datagramBytes > 0 && (unsigned char) m_receiveBuffer[ 0 ] == FRAGMENT_PACKET_TYPE )
+		{
+			unsigned long long sourceKey = ( (unsigned long long) clientAddr.sin_addr.s_addr << 16 ) | clientAddr.sin_port;
+			message = m_reassembler.AddFragment( sourceKey, m_receiveBuffer, datagramBytes, GetCurrentTimeSeconds(), messageBytes );
+			if( !message )
+				continue;
+		}
+
+		if( messageBytes > (unsigned int) packetLength )
+			messageBytes = packetLength;
+
+		memcpy( out_packetInfo, message, messageBytes );
+		return true;
 	}
-
-	return true;
 }
 
 
 //-----------------------------------------------------------------------------------------------
+//Packets that fit in one datagram go out untouched, and anything bigger is split into fragments.
+//Both client threads send, but only the main thread ever sends anything large enough to split
 bool UDPClient::SendPacketToServer( const char* packetInfo, int packetLength )
 {
-	if( sendto( m_socket, packetInfo, packetLength, 0, (struct sockaddr*) &m_serverAddr, sizeof( m_serverAddr ) ) < 0 )
+	if( (unsigned int) packetLength <= m_maxDatagramBytes )
 	{
+		if( sendto( m_socket, packetInfo, packetLength, 0, (struct sockaddr*) &m_serverAddr, sizeof( m_serverAddr ) ) < 0 )
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+	unsigned int numFragments = GetNumberOfFragments( packetLength, m_maxDatagramBytes );
+	if( numFragments == 0 )
 		return false;
+
+	unsigned short messageID = m_nextMessageID;
+	++m_nextMessageID;
+
+	for( unsigned int fragmentIndex = 0; fragmentIndex < numFragments; ++fragmentIndex )
+	{
+		unsigned int datagramBytes = BuildFragment( packetInfo, packetLength, messageID, fragmentIndex, m_maxDatagramBytes, m_fragmentBuffer );
+		if( sendto( m_socket, m_fragmentBuffer, datagramBytes, 0, (struct sockaddr*) &m_serverAddr, sizeof( m_serverAddr ) ) < 0 )
+		{
+			return false;
+		}
 	}
 
 	return true;
@@ -5,6 +5,7 @@
 //-----------------------------------------------------------------------------------------------
 #include <string>
 #include <WinSock2.h>
+#include "Fragmentation.hpp"
 #pragma comment(lib,"ws2_32.lib")
 
 
@@ -12,9 +13,11 @@
 class UDPClient
 {
 public:
-	UDPClient() {}
+	UDPClient();
 	bool ConnectToServer( const std::string& serverIPAddress, unsigned short serverPortNumber );
 	void DisconnectFromServer();
+	void SetMTU( unsigned int mtuBytes );
+	bool WaitForPacketFromServer( long timeoutMicroseconds );
 	bool ReceivePacketFromServer( char* out_packetInfo, int packetLength );
 	bool SendPacketToServer( const char* packetInfo, int packetLength );
 	std::string GetServerIPAddress();
@@ -28,6 +31,11 @@ private:
 	struct sockaddr_in		m_serverAddr;
 	std::string				m_serverIPAddress;
 	unsigned short			m_serverPortNumber;
+	unsigned int			m_maxDatagramBytes;
+	unsigned short			m_nextMessageID;
+	MessageReassembler		m_reassembler;
+	char					m_receiveBuffer[ MAX_DATAGRAM_BYTES ];
+	char					m_fragmentBuffer[ MAX_DATAGRAM_BYTES ];
 };
 
 
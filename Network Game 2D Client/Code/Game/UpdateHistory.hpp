@@ -0,0 +1,152 @@
+#ifndef include_UpdateHistory
+#define include_UpdateHistory
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <math.h>
+#include "CS6Packet.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const float UPDATE_HISTORY_UNITS_PER_PIXEL = 8.f;
+
+
+//-----------------------------------------------------------------------------------------------
+//A client's movement state at the moment it was sent, on the client's clock
+struct UpdateState
+{
+	double	m_timestamp;
+	float	m_xPosition;
+	float	m_yPosition;
+	float	m_xVelocity;
+	float	m_yVelocity;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//The states from the client's last few updates, newest first. Each one is written as its
+//difference from the state after it as the receiver will decode that state, so rounding doesn't
+//build up along the chain. A state too far from the next to fit ends the chain there
+class UpdateHistory
+{
+public:
+	UpdateHistory() { Clear(); }
+	void Clear();
+	void WriteHistoryAndAddState( CS6Packet& out_updatePacket );
+
+private:
+	UpdateState		m_states[ MAX_PREVIOUS_UPDATE_STATES ];
+	unsigned int	m_numStates;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+inline bool QuantizeDelta( float older, float newer, short& out_delta )
+{
+	float units = floorf( ( older - newer ) * UPDATE_HISTORY_UNITS_PER_PIXEL + 0.5f );
+	if( units < -32768.f || units > 32767.f )
+		return false;
+
+	out_delta = (short) units;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline float ApplyDelta( float newer, short delta )
+{
+	return newer + (float) delta / UPDATE_HISTORY_UNITS_PER_PIXEL;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Fills out_states, newest first, and returns how many there were. A count over the limit is
+//taken as the limit
+inline unsigned int ReadPreviousStates( const CS6Packet& updatePacket, UpdateState* out_states )
+{
+	unsigned int numStates = updatePacket.numPreviousStates;
+	if( numStates > MAX_PREVIOUS_UPDATE_STATES )
+		numStates = MAX_PREVIOUS_UPDATE_STATES;
+
+	UpdateState newer;
+	newer.m_timestamp = updatePacket.timestamp;
+	newer.m_xPosition = updatePacket.data.updated.xPosition;
+	newer.m_yPosition = updatePacket.data.updated.yPosition;
+	newer.m_xVelocity = updatePacket.data.updated.xVelocity;
+	newer.m_yVelocity = updatePacket.data.updated.yVelocity;
+	for( unsigned int stateIndex = 0; stateIndex < numStates; ++stateIndex )
+	{
+		const PreviousStateGame& previousState = updatePacket.previousStates[ stateIndex ];
+		UpdateState& older = out_states[ stateIndex ];
+		older.m_timestamp = newer.m_timestamp - previousState.millisecondsEarlier * 0.001;
+		older.m_xPosition = ApplyDelta( newer.m_xPosition, previousState.xPositionDelta );
+		older.m_yPosition = ApplyDelta( newer.m_yPosition, previousState.yPositionDelta );
+		older.m_xVelocity = ApplyDelta( newer.m_xVelocity, previousState.xVelocityDelta );
+		older.m_yVelocity = ApplyDelta( newer.m_yVelocity, previousState.yVelocityDelta );
+		newer = older;
+	}
+
+	return numStates;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline void UpdateHistory::Clear()
+{
+	m_numStates = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Call once the update's timestamp and state are filled in, and before it is sent
+inline void UpdateHistory::WriteHistoryAndAddState( CS6Packet& out_updatePacket )
+{
+	UpdateState newer;
+	newer.m_timestamp = out_updatePacket.timestamp;
+	newer.m_xPosition = out_updatePacket.data.updated.xPosition;
+	newer.m_yPosition = out_updatePacket.data.updated.yPosition;
+	newer.m_xVelocity = out_updatePacket.data.updated.xVelocity;
+	newer.m_yVelocity = out_updatePacket.data.updated.yVelocity;
+
+	out_updatePacket.numPreviousStates = 0;
+	for( unsigned int stateIndex = 0; stateIndex < m_numStates; ++stateIndex )
+	{
+		const UpdateState& older = m_states[ stateIndex ];
+		PreviousStateGame& previousState = out_updatePacket.previousStates[ stateIndex ];
+
+		double millisecondsEarlier = floor( ( newer.m_timestamp - older.m_timestamp ) * 1000.0 + 0.5 );
+		if( millisecondsEarlier < 0.0 || millisecondsEarlier > 65535.0 )
+			break;
+
+		if( !QuantizeDelta( older.m_xPosition, newer.m_xPosition, previousState.xPositionDelta )
+			|| !QuantizeDelta( older.m_yPosition, newer.m_yPosition, previousState.yPositionDelta )
+			|| !QuantizeDelta( older.m_xVelocity, newer.m_xVelocity, previousState.xVelocityDelta )
+			|| !QuantizeDelta( older.m_yVelocity, newer.m_yVelocity, previousState.yVelocityDelta ) )
+			break;
+
+		previousState.millisecondsEarlier = (unsigned short) millisecondsEarlier;
+		++out_updatePacket.numPreviousStates;
+
+		newer.m_timestamp -= millisecondsEarlier * 0.001;
+		newer.m_xPosition = ApplyDelta( newer.m_xPosition, previousState.xPositionDelta );
+		newer.m_yPosition = ApplyDelta( newer.m_yPosition, previousState.yPositionDelta );
+		newer.m_xVelocity = ApplyDelta( newer.m_xVelocity, previousState.xVelocityDelta );
+		newer.m_yVelocity = ApplyDelta( newer.m_yVelocity, previousState.yVelocityDelta );
+	}
+
+	for( unsigned int stateIndex = MAX_PREVIOUS_UPDATE_STATES - 1; stateIndex > 0; --stateIndex )
+	{
+		m_states[ stateIndex ] = m_states[ stateIndex - 1 ];
+	}
+
+	m_states[ 0 ].m_timestamp = out_updatePacket.timestamp;
+	m_states[ 0 ].m_xPosition = out_updatePacket.data.updated.xPosition;
+	m_states[ 0 ].m_yPosition = out_updatePacket.data.updated.yPosition;
+	m_states[ 0 ].m_xVelocity = out_updatePacket.data.updated.xVelocity;
+	m_states[ 0 ].m_yVelocity = out_updatePacket.data.updated.yVelocity;
+	if( m_numStates < MAX_PREVIOUS_UPDATE_STATES )
+		++m_numStates;
+}
+
+
+#endif // include_UpdateHistory
\ No newline at end of file
@@ -0,0 +1,133 @@
+#ifndef include_UpdateScheduler
+#define include_UpdateScheduler
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <math.h>
+#include "../Engine/Vector2.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const float UPDATE_POSITION_ERROR_PIXELS = 2.f;
+const float UPDATE_VELOCITY_CHANGE_PIXELS_PER_SECOND = 1.f;
+const float UPDATE_HEADING_CHANGE_DEGREES = 1.f;
+const double SECONDS_BEFORE_SEND_FOLLOW_UP_UPDATE = 0.1;
+const unsigned int NUM_FOLLOW_UP_UPDATES = 2;
+const double SECONDS_BEFORE_SEND_KEEPALIVE_UPDATE = 1.0;
+
+
+//-----------------------------------------------------------------------------------------------
+enum UpdateReason
+{
+	UPDATE_REASON_None,
+	UPDATE_REASON_MotionChanged,
+	UPDATE_REASON_FollowUp,
+	UPDATE_REASON_Keepalive,
+	UPDATE_REASON_CarryAck,
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Decides when the client's own state is worth sending. The server carries the last state sent
+//forward at its velocity, so an update is only due once that guess is off by more than a couple
+//of pixels or the velocity or heading changes. A change is followed by a few quick repeats, so
+//losing it costs a tenth of a second rather than a keepalive interval, and the keepalive keeps
+//the server from timing a player out for standing still. The caller picks UPDATE_REASON_CarryAck
+//itself when nothing else is due but an ack is waiting for something to ride on
+class UpdateScheduler
+{
+public:
+	UpdateScheduler() { Initialize( 0.f, 0.f ); }
+	void Initialize( float mapWidth, float mapHeight );
+	void Reset();
+	UpdateReason GetUpdateReason( const Vector2& position, const Vector2& velocity, float orientationDegrees, double currentTime ) const;
+	void RecordUpdate( UpdateReason reason, const Vector2& position, const Vector2& velocity, float orientationDegrees, double currentTime );
+
+private:
+	Vector2 PredictPosition( double currentTime ) const;
+
+	float			m_mapWidth;
+	float			m_mapHeight;
+	bool			m_hasSentUpdate;
+	Vector2			m_sentPosition;
+	Vector2			m_sentVelocity;
+	float			m_sentOrientationDegrees;
+	double			m_sentTime;
+	unsigned int	m_numFollowUpUpdatesLeft;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//The bounds the receivers clamp their own prediction to
+inline void UpdateScheduler::Initialize( float mapWidth, float mapHeight )
+{
+	m_mapWidth = mapWidth;
+	m_mapHeight = mapHeight;
+	Reset();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The next check always sends, as it must after the player has been placed somewhere new
+inline void UpdateScheduler::Reset()
+{
+	m_hasSentUpdate = false;
+	m_sentOrientationDegrees = 0.f;
+	m_sentTime = 0.0;
+	m_numFollowUpUpdatesLeft = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline UpdateReason UpdateScheduler::GetUpdateReason( const Vector2& position, const Vector2& velocity, float orientationDegrees, double currentTime ) const
+{
+	if( !m_hasSentUpdate )
+		return UPDATE_REASON_MotionChanged;
+
+	float headingChangeDegrees = fmodf( fabsf( orientationDegrees - m_sentOrientationDegrees ), 360.f );
+	if( headingChangeDegrees > 180.f )
+		headingChangeDegrees = 360.f - headingChangeDegrees;
+
+	if( ( velocity - m_sentVelocity ).GetLength() > UPDATE_VELOCITY_CHANGE_PIXELS_PER_SECOND
+		|| headingChangeDegrees > UPDATE_HEADING_CHANGE_DEGREES
+		|| ( position - PredictPosition( currentTime ) ).GetLength() > UPDATE_POSITION_ERROR_PIXELS )
+		return UPDATE_REASON_MotionChanged;
+
+	double secondsSinceSent = currentTime - m_sentTime;
+	if( m_numFollowUpUpdatesLeft > 0 && secondsSinceSent >= SECONDS_BEFORE_SEND_FOLLOW_UP_UPDATE )
+		return UPDATE_REASON_FollowUp;
+
+	if( secondsSinceSent >= SECONDS_BEFORE_SEND_KEEPALIVE_UPDATE )
+		return UPDATE_REASON_Keepalive;
+
+	return UPDATE_REASON_None;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline void UpdateScheduler::RecordUpdate( UpdateReason reason, const Vector2& position, const Vector2& velocity, float orientationDegrees, double currentTime )
+{
+	if( reason == UPDATE_REASON_MotionChanged )
+		m_numFollowUpUpdatesLeft = NUM_FOLLOW_UP_UPDATES;
+	else if( reason == UPDATE_REASON_FollowUp && m_numFollowUpUpdatesLeft > 0 )
+		--m_numFollowUpUpdatesLeft;
+
+	m_hasSentUpdate = true;
+	m_sentPosition = position;
+	m_sentVelocity = velocity;
+	m_sentOrientationDegrees = orientationDegrees;
+	m_sentTime = currentTime;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline Vector2 UpdateScheduler::PredictPosition( double currentTime ) const
+{
+	Vector2 predictedPosition = m_sentPosition + m_sentVelocity * (float) ( currentTime - m_sentTime );
+	predictedPosition.x = predictedPosition.x < 0.f ? 0.f : ( predictedPosition.x > m_mapWidth ? m_mapWidth : predictedPosition.x );
+	predictedPosition.y = predictedPosition.y < 0.f ? 0.f : ( predictedPosition.y > m_mapHeight ? m_mapHeight : predictedPosition.y );
+	return predictedPosition;
+}
+
+
+#endif // include_UpdateScheduler
\ No newline at end of file
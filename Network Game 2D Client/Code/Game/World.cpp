@@ -1,5 +1,6 @@
 #include "World.hpp"
 #include "../Engine/Time.hpp"
+#include "../Engine/MemoryManager.hpp"
 #include "../Engine/DeveloperConsole.hpp"
 #include "../Engine/NewMacroDef.hpp"
 
@@ -11,8 +12,12 @@ World::World( float worldWidth, float worldHeight )
 	, m_isConnectedToGame( false )
 	, m_hasInitializedGame( false )
 	, m_hasFlag( false )
-	, m_nextPacketNumber( 0 )
+	, m_lobbyCookie( 0 )
+	, m_numPlayersSpawned( 0 )
 	, m_flagPosition( worldWidth, worldHeight )
+	, m_pendingAckType( TYPE_None )
+	, m_pendingAckNumber( 0 )
+	, m_pendingAckDeadline( 0.0 )
 {
 
 }
@@ -23,18 +28,24 @@ void World::Initialize()
 {
 	InitializeTime();
 	m_client.ConnectToServer( IP_ADDRESS, PORT_NUMBER );
+	m_networkThread.Start( &m_client );
 	m_playerTexture = Texture::CreateOrGetTexture( PLAYER_TEXTURE_FILE_PATH );
 	m_flagTexture = Texture::CreateOrGetTexture( FLAG_TEXTURE_FILE_PATH );
 	m_secondsSinceLastInitSend = GetCurrentTimeSeconds();
+	m_timeOfLastHeartbeat = GetCurrentTimeSeconds();
+	m_timers.Initialize( GetCurrentTimeSeconds(), SECONDS_PER_TIMER_WHEEL_TICK );
+	m_updateScheduler.Initialize( m_size.x, m_size.y );
 
 	m_mainPlayer = new Player;
-	m_players.push_back( m_mainPlayer );
+	m_mainPlayer->m_playerID = INVALID_PLAYER_ID;
+	m_playerIndexByID.assign( NUM_PLAYER_IDS, INVALID_PLAYER_INDEX );
 }
 
 
 //-----------------------------------------------------------------------------------------------
 void World::Destruct()
 {
+	m_networkThread.Stop();
 	m_client.DisconnectFromServer();
 }
 
@@ -46,6 +57,9 @@ void World::ChangeIPAddress( const std::string& ipAddrString )
 	//m_client.DisconnectFromServer();
 	//m_client.ConnectToServer( ipAddrString, currentServerPortNumber );
 	m_client.SetServerIPAddress( ipAddrString );
+	m_gameReceiveWindow.Reset();
+	m_lobbyReceiveWindow.Reset();
+	m_serverClock.Reset();
 
 	m_isConnectedToServer = false;
 }
@@ -58,6 +72,12 @@ void World::ChangePortNumber( unsigned short portNumber )
 	//m_client.DisconnectFromServer();
 	//m_client.ConnectToServer( currentServerIPAddress, portNumber );
 	m_client.SetServerPortNumber( portNumber );
+	m_gameReceiveWindow.Reset();
+	m_lobbyReceiveWindow.Reset();
+	m_pendingAckType = TYPE_None;
+	m_updateHistory.Clear();
+	m_updateScheduler.Reset();
+	m_parityDecoder.Clear();
 
 	m_isConnectedToServer = false;
 }
@@ -96,6 +116,31 @@ void World::ShowLobbyGames()
 }
 
 
+//-----------------------------------------------------------------------------------------------
+void World::ShowClockSync()
+{
+	if( !m_serverClock.HasEstimate() )
+	{
+		ConsoleLogLine logLine( "No clock estimate yet\n", Color::Red );
+		g_developerConsole.m_consoleLogLines.push_back( logLine );
+		return;
+	}
+
+	double offsetMilliseconds = m_serverClock.GetOffsetSeconds( GetCurrentTimeSeconds() ) * 1000.0;
+	ConsoleLogLine logLine0( "Server clock offset (ms): " + ConvertNumberToString( offsetMilliseconds ), Color::Blue );
+	g_developerConsole.m_consoleLogLines.push_back( logLine0 );
+
+	ConsoleLogLine logLine1( "    Error bound (ms): " + ConvertNumberToString( m_serverClock.GetErrorBoundSeconds() * 1000.0 ), Color::Blue );
+	g_developerConsole.m_consoleLogLines.push_back( logLine1 );
+
+	ConsoleLogLine logLine2( "    Round trip (ms): " + ConvertNumberToString( m_serverClock.GetRoundTripSeconds() * 1000.0 ), Color::Blue );
+	g_developerConsole.m_consoleLogLines.push_back( logLine2 );
+
+	ConsoleLogLine logLine3( "    Drift (ppm): " + ConvertNumberToString( m_serverClock.GetDriftRate() * 1000000.0 ), Color::Blue );
+	g_developerConsole.m_consoleLogLines.push_back( logLine3 );
+}
+
+
 //-----------------------------------------------------------------------------------------------
 void World::CreateLobbyGame()
 {
@@ -107,7 +152,6 @@ void World::CreateLobbyGame()
 	}
 
 	LobbyPacket createPacket;
-	createPacket.packetNumber = m_nextPacketNumber;
 	createPacket.packetType = LOBBY_TYPE_CreateGame;
 	createPacket.timestamp = GetCurrentTimeSeconds();
 	
@@ -126,7 +170,6 @@ void World::JoinLobbyGame( unsigned int gameID )
 	}
 
 	LobbyPacket joinPacket;
-	joinPacket.packetNumber = m_nextPacketNumber;
 	joinPacket.packetType = LOBBY_TYPE_JoinGame;
 	joinPacket.timestamp = GetCurrentTimeSeconds();
 	joinPacket.data.join.gameID = gameID;
@@ -143,9 +186,9 @@ void World::Update( float deltaSeconds, const Keyboard& keyboard, const Mouse& m
 	ReceivePackets();
 	ApplyDeadReckoning();
 	SendUpdate();
+	SendDelayedAck();
 	ResendAckPackets();
-	RemoveTimedOutLobbyGames();
-	RemoveTimedOutPlayers();
+	ProcessExpiredTimers();
 }
 
 
@@ -168,10 +211,19 @@ void World::RenderObjects2D()
 
 
 //-----------------------------------------------------------------------------------------------
-void World::SendPacket( const CS6Packet& packet, bool requireAck )
+//Stamps the packet with the next outgoing number first, so a stored reliable packet and its
+//resends always carry the number the server will ack. Any ack still waiting goes out with it
+void World::SendPacket( CS6Packet& packet, bool requireAck )
 {
-	m_client.SendPacketToServer( (const char*) &packet, sizeof( packet ) );
-	++m_nextPacketNumber;
+	packet.packetNumber = m_networkThread.TakeNextPacketNumber();
+	m_serverClock.GetEchoTimestamps( packet.timestamp, packet.echoTimestamp, packet.echoHoldSeconds );
+	packet.ackedPacketType = m_pendingAckType;
+	packet.ackedPacketNumber = m_pendingAckNumber;
+	m_pendingAckType = TYPE_None;
+	if( packet.packetType == TYPE_Update )
+		m_updateHistory.WriteHistoryAndAddState( packet );
+
+	m_client.SendPacketToServer( (const char*) &packet, GetNumberOfBytesToSend( packet ) );
 
 	if( requireAck )
 	{
@@ -181,10 +233,11 @@ void World::SendPacket( const CS6Packet& packet, bool requireAck )
 
 
 //-----------------------------------------------------------------------------------------------
-void World::SendPacket( const LobbyPacket& packet, bool requireAck )
+void World::SendPacket( LobbyPacket& packet, bool requireAck )
 {
+	packet.packetNumber = m_networkThread.TakeNextPacketNumber();
+	m_serverClock.GetEchoTimestamps( packet.timestamp, packet.echoTimestamp, packet.echoHoldSeconds );
 	m_client.SendPacketToServer( (const char*) &packet, sizeof( packet ) );
-	++m_nextPacketNumber;
 
 	if( requireAck )
 	{
@@ -197,10 +250,10 @@ void World::SendPacket( const LobbyPacket& packet, bool requireAck )
 void World::SendJoinGamePacket()
 {
 	LobbyPacket joinPacket;
-	joinPacket.packetNumber = m_nextPacketNumber;
 	joinPacket.packetType = LOBBY_TYPE_Acknowledge;
 	joinPacket.timestamp = GetCurrentTimeSeconds();
 	joinPacket.data.acknowledged.packetType = LOBBY_TYPE_Acknowledge;
+	joinPacket.data.acknowledged.cookie = m_lobbyCookie;
 
 	SendPacket( joinPacket, false );
 }
@@ -208,11 +261,18 @@ void World::SendJoinGamePacket()
 
 //-----------------------------------------------------------------------------------------------
 void World::ProcessAckPackets( const CS6Packet& ackPacket )
+{
+	RemoveAckedGamePacket( ackPacket.data.acknowledged.packetNumber );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void World::RemoveAckedGamePacket( SequenceNumber ackedPacketNumber )
 {
 	for( unsigned int packetIndex = 0; packetIndex < m_sentGamePackets.size(); ++packetIndex )
 	{
 		CS6Packet packet = m_sentGamePackets[ packetIndex ];
-		if( packet.packetNumber == ackPacket.data.acknowledged.packetNumber )
+		if( packet.packetNumber == ackedPacketNumber )
 		{
 			m_sentGamePackets.erase( m_sentGamePackets.begin() + packetIndex );
 			break;
@@ -221,6 +281,50 @@ void World::ProcessAckPackets( const CS6Packet& ackPacket )
 }
 
 
+//-----------------------------------------------------------------------------------------------
+//Once we're in a game an update is sent this frame just to carry the ack, even if the scheduler
+//had nothing due. Only one ack waits at a time, and an older one is sent on its own to make room
+void World::QueueAck( const CS6Packet& reliablePacket, double arrivalTimeSeconds )
+{
+	SendPendingAck();
+
+	m_pendingAckType = reliablePacket.packetType;
+	m_pendingAckNumber = reliablePacket.packetNumber;
+	m_pendingAckDeadline = arrivalTimeSeconds + SECONDS_BEFORE_SEND_STANDALONE_ACK;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void World::SendPendingAck()
+{
+	if( m_pendingAckType == TYPE_None )
+		return;
+
+	CS6Packet ackPacket;
+	ackPacket.packetType = TYPE_Acknowledge;
+	ackPacket.playerColorAndID[0] = m_mainPlayer->m_color.r;
+	ackPacket.playerColorAndID[1] = m_mainPlayer->m_color.g;
+	ackPacket.playerColorAndID[2] = m_mainPlayer->m_color.b;
+	ackPacket.playerID = m_mainPlayer->m_playerID;
+	ackPacket.timestamp = GetCurrentTimeSeconds();
+	ackPacket.data.acknowledged.packetNumber = m_pendingAckNumber;
+	ackPacket.data.acknowledged.packetType = m_pendingAckType;
+	ackPacket.data.acknowledged.cookie = 0;
+	m_pendingAckType = TYPE_None;
+
+	SendPacket( ackPacket, false );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Runs after this frame's update, so anything still waiting had nothing to ride on
+void World::SendDelayedAck()
+{
+	if( m_pendingAckType != TYPE_None && GetCurrentTimeSeconds() >= m_pendingAckDeadline )
+		SendPendingAck();
+}
+
+
 //-----------------------------------------------------------------------------------------------
 void World::ProcessAckPackets( const LobbyPacket& ackPacket )
 {
@@ -247,13 +351,61 @@ void World::ProcessAckPackets( const LobbyPacket& ackPacket )
 }
 
 
+//-----------------------------------------------------------------------------------------------
+//The server refused the request because it is overloaded. It counts as an answer, so the request
+//stops being resent and it is left to the player to try again
+void World::ProcessBusyPacket( const LobbyPacket& busyPacket )
+{
+	for( unsigned int packetIndex = 0; packetIndex < m_sentLobbyPackets.size(); ++packetIndex )
+	{
+		if( m_sentLobbyPackets[ packetIndex ].packetNumber == busyPacket.data.busy.packetNumber )
+		{
+			m_sentLobbyPackets.erase( m_sentLobbyPackets.begin() + packetIndex );
+			break;
+		}
+	}
+
+	ConsoleLogLine logLine( "Server is busy, try again in " + ConvertNumberToString( busyPacket.data.busy.retryAfterSeconds ) + " seconds\n", Color::Red );
+	g_developerConsole.m_consoleLogLines.push_back( logLine );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The lobby holds no state for us until we echo its cookie, so whatever it sent before this was
+//not part of a session and the sequence space starts over
+void World::AnswerChallenge( const LobbyPacket& challengePacket )
+{
+	//Challenges still in flight from before we connected repeat the cookie we already echoed
+	if( m_isConnectedToServer && challengePacket.data.challenge.cookie == m_lobbyCookie )
+		return;
+
+	m_lobbyCookie = challengePacket.data.challenge.cookie;
+	m_lobbyReceiveWindow.Reset();
+
+	m_isConnectedToServer = false;
+	SendJoinGamePacket();
+	m_secondsSinceLastInitSend = GetCurrentTimeSeconds();
+}
+
+
 //-----------------------------------------------------------------------------------------------
 void World::ResetGame( const CS6Packet& resetPacket )
 {
 	m_isConnectedToServer = true;
 	m_hasInitializedGame = true;
 	m_hasFlag = false;
+	m_updateHistory.Clear();
+	m_updateScheduler.Reset();
+
+	//A remote player still holding the id we were just given is left over from an earlier game
+	if( resetPacket.playerID != INVALID_PLAYER_ID )
+	{
+		unsigned short staleIndex = m_playerIndexByID[ resetPacket.playerID ];
+		if( staleIndex != INVALID_PLAYER_INDEX )
+			RemovePlayerAtIndex( staleIndex );
+	}
 
+	m_mainPlayer->m_playerID = resetPacket.playerID;
 	m_mainPlayer->m_color.r = resetPacket.data.reset.playerColorAndID[0];
 	m_mainPlayer->m_color.g = resetPacket.data.reset.playerColorAndID[1];
 	m_mainPlayer->m_color.b = resetPacket.data.reset.playerColorAndID[2];
@@ -264,62 +416,56 @@ void World::ResetGame( const CS6Packet& resetPacket )
 	m_mainPlayer->m_orientationDegrees = 0.f;
 	m_flagPosition.x = resetPacket.data.reset.flagXPosition;
 	m_flagPosition.y = resetPacket.data.reset.flagYPosition;
-
-	CS6Packet ackPacket;
-	ackPacket.packetNumber = m_nextPacketNumber;
-	ackPacket.packetType = TYPE_Acknowledge;
-	ackPacket.playerColorAndID[0] = m_mainPlayer->m_color.r;
-	ackPacket.playerColorAndID[1] = m_mainPlayer->m_color.g;
-	ackPacket.playerColorAndID[2] = m_mainPlayer->m_color.b;
-	ackPacket.timestamp = GetCurrentTimeSeconds();
-	ackPacket.data.acknowledged.packetNumber = resetPacket.packetNumber;
-	ackPacket.data.acknowledged.packetType = TYPE_Reset;
-
-	SendPacket( ackPacket, false );
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void World::UpdatePlayer( const CS6Packet& updatePacket )
+void World::UpdatePlayer( const CS6Packet& updatePacket, double arrivalTimeSeconds )
 {
-	if( !m_hasInitializedGame )
+	if( !m_hasInitializedGame || updatePacket.playerID == INVALID_PLAYER_ID || updatePacket.playerID == m_mainPlayer->m_playerID )
 		return;
 
-	for( unsigned int playerIndex = 0; playerIndex < m_players.size(); ++playerIndex )
+	//An entry whose stored id differs is left over from before the id counter wrapped
+	unsigned int playerIndex = m_playerIndexByID[ updatePacket.playerID ];
+	if( playerIndex != INVALID_PLAYER_INDEX && ( playerIndex >= m_remotePlayers.GetNumberOfPlayers() || m_remotePlayers.m_playerIDs[ playerIndex ] != updatePacket.playerID ) )
 	{
-		Player* player = m_players[ playerIndex ];
-		if( player->m_color.r == updatePacket.playerColorAndID[0]
-		&& player->m_color.g == updatePacket.playerColorAndID[1]
-		&& player->m_color.b == updatePacket.playerColorAndID[2] )
-		{
-			if( player == m_mainPlayer )
-				return;
+		m_playerIndexByID[ updatePacket.playerID ] = INVALID_PLAYER_INDEX;
+		playerIndex = INVALID_PLAYER_INDEX;
+	}
 
-			player->m_lastUpdatePosition.x = updatePacket.data.updated.xPosition;
-			player->m_lastUpdatePosition.y = updatePacket.data.updated.yPosition;
-			player->m_lastUpdateVelocity = player->m_currentVelocity;
-			player->m_currentVelocity.x = updatePacket.data.updated.xVelocity;
-			player->m_currentVelocity.y = updatePacket.data.updated.yVelocity;
-			player->m_orientationDegrees = updatePacket.data.updated.yawDegrees;
-			player->m_timeOfLastUpdate = GetCurrentTimeSeconds();
+	bool isNewPlayer = ( playerIndex == INVALID_PLAYER_INDEX );
+	if( isNewPlayer )
+	{
+		unsigned int timerIndex = ( ( m_numPlayersSpawned & 0xff ) << 16 ) | updatePacket.playerID;
+		++m_numPlayersSpawned;
 
-			return;
-		}
+		playerIndex = m_remotePlayers.AddPlayer( updatePacket.playerID, timerIndex );
+		m_playerIndexByID[ updatePacket.playerID ] = (unsigned short) playerIndex;
+		m_remotePlayers.m_positionX[ playerIndex ] = updatePacket.data.updated.xPosition;
+		m_remotePlayers.m_positionY[ playerIndex ] = updatePacket.data.updated.yPosition;
+		m_timers.AddTimer( MakeTimerID( WORLD_TIMER_PlayerTimeout, timerIndex ), arrivalTimeSeconds + SECONDS_BEFORE_TIMEOUT_REMOVE );
 	}
 
-	Player* player = new Player();
-	player->m_color.r = updatePacket.playerColorAndID[0];
-	player->m_color.g = updatePacket.playerColorAndID[1];
-	player->m_color.b = updatePacket.playerColorAndID[2];
-	player->m_currentPosition.x = updatePacket.data.updated.xPosition;
-	player->m_currentPosition.y = updatePacket.data.updated.yPosition;
-	player->m_lastUpdatePosition = player->m_currentPosition;
-	player->m_currentVelocity.x = updatePacket.data.updated.xVelocity;
-	player->m_currentVelocity.y = updatePacket.data.updated.yVelocity;
-	player->m_orientationDegrees = updatePacket.data.updated.yawDegrees;
-	player->m_timeOfLastUpdate = GetCurrentTimeSeconds();
+	m_remotePlayers.m_colors[ playerIndex ].r = updatePacket.playerColorAndID[0];
+	m_remotePlayers.m_colors[ playerIndex ].g = updatePacket.playerColorAndID[1];
+	m_remotePlayers.m_colors[ playerIndex ].b = updatePacket.playerColorAndID[2];
+	m_remotePlayers.m_lastUpdatePositionX[ playerIndex ] = updatePacket.data.updated.xPosition;
+	m_remotePlayers.m_lastUpdatePositionY[ playerIndex ] = updatePacket.data.updated.yPosition;
+	m_remotePlayers.m_velocityX[ playerIndex ] = updatePacket.data.updated.xVelocity;
+	m_remotePlayers.m_velocityY[ playerIndex ] = updatePacket.data.updated.yVelocity;
+	m_remotePlayers.m_orientationDegrees[ playerIndex ] = updatePacket.data.updated.yawDegrees;
+	m_remotePlayers.m_timeOfLastUpdate[ playerIndex ] = arrivalTimeSeconds;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void World::RemovePlayerAtIndex( unsigned int playerIndex )
+{
+	m_playerIndexByID[ m_remotePlayers.m_playerIDs[ playerIndex ] ] = INVALID_PLAYER_INDEX;
 
-	m_players.push_back( player );
+	m_remotePlayers.RemovePlayerAtIndex( playerIndex );
+	if( playerIndex < m_remotePlayers.GetNumberOfPlayers() )
+		m_playerIndexByID[ m_remotePlayers.m_playerIDs[ playerIndex ] ] = (unsigned short) playerIndex;
 }
 
 
@@ -403,15 +549,30 @@ void World::SendUpdate()
 		return;
 	}
 
+	if( m_isConnectedToServer && !m_isConnectedToGame )
+	{
+		SendHeartbeat();
+		return;
+	}
+
 	if( !m_hasInitializedGame )
 		return;
-	
+
+	double currentTime = GetCurrentTimeSeconds();
+	UpdateReason reason = m_updateScheduler.GetUpdateReason( m_mainPlayer->m_currentPosition, m_mainPlayer->m_currentVelocity, m_mainPlayer->m_orientationDegrees, currentTime );
+	if( reason == UPDATE_REASON_None && m_pendingAckType != TYPE_None )
+		reason = UPDATE_REASON_CarryAck;
+
+	if( reason == UPDATE_REASON_None )
+		return;
+
 	CS6Packet updatePacket;
 	updatePacket.packetType = TYPE_Update;
 	updatePacket.playerColorAndID[0] = m_mainPlayer->m_color.r;
 	updatePacket.playerColorAndID[1] = m_mainPlayer->m_color.g;
 	updatePacket.playerColorAndID[2] = m_mainPlayer->m_color.b;
-	updatePacket.timestamp = GetCurrentTimeSeconds();
+	updatePacket.playerID = m_mainPlayer->m_playerID;
+	updatePacket.timestamp = currentTime;
 	updatePacket.data.updated.xPosition = m_mainPlayer->m_currentPosition.x;
 	updatePacket.data.updated.yPosition = m_mainPlayer->m_currentPosition.y;
 	updatePacket.data.updated.xVelocity = m_mainPlayer->m_currentVelocity.x;
@@ -419,6 +580,23 @@ void World::SendUpdate()
 	updatePacket.data.updated.yawDegrees = m_mainPlayer->m_orientationDegrees;
 
 	SendPacket( updatePacket, false );
+	m_updateScheduler.RecordUpdate( reason, m_mainPlayer->m_currentPosition, m_mainPlayer->m_currentVelocity, m_mainPlayer->m_orientationDegrees, currentTime );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void World::SendHeartbeat()
+{
+	if( ( GetCurrentTimeSeconds() - m_timeOfLastHeartbeat ) < SECONDS_BEFORE_SEND_HEARTBEAT_PACKET )
+		return;
+
+	LobbyPacket heartbeatPacket;
+	heartbeatPacket.packetType = LOBBY_TYPE_Heartbeat;
+	heartbeatPacket.timestamp = GetCurrentTimeSeconds();
+	heartbeatPacket.data.challenge.cookie = m_lobbyCookie;
+
+	SendPacket( heartbeatPacket, false );
+	m_timeOfLastHeartbeat = heartbeatPacket.timestamp;
 }
 
 
@@ -426,11 +604,11 @@ void World::SendUpdate()
 void World::SendVictory()
 {
 	CS6Packet victoryPacket;
-	victoryPacket.packetNumber = m_nextPacketNumber;
 	victoryPacket.packetType = TYPE_Victory;
 	victoryPacket.playerColorAndID[0] = m_mainPlayer->m_color.r;
 	victoryPacket.playerColorAndID[1] = m_mainPlayer->m_color.g;
 	victoryPacket.playerColorAndID[2] = m_mainPlayer->m_color.b;
+	victoryPacket.playerID = m_mainPlayer->m_playerID;
 	victoryPacket.timestamp = GetCurrentTimeSeconds();
 	victoryPacket.data.victorious.playerColorAndID[0] = m_mainPlayer->m_color.r;
 	victoryPacket.data.victorious.playerColorAndID[1] = m_mainPlayer->m_color.g;
@@ -457,31 +635,19 @@ void World::CheckForFlagCapture()
 
 
 //-----------------------------------------------------------------------------------------------
-void World::AcknowledgeGameOver( const CS6Packet& gameOverPacket )
+//Nothing more goes to this game once we leave it, so the ack can't wait for another packet
+void World::AcknowledgeGameOver( const CS6Packet& gameOverPacket, double arrivalTimeSeconds )
 {
-	CS6Packet ackPacket;
-	ackPacket.packetNumber = m_nextPacketNumber;
-	ackPacket.packetType = TYPE_Acknowledge;
-	ackPacket.playerColorAndID[0] = m_mainPlayer->m_color.r;
-	ackPacket.playerColorAndID[1] = m_mainPlayer->m_color.g;
-	ackPacket.playerColorAndID[2] = m_mainPlayer->m_color.b;
-	ackPacket.timestamp = GetCurrentTimeSeconds();
-	ackPacket.data.acknowledged.packetNumber = gameOverPacket.packetNumber;
-	ackPacket.data.acknowledged.packetType = TYPE_GameOver;
-
-	SendPacket( ackPacket, false );
+	QueueAck( gameOverPacket, arrivalTimeSeconds );
+	SendPendingAck();
 
-	for( unsigned int playerIndex = 0; playerIndex < m_players.size(); ++playerIndex )
+	for( unsigned int playerIndex = 0; playerIndex < m_remotePlayers.GetNumberOfPlayers(); ++playerIndex )
 	{
-		Player* player = m_players.back();
-		if( player != m_mainPlayer )
-		{
-			delete player;
-			m_players.pop_back();
-			--playerIndex;
-		}
+		m_playerIndexByID[ m_remotePlayers.m_playerIDs[ playerIndex ] ] = INVALID_PLAYER_INDEX;
 	}
 
+	m_remotePlayers.Clear();
+
 	ChangePortNumber( PORT_NUMBER );
 
 	m_isConnectedToGame = false;
@@ -490,7 +656,7 @@ void World::AcknowledgeGameOver( const CS6Packet& gameOverPacket )
 
 
 //-----------------------------------------------------------------------------------------------
-void World::UpdateLobbyGames( const LobbyPacket& updatePacket )
+void World::UpdateLobbyGames( const LobbyPacket& updatePacket, double arrivalTimeSeconds )
 {
 	for( unsigned int gameIndex = 0; gameIndex < m_lobbyGames.size(); ++gameIndex )
 	{
@@ -499,7 +665,7 @@ void World::UpdateLobbyGames( const LobbyPacket& updatePacket )
 		{
 			game.m_numPlayersInGame = updatePacket.data.update.numPlayersInGame;
 			game.m_ownerName = updatePacket.data.update.gameOwner;
-			game.m_lastUpdateTime = GetCurrentTimeSeconds();
+			game.m_lastUpdateTime = arrivalTimeSeconds;
 			return;
 		}
 	}
@@ -508,8 +674,9 @@ void World::UpdateLobbyGames( const LobbyPacket& updatePacket )
 	game.m_id = updatePacket.data.update.gameID;
 	game.m_numPlayersInGame = updatePacket.data.update.numPlayersInGame;
 	game.m_ownerName = updatePacket.data.update.gameOwner;
-	game.m_lastUpdateTime = GetCurrentTimeSeconds();
+	game.m_lastUpdateTime = arrivalTimeSeconds;
 	m_lobbyGames.push_back( game );
+	m_timers.AddTimer( MakeTimerID( WORLD_TIMER_LobbyGameTimeout, game.m_id ), game.m_lastUpdateTime + SECONDS_BEFORE_TIMEOUT_REMOVE );
 }
 
 
@@ -521,7 +688,6 @@ void World::ResendAckPackets()
 		CS6Packet* packet = &m_sentGamePackets[ packetIndex ];
 		if( ( GetCurrentTimeSeconds() - packet->timestamp ) > SECONDS_BEFORE_RESEND_INIT_PACKET )
 		{
-			packet->packetNumber = m_nextPacketNumber;
 			packet->timestamp = GetCurrentTimeSeconds();
 			SendPacket( *packet, false );
 		}
@@ -532,7 +698,6 @@ void World::ResendAckPackets()
 		LobbyPacket* packet = &m_sentLobbyPackets[ packetIndex ];
 		if( ( GetCurrentTimeSeconds() - packet->timestamp ) > SECONDS_BEFORE_RESEND_INIT_PACKET )
 		{
-			packet->packetNumber = m_nextPacketNumber;
 			packet->timestamp = GetCurrentTimeSeconds();
 			SendPacket( *packet, false );
 		}
@@ -543,18 +708,7 @@ void World::ResendAckPackets()
 //-----------------------------------------------------------------------------------------------
 void World::ApplyDeadReckoning()
 {
-	for( unsigned int playerIndex = 0; playerIndex < m_players.size(); ++playerIndex )
-	{
-		Player* player = m_players[ playerIndex ];
-		if( player == m_mainPlayer )
-			continue;
-
-		float deltaSeconds = (float) ( GetCurrentTimeSeconds() - player->m_timeOfLastUpdate );
-		player->m_currentPosition = player->m_lastUpdatePosition + player->m_currentVelocity * deltaSeconds;
-
-		player->m_currentPosition.x = ClampFloat( player->m_currentPosition.x, 0.f, m_size.x );
-		player->m_currentPosition.y = ClampFloat( player->m_currentPosition.y, 0.f, m_size.y );
-	}
+	m_remotePlayers.ApplyDeadReckoning( GetCurrentTimeSeconds(), m_size.x, m_size.y );
 }
 
 
@@ -571,27 +725,62 @@ void World::ReceivePackets()
 //-----------------------------------------------------------------------------------------------
 void World::ReceiveLobbyPackets()
 {
-	LobbyPacket packet;
-	std::set< LobbyPacket > recvPackets;
+#ifdef _DEBUG
+	size_t numAllocationsBeforeReceive = MemoryManager::GetNumberOfAllocationRequest();
+#endif
 
-	while( m_client.ReceivePacketFromServer( (char*) &packet, sizeof( packet ) ) )
+	m_lobbyReceiveBatch.Clear();
+	LobbyPacket* packet = m_lobbyReceiveBatch.GetNextPacketToFill();
+	const ReceivedPacket* receivedPacket = m_networkThread.PeekReceivedPacket();
+	while( packet && receivedPacket )
 	{
-		recvPackets.insert( packet );
+		*packet = receivedPacket->m_lobbyPacket;
+		m_lobbyReceiveBatch.CommitPacket( receivedPacket->m_arrivalTimeSeconds );
+		m_networkThread.PopReceivedPacket();
+
+		packet = m_lobbyReceiveBatch.GetNextPacketToFill();
+		receivedPacket = m_networkThread.PeekReceivedPacket();
 	}
 
-	std::set< LobbyPacket >::iterator setIter;
-	for( setIter = recvPackets.begin(); setIter != recvPackets.end(); ++setIter )
+	m_lobbyReceiveBatch.SortPackets();
+
+#ifdef _DEBUG
+	RECOVERABLE_ASSERTION( ( MemoryManager::GetNumberOfAllocationRequest() == numAllocationsBeforeReceive ), "Lobby receive path allocated memory" );
+#endif
+
+	for( unsigned int packetIndex = 0; packetIndex < m_lobbyReceiveBatch.GetNumberOfPackets(); ++packetIndex )
 	{
-		LobbyPacket orderedPacket = *setIter;
+		const LobbyPacket& orderedPacket = m_lobbyReceiveBatch.GetPacket( packetIndex );
+		if( orderedPacket.packetType == LOBBY_TYPE_Challenge )
+		{
+			AnswerChallenge( orderedPacket );
+			continue;
+		}
+
+		//A connection ack opens a lobby session, including when a heartbeat let us back in after
+		//the lobby timed us out, and that session numbers its packets from zero again
+		if( orderedPacket.packetType == LOBBY_TYPE_Acknowledge && orderedPacket.data.acknowledged.packetType == LOBBY_TYPE_Acknowledge )
+			m_lobbyReceiveWindow.Reset();
+
+		//Lobby updates are resent periodically, so one older than what we already have is dropped
+		bool allowOutOfOrder = ( orderedPacket.packetType != LOBBY_TYPE_Update );
+		if( !m_lobbyReceiveWindow.AcceptSequence( orderedPacket.packetNumber, allowOutOfOrder ) )
+			continue;
+
+		m_serverClock.ReceiveTimestamps( orderedPacket.timestamp, orderedPacket.echoTimestamp, orderedPacket.echoHoldSeconds, m_lobbyReceiveBatch.GetArrivalTime( packetIndex ) );
 
 		if( orderedPacket.packetType == LOBBY_TYPE_Update )
 		{
-			UpdateLobbyGames( orderedPacket );
+			UpdateLobbyGames( orderedPacket, m_lobbyReceiveBatch.GetArrivalTime( packetIndex ) );
 		}
 		if( orderedPacket.packetType == LOBBY_TYPE_Acknowledge )
 		{
 			ProcessAckPackets( orderedPacket );
 		}
+		else if( orderedPacket.packetType == LOBBY_TYPE_Busy )
+		{
+			ProcessBusyPacket( orderedPacket );
+		}
 	}
 }
 
@@ -599,26 +788,68 @@ void World::ReceiveLobbyPackets()
 //-----------------------------------------------------------------------------------------------
 void World::ReceiveGamePackets()
 {
-	CS6Packet packet;
-	std::set< CS6Packet > recvPackets;
+#ifdef _DEBUG
+	size_t numAllocationsBeforeReceive = MemoryManager::GetNumberOfAllocationRequest();
+#endif
 
-	while( m_client.ReceivePacketFromServer( (char*) &packet, sizeof( packet ) ) )
+	m_gameReceiveBatch.Clear();
+	CS6Packet* packet = m_gameReceiveBatch.GetNextPacketToFill();
+	const ReceivedPacket* receivedPacket = m_networkThread.PeekReceivedPacket();
+	while( packet && receivedPacket )
 	{
-		recvPackets.insert( packet );
+		//A packet rebuilt from parity joins the batch as though it had arrived with the parity
+		bool isPacketInBatch = false;
+		if( receivedPacket->m_gamePacket.packetType == TYPE_Parity )
+		{
+			isPacketInBatch = m_parityDecoder.RebuildMissingPacket( receivedPacket->m_parityPacket, *packet );
+		}
+		else
+		{
+			*packet = receivedPacket->m_gamePacket;
+			if( packet->packetType != TYPE_Update )
+				m_parityDecoder.RememberPacket( *packet );
+
+			isPacketInBatch = true;
+		}
+
+		if( isPacketInBatch )
+			m_gameReceiveBatch.CommitPacket( receivedPacket->m_arrivalTimeSeconds );
+
+		m_networkThread.PopReceivedPacket();
+
+		packet = m_gameReceiveBatch.GetNextPacketToFill();
+		receivedPacket = m_networkThread.PeekReceivedPacket();
 	}
 
-	std::set< CS6Packet >::iterator setIter;
-	for( setIter = recvPackets.begin(); setIter != recvPackets.end(); ++setIter )
+	m_gameReceiveBatch.SortPackets();
+
+#ifdef _DEBUG
+	RECOVERABLE_ASSERTION( ( MemoryManager::GetNumberOfAllocationRequest() == numAllocationsBeforeReceive ), "Game receive path allocated memory" );
+#endif
+
+	for( unsigned int packetIndex = 0; packetIndex < m_gameReceiveBatch.GetNumberOfPackets(); ++packetIndex )
 	{
-		CS6Packet orderedPacket = *setIter;
+		const CS6Packet& orderedPacket = m_gameReceiveBatch.GetPacket( packetIndex );
+
+		//An ack from the server is good even on an update too stale to use
+		if( orderedPacket.ackedPacketType != TYPE_None )
+			RemoveAckedGamePacket( orderedPacket.ackedPacketNumber );
+
+		//A stale update would drag a remote player back to an older position, so drop it here
+		bool allowOutOfOrder = ( orderedPacket.packetType != TYPE_Update );
+		if( !m_gameReceiveWindow.AcceptSequence( orderedPacket.packetNumber, allowOutOfOrder ) )
+			continue;
+
+		m_serverClock.ReceiveTimestamps( orderedPacket.timestamp, orderedPacket.echoTimestamp, orderedPacket.echoHoldSeconds, m_gameReceiveBatch.GetArrivalTime( packetIndex ) );
 
 		if( orderedPacket.packetType == TYPE_Update )
 		{
-			UpdatePlayer( orderedPacket );
+			UpdatePlayer( orderedPacket, m_gameReceiveBatch.GetArrivalTime( packetIndex ) );
 		}
 		else if( orderedPacket.packetType == TYPE_Reset )
 		{
 			ResetGame( orderedPacket );
+			QueueAck( orderedPacket, m_gameReceiveBatch.GetArrivalTime( packetIndex ) );
 		}
 		else if( orderedPacket.packetType == TYPE_Acknowledge )
 		{
@@ -626,83 +857,129 @@ void World::ReceiveGamePackets()
 		}
 		else if( orderedPacket.packetType == TYPE_GameOver )
 		{
-			AcknowledgeGameOver( orderedPacket );
+			AcknowledgeGameOver( orderedPacket, m_gameReceiveBatch.GetArrivalTime( packetIndex ) );
 		}
 	}
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void World::RemoveTimedOutLobbyGames()
+void World::ProcessExpiredTimers()
 {
-	for( unsigned int gameIndex = 0; gameIndex < m_lobbyGames.size(); ++gameIndex )
+	double currentTime = GetCurrentTimeSeconds();
+
+	m_expiredTimerIDs.clear();
+	m_timers.AdvanceTime( currentTime, m_expiredTimerIDs );
+
+	for( unsigned int timerIndex = 0; timerIndex < m_expiredTimerIDs.size(); ++timerIndex )
 	{
-		GameInfo game = m_lobbyGames[ gameIndex ];
-		if( ( GetCurrentTimeSeconds() - game.m_lastUpdateTime ) > SECONDS_BEFORE_TIMEOUT_REMOVE )
+		unsigned int timerID = m_expiredTimerIDs[ timerIndex ];
+		if( GetTimerKind( timerID ) == WORLD_TIMER_LobbyGameTimeout )
+		{
+			RemoveTimedOutLobbyGame( GetTimerIndex( timerID ), currentTime );
+		}
+		else if( GetTimerKind( timerID ) == WORLD_TIMER_PlayerTimeout )
 		{
-			m_lobbyGames.erase( m_lobbyGames.begin() + gameIndex );
-			--gameIndex;
+			RemoveTimedOutPlayer( GetTimerIndex( timerID ), currentTime );
 		}
 	}
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void World::RemoveTimedOutPlayers()
+//Only runs when a game's timer fires, and updates only touch the timestamp, so a game that has
+//been heard from since is re-armed rather than removed
+void World::RemoveTimedOutLobbyGame( unsigned int gameTimerIndex, double currentTime )
 {
-	for( unsigned int playerIndex = 0; playerIndex < m_players.size(); ++playerIndex )
+	for( unsigned int gameIndex = 0; gameIndex < m_lobbyGames.size(); ++gameIndex )
 	{
-		Player* player = m_players[ playerIndex ];
-		if( ( GetCurrentTimeSeconds() - player->m_timeOfLastUpdate ) > SECONDS_BEFORE_TIMEOUT_REMOVE )
+		const GameInfo& game = m_lobbyGames[ gameIndex ];
+		if( GetTimerIndex( game.m_id ) != gameTimerIndex )
+			continue;
+
+		double timeoutTime = game.m_lastUpdateTime + SECONDS_BEFORE_TIMEOUT_REMOVE;
+		if( timeoutTime >= currentTime )
 		{
-			m_players.erase( m_players.begin() + playerIndex );
-			delete player;
-			--playerIndex;
+			m_timers.AddTimer( MakeTimerID( WORLD_TIMER_LobbyGameTimeout, game.m_id ), timeoutTime );
+			return;
 		}
+
+		m_lobbyGames.erase( m_lobbyGames.begin() + gameIndex );
+		return;
 	}
 }
 
 
+//-----------------------------------------------------------------------------------------------
+void World::RemoveTimedOutPlayer( unsigned int playerTimerIndex, double currentTime )
+{
+	//The low bits are the player id, and the spawn count above them tells a leftover timer from
+	//an earlier player with the same id apart from this one
+	unsigned short playerIndex = m_playerIndexByID[ playerTimerIndex & 0xffff ];
+	if( playerIndex == INVALID_PLAYER_INDEX )
+		return;
+
+	if( m_remotePlayers.m_timerIndices[ playerIndex ] != playerTimerIndex )
+		return;
+
+	double timeoutTime = m_remotePlayers.m_timeOfLastUpdate[ playerIndex ] + SECONDS_BEFORE_TIMEOUT_REMOVE;
+	if( timeoutTime >= currentTime )
+	{
+		m_timers.AddTimer( MakeTimerID( WORLD_TIMER_PlayerTimeout, playerTimerIndex ), timeoutTime );
+		return;
+	}
+
+	RemovePlayerAtIndex( playerIndex );
+}
+
+
 //-----------------------------------------------------------------------------------------------
 void World::RenderPlayers()
 {
 	OpenGLRenderer::EnableTexture2D();
 	OpenGLRenderer::BindTexture2D( m_playerTexture->m_openglTextureID );
 
-	for( unsigned int playerIndex = 0; playerIndex < m_players.size(); ++playerIndex )
+	RenderPlayer( m_mainPlayer->m_color, m_mainPlayer->m_currentPosition.x, m_mainPlayer->m_currentPosition.y, m_mainPlayer->m_orientationDegrees );
+	for( unsigned int playerIndex = 0; playerIndex < m_remotePlayers.GetNumberOfPlayers(); ++playerIndex )
 	{
-		Player* player = m_players[ playerIndex ];
-		float colorR = player->m_color.r * ONE_OVER_TWO_HUNDRED_TWENTY_FIVE;
-		float colorG = player->m_color.g * ONE_OVER_TWO_HUNDRED_TWENTY_FIVE;
-		float colorB = player->m_color.b * ONE_OVER_TWO_HUNDRED_TWENTY_FIVE;
+		RenderPlayer( m_remotePlayers.m_colors[ playerIndex ], m_remotePlayers.m_positionX[ playerIndex ], m_remotePlayers.m_positionY[ playerIndex ], m_remotePlayers.m_orientationDegrees[ playerIndex ] );
+	}
 
-		OpenGLRenderer::PushMatrix();
+	OpenGLRenderer::BindTexture2D( 0 );
+	OpenGLRenderer::DisableTexture2D();
+}
 
-		OpenGLRenderer::SetColor3f( colorR, colorG, colorB );
-		OpenGLRenderer::Translatef( player->m_currentPosition.x, player->m_currentPosition.y, 0.f );
-		OpenGLRenderer::Rotatef( -player->m_orientationDegrees, 0.f, 0.f, 1.f );
 
-		OpenGLRenderer::BeginRender( QUADS );
-		{
-			OpenGLRenderer::SetTexCoords2f( 0.f, 1.f );
-			OpenGLRenderer::SetVertex2f( -ONE_HALF_POINT_SIZE_PIXELS, -ONE_HALF_POINT_SIZE_PIXELS );
+//-----------------------------------------------------------------------------------------------
+void World::RenderPlayer( const Color3b& color, float positionX, float positionY, float orientationDegrees )
+{
+	float colorR = color.r * ONE_OVER_TWO_HUNDRED_TWENTY_FIVE;
+	float colorG = color.g * ONE_OVER_TWO_HUNDRED_TWENTY_FIVE;
+	float colorB = color.b * ONE_OVER_TWO_HUNDRED_TWENTY_FIVE;
 
-			OpenGLRenderer::SetTexCoords2f( 1.f, 1.f );
-			OpenGLRenderer::SetVertex2f( ONE_HALF_POINT_SIZE_PIXELS, -ONE_HALF_POINT_SIZE_PIXELS );
+	OpenGLRenderer::PushMatrix();
 
-			OpenGLRenderer::SetTexCoords2f( 1.f, 0.f );
-			OpenGLRenderer::SetVertex2f( ONE_HALF_POINT_SIZE_PIXELS, ONE_HALF_POINT_SIZE_PIXELS );
+	OpenGLRenderer::SetColor3f( colorR, colorG, colorB );
+	OpenGLRenderer::Translatef( positionX, positionY, 0.f );
+	OpenGLRenderer::Rotatef( -orientationDegrees, 0.f, 0.f, 1.f );
 
-			OpenGLRenderer::SetTexCoords2f( 0.f, 0.f );
-			OpenGLRenderer::SetVertex2f( -ONE_HALF_POINT_SIZE_PIXELS, ONE_HALF_POINT_SIZE_PIXELS );
-		}
-		OpenGLRenderer::EndRender();
+	OpenGLRenderer::BeginRender( QUADS );
+	{
+		OpenGLRenderer::SetTexCoords2f( 0.f, 1.f );
+		OpenGLRenderer::SetVertex2f( -ONE_HALF_POINT_SIZE_PIXELS, -ONE_HALF_POINT_SIZE_PIXELS );
+
+		OpenGLRenderer::SetTexCoords2f( 1.f, 1.f );
+		OpenGLRenderer::SetVertex2f( ONE_HALF_POINT_SIZE_PIXELS, -ONE_HALF_POINT_SIZE_PIXELS );
 
-		OpenGLRenderer::PopMatrix();
+		OpenGLRenderer::SetTexCoords2f( 1.f, 0.f );
+		OpenGLRenderer::SetVertex2f( ONE_HALF_POINT_SIZE_PIXELS, ONE_HALF_POINT_SIZE_PIXELS );
+
+		OpenGLRenderer::SetTexCoords2f( 0.f, 0.f );
+		OpenGLRenderer::SetVertex2f( -ONE_HALF_POINT_SIZE_PIXELS, ONE_HALF_POINT_SIZE_PIXELS );
 	}
+	OpenGLRenderer::EndRender();
 
-	OpenGLRenderer::BindTexture2D( 0 );
-	OpenGLRenderer::DisableTexture2D();
+	OpenGLRenderer::PopMatrix();
 }
 
 
@@ -12,7 +12,15 @@
 #include "CS6Packet.hpp"
 #include "UDPClient.hpp"
 #include "GameCommon.hpp"
+#include "ClockSync.hpp"
+#include "TimerWheel.hpp"
 #include "LobbyPacket.hpp"
+#include "ReceiveBatch.hpp"
+#include "NetworkThread.hpp"
+#include "RemotePlayers.hpp"
+#include "ParityGroup.hpp"
+#include "UpdateHistory.hpp"
+#include "UpdateScheduler.hpp"
 #include "../Engine/Clock.hpp"
 #include "../Engine/Mouse.hpp"
 #include "../Engine/Camera.hpp"
@@ -37,14 +45,25 @@ const float DISTANCE_FROM_FLAG_FOR_PICKUP_PIXELS = 10.f;
 const float POINT_SIZE_PIXELS = 30.f;
 const float ONE_HALF_POINT_SIZE_PIXELS = POINT_SIZE_PIXELS * 0.5f;
 const double SECONDS_BEFORE_RESEND_INIT_PACKET = 0.25;
-const double SECONDS_BEFORE_SEND_UPDATE_PACKET = 0.1;
+const double SECONDS_BEFORE_SEND_HEARTBEAT_PACKET = 1.0;
 const double SECONDS_BEFORE_TIMEOUT_REMOVE = 5.0;
+const double SECONDS_BEFORE_SEND_STANDALONE_ACK = 0.02;
+const unsigned int NUM_PLAYER_IDS = 0x10000;
+const unsigned short INVALID_PLAYER_INDEX = 0xffff;
 const unsigned short PORT_NUMBER = 5000;
 const std::string IP_ADDRESS = "127.0.0.1";
 const std::string FLAG_TEXTURE_FILE_PATH = "Data/Images/Flag.png";
 const std::string PLAYER_TEXTURE_FILE_PATH = "Data/Images/Player.png";
 
 
+//-----------------------------------------------------------------------------------------------
+enum WorldTimerKind
+{
+	WORLD_TIMER_LobbyGameTimeout,
+	WORLD_TIMER_PlayerTimeout,
+};
+
+
 //-----------------------------------------------------------------------------------------------
 class World
 {
@@ -55,6 +74,7 @@ public:
 	void ChangeIPAddress( const std::string& ipAddrString );
 	void ChangePortNumber( unsigned short portNumber );
 	void ShowLobbyGames();
+	void ShowClockSync();
 	void CreateLobbyGame();
 	void JoinLobbyGame( unsigned int gameID );
 	void Update( float deltaSeconds, const Keyboard& keyboard, const Mouse& mouse );
@@ -62,46 +82,73 @@ public:
 	void RenderObjects2D();
 
 private:
-	void SendPacket( const CS6Packet& pkt, bool requireAck );
-	void SendPacket( const LobbyPacket& pkt, bool requireAck );
+	void SendPacket( CS6Packet& pkt, bool requireAck );
+	void SendPacket( LobbyPacket& pkt, bool requireAck );
 	void SendJoinGamePacket();
 	void ProcessAckPackets( const CS6Packet& ackPacket );
+	void RemoveAckedGamePacket( SequenceNumber ackedPacketNumber );
+	void QueueAck( const CS6Packet& reliablePacket, double arrivalTimeSeconds );
+	void SendPendingAck();
+	void SendDelayedAck();
 	void ProcessAckPackets( const LobbyPacket& ackPacket );
+	void AnswerChallenge( const LobbyPacket& challengePacket );
+	void ProcessBusyPacket( const LobbyPacket& busyPacket );
 	void ResetGame( const CS6Packet& resetPacket );
-	void UpdatePlayer( const CS6Packet& updatePacket );
+	void UpdatePlayer( const CS6Packet& updatePacket, double arrivalTimeSeconds );
+	void RemovePlayerAtIndex( unsigned int playerIndex );
 	void UpdateFromInput( const Keyboard& keyboard, const Mouse& mouse, float deltaSeconds );
 	void SendUpdate();
+	void SendHeartbeat();
 	void SendVictory();
 	void CheckForFlagCapture();
-	void AcknowledgeGameOver( const CS6Packet& gameOverPacket );
-	void UpdateLobbyGames( const LobbyPacket& updatePacket );
+	void AcknowledgeGameOver( const CS6Packet& gameOverPacket, double arrivalTimeSeconds );
+	void UpdateLobbyGames( const LobbyPacket& updatePacket, double arrivalTimeSeconds );
 	void ResendAckPackets();
 	void ApplyDeadReckoning();
 	void ReceivePackets();
 	void ReceiveLobbyPackets();
 	void ReceiveGamePackets();
-	void RemoveTimedOutLobbyGames();
-	void RemoveTimedOutPlayers();
+	void ProcessExpiredTimers();
+	void RemoveTimedOutLobbyGame( unsigned int gameTimerIndex, double currentTime );
+	void RemoveTimedOutPlayer( unsigned int playerTimerIndex, double currentTime );
 	void RenderPlayers();
+	void RenderPlayer( const Color3b& color, float positionX, float positionY, float orientationDegrees );
 	void RenderFlag();
 
-	Camera						m_camera;
-	Vector2						m_size;
-	Texture*					m_playerTexture;
-	Texture*					m_flagTexture;
-	UDPClient					m_client;
-	bool						m_isConnectedToServer;
-	bool						m_isConnectedToGame;
-	bool						m_hasInitializedGame;
-	bool						m_hasFlag;
-	unsigned int				m_nextPacketNumber;
-	double						m_secondsSinceLastInitSend;
-	Vector2						m_flagPosition;
-	Player*						m_mainPlayer;
-	std::vector< GameInfo >		m_lobbyGames;
-	std::vector< Player* >		m_players;
-	std::vector< CS6Packet >	m_sentGamePackets;
-	std::vector< LobbyPacket >	m_sentLobbyPackets;
+	Camera							m_camera;
+	Vector2							m_size;
+	Texture*						m_playerTexture;
+	Texture*						m_flagTexture;
+	UDPClient						m_client;
+	NetworkThread					m_networkThread;
+	bool							m_isConnectedToServer;
+	bool							m_isConnectedToGame;
+	bool							m_hasInitializedGame;
+	bool							m_hasFlag;
+	unsigned long long				m_lobbyCookie;
+	unsigned int					m_numPlayersSpawned;
+	double							m_secondsSinceLastInitSend;
+	double							m_timeOfLastHeartbeat;
+	Vector2							m_flagPosition;
+	Player*							m_mainPlayer;
+	std::vector< GameInfo >			m_lobbyGames;
+	RemotePlayers					m_remotePlayers;
+	std::vector< unsigned short >	m_playerIndexByID;
+	std::vector< CS6Packet >		m_sentGamePackets;
+	std::vector< LobbyPacket >		m_sentLobbyPackets;
+	ReceiveBatch< CS6Packet >		m_gameReceiveBatch;
+	ReceiveBatch< LobbyPacket >		m_lobbyReceiveBatch;
+	SequenceWindow					m_gameReceiveWindow;
+	SequenceWindow					m_lobbyReceiveWindow;
+	ClockSync						m_serverClock;
+	PacketType						m_pendingAckType;
+	SequenceNumber					m_pendingAckNumber;
+	double							m_pendingAckDeadline;
+	UpdateHistory					m_updateHistory;
+	UpdateScheduler					m_updateScheduler;
+	ParityDecoder					m_parityDecoder;
+	TimerWheel						m_timers;
+	std::vector< unsigned int >		m_expiredTimerIDs;
 };
 
 
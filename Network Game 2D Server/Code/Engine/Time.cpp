@@ -1,33 +1,213 @@
 #include <windows.h>
+#include <intrin.h>
 #include <assert.h>
 #include "Time.hpp"
 #define WIN32_LEAN_AND_MEAN
 
 
 //-----------------------------------------------------------------------------------------------
-static double g_secondsPerCount = 0.0;
+//Nanoseconds per count as a whole part plus a fraction out of 2^32, so a count converts with
+//integer multiplies and shifts and never needs a divide
+struct CounterScale
+{
+	unsigned long long	m_wholeNanoseconds;
+	unsigned long long	m_fractionNanoseconds;
+	unsigned long long	m_baseCount;
+	TimeTicks			m_baseTicks;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+static const double SECONDS_TO_CALIBRATE_CYCLE_COUNTER = 0.05;
+static const unsigned int INVARIANT_CYCLE_COUNTER_BIT = 1 << 8;
+
+static bool g_isTimeInitialized = false;
+static CounterScale g_performanceScale;
+static CounterScale g_cycleScale;
+static TimeCounter g_timeCounter = TIME_COUNTER_Performance;
+static TimeSourceFunc g_timeSource = nullptr;
+static TimeTicks g_frameTimeTicks = 0;
+static double g_frameTimeSeconds = 0.0;
+
+
+//-----------------------------------------------------------------------------------------------
+static void SetCounterScale( CounterScale& scale, double countsPerSecond, unsigned long long baseCount, TimeTicks baseTicks )
+{
+	double nanosecondsPerCount = (double) TIME_TICKS_PER_SECOND / countsPerSecond;
+	scale.m_wholeNanoseconds = (unsigned long long) nanosecondsPerCount;
+	scale.m_fractionNanoseconds = (unsigned long long) ( ( nanosecondsPerCount - (double) scale.m_wholeNanoseconds ) * 4294967296.0 );
+	scale.m_baseCount = baseCount;
+	scale.m_baseTicks = baseTicks;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The count is split in halves so the fractional multiply can't overflow 64 bits
+static TimeTicks ConvertCountToTicks( const CounterScale& scale, unsigned long long count )
+{
+	unsigned long long elapsedCounts = count - scale.m_baseCount;
+	unsigned long long fractionTicks = ( elapsedCounts >> 32 ) * scale.m_fractionNanoseconds + ( ( ( elapsedCounts & 0xffffffffULL ) * scale.m_fractionNanoseconds ) >> 32 );
+	return scale.m_baseTicks + elapsedCounts * scale.m_wholeNanoseconds + fractionTicks;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static unsigned long long ReadPerformanceCounter()
+{
+	LARGE_INTEGER performanceCount;
+	QueryPerformanceCounter( &performanceCount );
+	return (unsigned long long) performanceCount.QuadPart;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Only a counter that runs at a constant rate through power states and across cores can be trusted
+static bool HasInvariantCycleCounter()
+{
+	int cpuInfo[ 4 ];
+	__cpuid( cpuInfo, 0x80000000 );
+	if( (unsigned int) cpuInfo[ 0 ] < 0x80000007 )
+		return false;
+
+	__cpuid( cpuInfo, 0x80000007 );
+	return ( (unsigned int) cpuInfo[ 3 ] & INVARIANT_CYCLE_COUNTER_BIT ) != 0;
+}
 
 
 //-----------------------------------------------------------------------------------------------
 void InitializeTime()
 {
-	if( g_secondsPerCount == 0.0 )
+	if( !g_isTimeInitialized )
 	{
 		LARGE_INTEGER countsPerSecond;
 		QueryPerformanceFrequency( &countsPerSecond );
-		g_secondsPerCount = 1.0 / static_cast< double >( countsPerSecond.QuadPart );
+		SetCounterScale( g_performanceScale, static_cast< double >( countsPerSecond.QuadPart ), 0, 0 );
+		g_isTimeInitialized = true;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The cycle counter is timed against the performance counter over a short spin, then offset so
+//both give the same ticks at that moment. Returns false, leaving the performance counter in
+//charge, if the CPU's cycle counter can't be used as a clock
+bool SetTimeCounter( TimeCounter counter )
+{
+	InitializeTime();
+
+	if( counter == TIME_COUNTER_Performance )
+	{
+		g_timeCounter = counter;
+		return true;
+	}
+
+	if( !HasInvariantCycleCounter() )
+		return false;
+
+	unsigned long long startCount = ReadPerformanceCounter();
+	unsigned long long startCycle = __rdtsc();
+	TimeTicks startTicks = ConvertCountToTicks( g_performanceScale, startCount );
+
+	TimeTicks endTicks = startTicks;
+	unsigned long long endCycle = startCycle;
+	while( endTicks - startTicks < ConvertSecondsToTicks( SECONDS_TO_CALIBRATE_CYCLE_COUNTER ) )
+	{
+		endTicks = ConvertCountToTicks( g_performanceScale, ReadPerformanceCounter() );
+		endCycle = __rdtsc();
 	}
+
+	double cyclesPerSecond = (double) ( endCycle - startCycle ) / ConvertTicksToSeconds( endTicks - startTicks );
+	SetCounterScale( g_cycleScale, cyclesPerSecond, endCycle, endTicks );
+	g_timeCounter = counter;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Lets a simulation drive every timeout and resend from its own clock. Pass nullptr to go back to
+//the hardware counter
+void SetTimeSource( TimeSourceFunc timeSource )
+{
+	g_timeSource = timeSource;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Call once at the top of each pass of the main loop. Threads other than the main loop should
+//read the current time instead
+void UpdateFrameTime()
+{
+	g_frameTimeTicks = GetCurrentTimeTicks();
+	g_frameTimeSeconds = g_timeSource ? g_timeSource() : ConvertTicksToSeconds( g_frameTimeTicks );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double GetFrameTimeSeconds()
+{
+	return g_frameTimeSeconds;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+TimeTicks GetFrameTimeTicks()
+{
+	return g_frameTimeTicks;
 }
 
 
 //-----------------------------------------------------------------------------------------------
 double GetCurrentTimeSeconds()
 {
-	assert( g_secondsPerCount != 0.0 );
+	if( g_timeSource )
+		return g_timeSource();
 
-	LARGE_INTEGER performanceCount;
-	QueryPerformanceCounter(  &performanceCount );
+	return GetRealTimeSeconds();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+TimeTicks GetCurrentTimeTicks()
+{
+	if( g_timeSource )
+		return ConvertSecondsToTicks( g_timeSource() );
+
+	return GetRealTimeTicks();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Always the hardware counter, whatever the time source is
+double GetRealTimeSeconds()
+{
+	return ConvertTicksToSeconds( GetRealTimeTicks() );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+TimeTicks GetRealTimeTicks()
+{
+	assert( g_isTimeInitialized );
+
+	if( g_timeCounter == TIME_COUNTER_Cycle )
+		return ConvertCountToTicks( g_cycleScale, __rdtsc() );
+
+	return ConvertCountToTicks( g_performanceScale, ReadPerformanceCounter() );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double ConvertTicksToSeconds( TimeTicks ticks )
+{
+	return static_cast< double >( ticks ) * ( 1.0 / static_cast< double >( TIME_TICKS_PER_SECOND ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+TimeTicks ConvertSecondsToTicks( double seconds )
+{
+	if( seconds <= 0.0 )
+		return 0;
 
-	double currentSeconds = static_cast< double >( performanceCount.QuadPart ) * g_secondsPerCount;
-	return currentSeconds;
+	return static_cast< TimeTicks >( seconds * static_cast< double >( TIME_TICKS_PER_SECOND ) );
 }
\ No newline at end of file
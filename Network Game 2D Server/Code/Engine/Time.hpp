@@ -3,8 +3,34 @@
 #pragma once
 
 //-----------------------------------------------------------------------------------------------
+typedef double (*TimeSourceFunc)();
+typedef unsigned long long TimeTicks;
+const TimeTicks TIME_TICKS_PER_SECOND = 1000000000ULL;
+
+
+//-----------------------------------------------------------------------------------------------
+enum TimeCounter
+{
+	TIME_COUNTER_Performance,
+	TIME_COUNTER_Cycle,
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Ticks are whole nanoseconds. The frame time is only captured by UpdateFrameTime, so everything
+//on the main loop that reads it in one pass sees the same instant
 void InitializeTime();
+bool SetTimeCounter( TimeCounter counter );
+void SetTimeSource( TimeSourceFunc timeSource );
+void UpdateFrameTime();
+double GetFrameTimeSeconds();
+TimeTicks GetFrameTimeTicks();
 double GetCurrentTimeSeconds();
+TimeTicks GetCurrentTimeTicks();
+double GetRealTimeSeconds();
+TimeTicks GetRealTimeTicks();
+double ConvertTicksToSeconds( TimeTicks ticks );
+TimeTicks ConvertSecondsToTicks( double seconds );
 
 
 #endif // include_Time
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "AllocationCounter.hpp"
+#include <crtdbg.h>
+
+
+#ifdef _DEBUG
+//-----------------------------------------------------------------------------------------------
+static __declspec( thread ) unsigned int t_numAllocations = 0;
+static bool g_isCountingAllocations = false;
+
+
+//-----------------------------------------------------------------------------------------------
+static int CountAllocationHook( int allocationType, void*, size_t, int, long, const unsigned char*, int )
+{
+	if( allocationType == _HOOK_ALLOC || allocationType == _HOOK_REALLOC )
+		++t_numAllocations;
+
+	return 1;
+}
+#endif
+
+
+//-----------------------------------------------------------------------------------------------
+//Safe to call more than once
+void InstallAllocationCounter()
+{
+#ifdef _DEBUG
+	if( g_isCountingAllocations )
+		return;
+
+	_CrtSetAllocHook( CountAllocationHook );
+	g_isCountingAllocations = true;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool IsCountingAllocations()
+{
+#ifdef _DEBUG
+	return g_isCountingAllocations;
+#else
+	return false;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Only the calling thread's, so another thread allocating meanwhile never shows up in a count
+unsigned int GetNumberOfThreadAllocations()
+{
+#ifdef _DEBUG
+	return t_numAllocations;
+#else
+	return 0;
+#endif
+}
\ No newline at end of file
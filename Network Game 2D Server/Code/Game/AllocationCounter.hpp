@@ -0,0 +1,13 @@
+#ifndef include_AllocationCounter
+#define include_AllocationCounter
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+//Counts the heap allocations each thread makes, through the debug CRT's allocation hook. Release
+//builds have no hook, so there nothing is counted and every count stays at zero
+void InstallAllocationCounter();
+bool IsCountingAllocations();
+unsigned int GetNumberOfThreadAllocations();
+
+
+#endif // include_AllocationCounter
\ No newline at end of file
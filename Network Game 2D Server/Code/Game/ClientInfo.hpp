@@ -3,11 +3,19 @@
 #pragma once
 
 //-----------------------------------------------------------------------------------------------
+#include <string>
+#include <WinSock2.h>
+
+
+//-----------------------------------------------------------------------------------------------
+//Address and port are both kept in network byte order, exactly as they come off the socket
 struct ClientInfo
 {
 	bool operator<( const ClientInfo& info ) const;
+	bool operator==( const ClientInfo& info ) const;
+	std::string GetIPAddressString() const;
 
-	char*			m_ipAddress;
+	unsigned long	m_ipAddress;
 	unsigned short	m_portNumber;
 };
 
@@ -29,4 +37,41 @@ inline bool ClientInfo::operator<( const ClientInfo& info ) const
 }
 
 
+//-----------------------------------------------------------------------------------------------
+inline bool ClientInfo::operator==( const ClientInfo& info ) const
+{
+	return m_ipAddress == info.m_ipAddress && m_portNumber == info.m_portNumber;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline std::string ClientInfo::GetIPAddressString() const
+{
+	struct in_addr ipAddr;
+	ipAddr.s_addr = m_ipAddress;
+	return std::string( inet_ntoa( ipAddr ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Cheap multiplicative mix for the open-addressed tables keyed by address
+inline unsigned int HashClientInfo( const ClientInfo& info )
+{
+	unsigned int hash = (unsigned int) info.m_ipAddress * 2654435761u;
+	hash ^= (unsigned int) info.m_portNumber * 40503u;
+	hash ^= hash >> 15;
+	return hash;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline ClientInfo GetClientInfoForAddress( const struct sockaddr_in& clientAddr )
+{
+	ClientInfo info;
+	info.m_ipAddress = clientAddr.sin_addr.s_addr;
+	info.m_portNumber = clientAddr.sin_port;
+	return info;
+}
+
+
 #endif // include_ClientInfo
\ No newline at end of file
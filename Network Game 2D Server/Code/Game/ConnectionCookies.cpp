@@ -0,0 +1,104 @@
+#define _CRT_RAND_S
+#include "ConnectionCookies.hpp"
+#include <stdlib.h>
+
+
+//-----------------------------------------------------------------------------------------------
+inline unsigned long long RotateLeft( unsigned long long value, int numBits )
+{
+	return ( value << numBits ) | ( value >> ( 64 - numBits ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+inline void SipRound( unsigned long long& v0, unsigned long long& v1, unsigned long long& v2, unsigned long long& v3 )
+{
+	v0 += v1; v1 = RotateLeft( v1, 13 ); v1 ^= v0; v0 = RotateLeft( v0, 32 );
+	v2 += v3; v3 = RotateLeft( v3, 16 ); v3 ^= v2;
+	v0 += v3; v3 = RotateLeft( v3, 21 ); v3 ^= v0;
+	v2 += v1; v1 = RotateLeft( v1, 17 ); v1 ^= v2; v2 = RotateLeft( v2, 32 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//SipHash-2-4 of a 16 byte message given as two little-endian words
+unsigned long long SipHash16( const unsigned long long key[ 2 ], unsigned long long message0, unsigned long long message1 )
+{
+	unsigned long long v0 = key[ 0 ] ^ 0x736f6d6570736575ULL;
+	unsigned long long v1 = key[ 1 ] ^ 0x646f72616e646f6dULL;
+	unsigned long long v2 = key[ 0 ] ^ 0x6c7967656e657261ULL;
+	unsigned long long v3 = key[ 1 ] ^ 0x7465646279746573ULL;
+
+	v3 ^= message0;
+	SipRound( v0, v1, v2, v3 );
+	SipRound( v0, v1, v2, v3 );
+	v0 ^= message0;
+
+	v3 ^= message1;
+	SipRound( v0, v1, v2, v3 );
+	SipRound( v0, v1, v2, v3 );
+	v0 ^= message1;
+
+	unsigned long long lengthBlock = 16ULL << 56;
+	v3 ^= lengthBlock;
+	SipRound( v0, v1, v2, v3 );
+	SipRound( v0, v1, v2, v3 );
+	v0 ^= lengthBlock;
+
+	v2 ^= 0xff;
+	SipRound( v0, v1, v2, v3 );
+	SipRound( v0, v1, v2, v3 );
+	SipRound( v0, v1, v2, v3 );
+	SipRound( v0, v1, v2, v3 );
+
+	return v0 ^ v1 ^ v2 ^ v3;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+ConnectionCookies::ConnectionCookies()
+{
+	m_secretKey[ 0 ] = 0;
+	m_secretKey[ 1 ] = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void ConnectionCookies::Initialize()
+{
+	//rand_s draws from the OS generator, unlike rand which is seeded from the clock
+	for( unsigned int keyIndex = 0; keyIndex < 2; ++keyIndex )
+	{
+		unsigned int lowBits = 0;
+		unsigned int highBits = 0;
+		rand_s( &lowBits );
+		rand_s( &highBits );
+		m_secretKey[ keyIndex ] = ( (unsigned long long) highBits << 32 ) | lowBits;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned long long ConnectionCookies::MakeCookie( const ClientInfo& info, double currentTime ) const
+{
+	return ComputeCookie( info, (unsigned int) ( currentTime / SECONDS_PER_COOKIE_EPOCH ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool ConnectionCookies::IsCookieValid( const ClientInfo& info, unsigned long long cookie, double currentTime ) const
+{
+	unsigned int epoch = (unsigned int) ( currentTime / SECONDS_PER_COOKIE_EPOCH );
+	if( cookie == ComputeCookie( info, epoch ) )
+		return true;
+
+	return epoch > 0 && cookie == ComputeCookie( info, epoch - 1 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned long long ConnectionCookies::ComputeCookie( const ClientInfo& info, unsigned int epoch ) const
+{
+	unsigned long long addressWord = ( (unsigned long long) info.m_portNumber << 32 ) | (unsigned int) info.m_ipAddress;
+	return SipHash16( m_secretKey, addressWord, epoch );
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef include_ConnectionCookies
+#define include_ConnectionCookies
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "ClientInfo.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const double SECONDS_PER_COOKIE_EPOCH = 30.0;
+
+
+//-----------------------------------------------------------------------------------------------
+//Stateless connection challenge in the spirit of SYN cookies. A cookie is a keyed MAC of the
+//client's address and the current epoch, so the server can check an echoed cookie without having
+//remembered handing it out. A cookie stays valid for the epoch it was made in and the next one
+class ConnectionCookies
+{
+public:
+	ConnectionCookies();
+	void Initialize();
+	unsigned long long MakeCookie( const ClientInfo& info, double currentTime ) const;
+	bool IsCookieValid( const ClientInfo& info, unsigned long long cookie, double currentTime ) const;
+
+private:
+	unsigned long long ComputeCookie( const ClientInfo& info, unsigned int epoch ) const;
+
+	unsigned long long	m_secretKey[ 2 ];
+};
+
+
+#endif // include_ConnectionCookies
\ No newline at end of file
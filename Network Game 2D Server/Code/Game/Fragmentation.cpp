@@ -0,0 +1,207 @@
+#include "Fragmentation.hpp"
+#include <string.h>
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int GetMaxDatagramBytesForMTU( unsigned int mtuBytes )
+{
+	if( mtuBytes < MIN_MTU_BYTES )
+		mtuBytes = MIN_MTU_BYTES;
+	else if( mtuBytes > MAX_MTU_BYTES )
+		mtuBytes = MAX_MTU_BYTES;
+
+	return mtuBytes - IP_AND_UDP_HEADER_BYTES;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Zero when the message is too large to be sent at all
+unsigned int GetNumberOfFragments( unsigned int messageBytes, unsigned int maxDatagramBytes )
+{
+	if( messageBytes > MAX_MESSAGE_BYTES )
+		return 0;
+
+	unsigned int payloadBytesPerFragment = maxDatagramBytes - sizeof( FragmentHeader );
+	unsigned int numFragments = ( messageBytes + payloadBytesPerFragment - 1 ) / payloadBytesPerFragment;
+	if( numFragments > MAX_FRAGMENTS_PER_MESSAGE )
+		return 0;
+
+	return numFragments;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int BuildFragment( const char* message, unsigned int messageBytes, unsigned short messageID, unsigned int fragmentIndex, unsigned int maxDatagramBytes, char* out_datagram )
+{
+	unsigned int payloadBytesPerFragment = maxDatagramBytes - sizeof( FragmentHeader );
+	unsigned int fragmentOffset = fragmentIndex * payloadBytesPerFragment;
+	unsigned int fragmentBytes = messageBytes - fragmentOffset;
+	if( fragmentBytes > payloadBytesPerFragment )
+		fragmentBytes = payloadBytesPerFragment;
+
+	FragmentHeader header;
+	header.packetType = FRAGMENT_PACKET_TYPE;
+	header.fragmentIndex = (unsigned char) fragmentIndex;
+	header.numFragments = (unsigned char) GetNumberOfFragments( messageBytes, maxDatagramBytes );
+	header.reserved = 0;
+	header.messageID = messageID;
+	header.messageBytes = (unsigned short) messageBytes;
+	header.fragmentOffset = (unsigned short) fragmentOffset;
+	header.fragmentBytes = (unsigned short) fragmentBytes;
+
+	memcpy( out_datagram, &header, sizeof( header ) );
+	memcpy( out_datagram + sizeof( header ), message + fragmentOffset, fragmentBytes );
+
+	return sizeof( header ) + fragmentBytes;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+MessageReassembler::MessageReassembler()
+	: m_numAbandonedMessages( 0 )
+{
+	for( unsigned int slotIndex = 0; slotIndex < NUM_REASSEMBLY_SLOTS; ++slotIndex )
+	{
+		m_slots[ slotIndex ].m_isInUse = false;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void MessageReassembler::Initialize()
+{
+	m_buffers.assign( NUM_REASSEMBLY_SLOTS * MAX_MESSAGE_BYTES, 0 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Returns the whole message once its last fragment lands, and nullptr until then. The returned
+//buffer is only valid until the next call
+const char* MessageReassembler::AddFragment( unsigned long long sourceKey, const char* datagram, unsigned int datagramBytes, double currentTimeSeconds, unsigned int& out_messageBytes )
+{
+	if( datagramBytes < sizeof( FragmentHeader ) || m_buffers.empty() )
+		return nullptr;
+
+	FragmentHeader header;
+	memcpy( &header, datagram, sizeof( header ) );
+
+	//Anything inconsistent is dropped rather than trusted, since these come straight off the wire
+	if( header.numFragments == 0 || header.numFragments > MAX_FRAGMENTS_PER_MESSAGE || header.fragmentIndex >= header.numFragments )
+		return nullptr;
+
+	if( header.messageBytes > MAX_MESSAGE_BYTES || header.fragmentBytes != datagramBytes - sizeof( header ) )
+		return nullptr;
+
+	if( (unsigned int) header.fragmentOffset + header.fragmentBytes > header.messageBytes )
+		return nullptr;
+
+	//Every fragment but the last carries the same payload and they sit end to end, with the last
+	//one running to the end of the message. Holding every fragment to that layout is what lets a
+	//full count of fragments mean every byte of the message is covered
+	unsigned int fragmentPayloadBytes = 0;
+	if( header.fragmentIndex + 1 < header.numFragments )
+	{
+		if( header.fragmentBytes == 0 || header.fragmentOffset != header.fragmentIndex * header.fragmentBytes )
+			return nullptr;
+
+		fragmentPayloadBytes = header.fragmentBytes;
+	}
+	else
+	{
+		if( (unsigned int) header.fragmentOffset + header.fragmentBytes != header.messageBytes )
+			return nullptr;
+
+		if( header.fragmentIndex > 0 )
+		{
+			if( header.fragmentOffset == 0 || header.fragmentOffset % header.fragmentIndex != 0 )
+				return nullptr;
+
+			fragmentPayloadBytes = header.fragmentOffset / header.fragmentIndex;
+		}
+	}
+
+	unsigned int slotIndex = FindOrClaimSlot( sourceKey, header, currentTimeSeconds );
+	ReassemblySlot& slot = m_slots[ slotIndex ];
+	if( slot.m_numFragments != header.numFragments || slot.m_messageBytes != header.messageBytes )
+		return nullptr;
+
+	if( fragmentPayloadBytes != 0 )
+	{
+		if( slot.m_fragmentPayloadBytes == 0 )
+			slot.m_fragmentPayloadBytes = (unsigned short) fragmentPayloadBytes;
+		else if( slot.m_fragmentPayloadBytes != fragmentPayloadBytes )
+			return nullptr;
+	}
+
+	unsigned long long fragmentBit = 1ULL << header.fragmentIndex;
+	if( ( slot.m_receivedFragmentBits & fragmentBit ) != 0 )
+		return nullptr;
+
+	char* buffer = &m_buffers[ slotIndex * MAX_MESSAGE_BYTES ];
+	memcpy( buffer + header.fragmentOffset, datagram + sizeof( header ), header.fragmentBytes );
+	slot.m_receivedFragmentBits |= fragmentBit;
+	++slot.m_numFragmentsReceived;
+
+	if( slot.m_numFragmentsReceived < slot.m_numFragments )
+		return nullptr;
+
+	slot.m_isInUse = false;
+	out_messageBytes = slot.m_messageBytes;
+	return buffer;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int MessageReassembler::GetNumberOfAbandonedMessages() const
+{
+	return m_numAbandonedMessages;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int MessageReassembler::FindOrClaimSlot( unsigned long long sourceKey, const FragmentHeader& header, double currentTimeSeconds )
+{
+	unsigned int claimSlotIndex = NUM_REASSEMBLY_SLOTS;
+	unsigned int oldestSlotIndex = 0;
+	for( unsigned int slotIndex = 0; slotIndex < NUM_REASSEMBLY_SLOTS; ++slotIndex )
+	{
+		ReassemblySlot& slot = m_slots[ slotIndex ];
+		if( slot.m_isInUse && ( currentTimeSeconds - slot.m_firstFragmentTime ) > SECONDS_BEFORE_REASSEMBLY_TIMEOUT )
+		{
+			slot.m_isInUse = false;
+			++m_numAbandonedMessages;
+		}
+
+		if( !slot.m_isInUse )
+		{
+			if( claimSlotIndex == NUM_REASSEMBLY_SLOTS )
+				claimSlotIndex = slotIndex;
+			continue;
+		}
+
+		if( slot.m_sourceKey == sourceKey && slot.m_messageID == header.messageID )
+			return slotIndex;
+
+		if( slot.m_firstFragmentTime < m_slots[ oldestSlotIndex ].m_firstFragmentTime || !m_slots[ oldestSlotIndex ].m_isInUse )
+			oldestSlotIndex = slotIndex;
+	}
+
+	if( claimSlotIndex == NUM_REASSEMBLY_SLOTS )
+	{
+		claimSlotIndex = oldestSlotIndex;
+		++m_numAbandonedMessages;
+	}
+
+	ReassemblySlot& slot = m_slots[ claimSlotIndex ];
+	slot.m_isInUse = true;
+	slot.m_sourceKey = sourceKey;
+	slot.m_messageID = header.messageID;
+	slot.m_messageBytes = header.messageBytes;
+	slot.m_fragmentPayloadBytes = 0;
+	slot.m_numFragments = header.numFragments;
+	slot.m_numFragmentsReceived = 0;
+	slot.m_receivedFragmentBits = 0;
+	slot.m_firstFragmentTime = currentTimeSeconds;
+
+	return claimSlotIndex;
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef include_Fragmentation
+#define include_Fragmentation
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <vector>
+
+
+//-----------------------------------------------------------------------------------------------
+//Game and lobby packet types start at 10, so a leading byte of 1 marks a fragment on either socket
+const unsigned char FRAGMENT_PACKET_TYPE = 1;
+const unsigned int IP_AND_UDP_HEADER_BYTES = 28;
+const unsigned int MIN_MTU_BYTES = 576;
+const unsigned int MAX_MTU_BYTES = 1500;
+const unsigned int DEFAULT_MTU_BYTES = 1280;
+const unsigned int MAX_DATAGRAM_BYTES = MAX_MTU_BYTES - IP_AND_UDP_HEADER_BYTES;
+const unsigned int MAX_FRAGMENTS_PER_MESSAGE = 64;
+const unsigned int MAX_MESSAGE_BYTES = 32768;
+const unsigned int NUM_REASSEMBLY_SLOTS = 8;
+const double SECONDS_BEFORE_REASSEMBLY_TIMEOUT = 1.0;
+
+
+//-----------------------------------------------------------------------------------------------
+struct FragmentHeader
+{
+	unsigned char packetType;
+	unsigned char fragmentIndex;
+	unsigned char numFragments;
+	unsigned char reserved;
+	unsigned short messageID;
+	unsigned short messageBytes;
+	unsigned short fragmentOffset;
+	unsigned short fragmentBytes;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Largest datagram that fits the MTU once the IP and UDP headers are added, so nothing we send
+//ever has to be fragmented by IP
+unsigned int GetMaxDatagramBytesForMTU( unsigned int mtuBytes );
+unsigned int GetNumberOfFragments( unsigned int messageBytes, unsigned int maxDatagramBytes );
+unsigned int BuildFragment( const char* message, unsigned int messageBytes, unsigned short messageID, unsigned int fragmentIndex, unsigned int maxDatagramBytes, char* out_datagram );
+
+
+//-----------------------------------------------------------------------------------------------
+//Collects fragments into a fixed set of buffers allocated up front. A set that is still
+//incomplete after SECONDS_BEFORE_REASSEMBLY_TIMEOUT is abandoned, and when every slot is busy the
+//oldest set gives its slot up to the new one
+class MessageReassembler
+{
+public:
+	MessageReassembler();
+	void Initialize();
+	const char* AddFragment( unsigned long long sourceKey, const char* datagram, unsigned int datagramBytes, double currentTimeSeconds, unsigned int& out_messageBytes );
+	unsigned int GetNumberOfAbandonedMessages() const;
+
+private:
+	struct ReassemblySlot
+	{
+		bool				m_isInUse;
+		unsigned long long	m_sourceKey;
+		unsigned short		m_messageID;
+		unsigned short		m_messageBytes;
+		unsigned short		m_fragmentPayloadBytes;
+		unsigned char		m_numFragments;
+		unsigned char		m_numFragmentsReceived;
+		unsigned long long	m_receivedFragmentBits;
+		double				m_firstFragmentTime;
+	};
+
+	unsigned int FindOrClaimSlot( unsigned long long sourceKey, const FragmentHeader& header, double currentTimeSeconds );
+
+	ReassemblySlot			m_slots[ NUM_REASSEMBLY_SLOTS ];
+	std::vector< char >		m_buffers;
+	unsigned int			m_numAbandonedMessages;
+};
+
+
+#endif // include_Fragmentation
\ No newline at end of file
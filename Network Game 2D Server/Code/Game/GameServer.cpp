@@ -1,65 +1,196 @@
 #include "GameServer.hpp"
+#include <process.h>
+#include "AllocationCounter.hpp"
 
 
 //-----------------------------------------------------------------------------------------------
-void GameServer::Initalize()
+static float g_parityLossThreshold = DEFAULT_PARITY_LOSS_THRESHOLD;
+
+
+//-----------------------------------------------------------------------------------------------
+void GameServerReceiveThreadEntryFunc( void* data )
+{
+	GameServer* game = static_cast< GameServer* >( data );
+
+	while( game->m_isReceiving )
+	{
+		if( game->m_server.WaitForPacketFromClient( RECEIVE_THREAD_WAIT_MICROSECONDS ) )
+			game->ReceivePackets();
+	}
+
+	SetEvent( game->m_receiveThreadExitedEvent );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Sessions losing more than this fraction of their packets get parity. Each session picks up a
+//new value at its next loss sample
+void SetParityLossThreshold( float lossRate )
+{
+	g_parityLossThreshold = lossRate;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+GameServer::GameServer()
+	: m_isReceiving( 0 )
+	, m_receiveThreadExitedEvent( NULL )
+	, m_numDroppedPackets( 0 )
+	, m_numReceiveAllocations( 0 )
+	, m_numPiggybackedAcks( 0 )
+	, m_numStandaloneAcks( 0 )
+	, m_numPreviousStatesReceived( 0 )
+	, m_numRecoveredStates( 0 )
+	, m_numParityPacketsSent( 0 )
+	, m_nextPlayerID( 0 )
+	, m_secondsPerTick( 1.0 / DEFAULT_GAME_TICKS_PER_SECOND )
 {
-	srand( (unsigned int) time( NULL ) );
 
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void GameServer::Initalize()
+{
 	InitializeTime();
 	m_server.StartServer( m_portNumber );
 
-	m_nextPacketNumber = 0;
+	//A simulation seeds rand once up front, so every run places players and flags the same way
+	if( !m_server.IsSimulated() )
+		srand( (unsigned int) time( NULL ) );
+
+	m_sessions.Initialize( MAX_PLAYERS_PER_GAME );
+	m_playerIndexBySlot.assign( m_sessions.GetCapacity(), INVALID_PLAYER_INDEX );
+	m_cookies.Initialize();
+	m_rateLimiter.Initialize( MAX_RATE_LIMITED_SOURCES );
+	m_rateLimiter.SetClassLimit( RATE_CLASS_Default, DEFAULT_PACKETS_PER_SECOND, DEFAULT_PACKET_BURST );
+	m_rateLimiter.SetClassLimit( RATE_CLASS_Expensive, VICTORY_PACKETS_PER_SECOND, VICTORY_PACKET_BURST );
+
 	m_numFlagsCaptured = 0;
 	m_isGameOver = false;
 	m_addedPlayersToLobby = false;
 	m_flagPosition = GetRandomPosition();
-	m_lastUpdateTime = GetCurrentTimeSeconds();
+
+	double currentTime = GetFrameTimeSeconds();
+	m_timers.Initialize( currentTime, SECONDS_PER_TIMER_WHEEL_TICK );
+
+	//A simulated game is received from its own Update instead, so it stays on the simulation's clock
+	if( !m_server.IsSimulated() )
+	{
+		m_receiveThreadExitedEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+		InterlockedExchange( &m_isReceiving, 1 );
+		_beginthread( GameServerReceiveThreadEntryFunc, 0, this );
+	}
 
 	std::cout << "Game is up and running\n";
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void GameServer::Update()
+//Waits for the receive thread to let go of the socket before closing it
+void GameServer::Shutdown()
 {
-	GetPackets();
-	CheckForTimeOutPlayers();
-	SendUpdatesToClients();
-	ResendAckPackets();
+	if( m_isReceiving )
+	{
+		InterlockedExchange( &m_isReceiving, 0 );
+		WaitForSingleObject( m_receiveThreadExitedEvent, INFINITE );
+		CloseHandle( m_receiveThreadExitedEvent );
+		m_receiveThreadExitedEvent = NULL;
+	}
+
+	m_server.EndServer();
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void GameServer::AddPlayer( const ClientInfo& info )
+//Read by the lobby when it schedules the game, so set it before the game is added
+void GameServer::SetTicksPerSecond( float ticksPerSecond )
+{
+	if( ticksPerSecond > 0.f )
+		m_secondsPerTick = 1.0 / ticksPerSecond;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double GameServer::GetSecondsPerTick() const
 {
-	Player* player;
+	return m_secondsPerTick;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Drains everything queued since the last tick, then one snapshot covers however many ticks the
+//scheduler merged into this one
+void GameServer::Tick()
+{
+	m_receiveQueueBytes.AddSample( (double) m_server.GetPendingReceiveBytes() );
+	m_server.FlushQueuedPackets();
 
-	std::map< ClientInfo, Player* >::iterator playerIter = m_players.find( info );
-	if( playerIter == m_players.end() )
+	for( unsigned int batchIndex = 0; batchIndex < MAX_RECEIVE_BATCHES_PER_TICK; ++batchIndex )
 	{
-		player = new Player();
+		if( !GetPackets() )
+			break;
 	}
-	else
+
+	ProcessExpiredTimers();
+	SendOpenParityGroups();
+	SendUpdatesToClients( GetFrameTimeSeconds() );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void GameServer::AddPlayer( const ClientInfo& info )
+{
+	//The session id is the player's slot, but slots are reused as soon as a player leaves, so the
+	//id sent to clients comes from a counter that a newcomer can't share with someone who just left
+	unsigned short sessionID = m_sessions.AddSession( info );
+	if( sessionID == INVALID_SESSION_ID )
+		return;
+
+	if( m_playerIndexBySlot.size() < m_sessions.GetCapacity() )
+		m_playerIndexBySlot.resize( m_sessions.GetCapacity(), INVALID_PLAYER_INDEX );
+
+	bool isNewPlayer = ( m_playerIndexBySlot[ sessionID ] == INVALID_PLAYER_INDEX );
+	if( isNewPlayer )
 	{
-		player = playerIter->second;
+		m_playerIndexBySlot[ sessionID ] = (unsigned short) m_players.size();
+		m_players.push_back( Player() );
+
+		Player& newPlayer = m_players.back();
+		newPlayer.m_info = info;
+		newPlayer.m_sessionID = sessionID;
+		newPlayer.m_playerID = m_nextPlayerID;
+		newPlayer.m_color = GetPlayerColorForID( m_nextPlayerID );
+		++m_nextPlayerID;
+		if( m_nextPlayerID == INVALID_PLAYER_ID )
+			m_nextPlayerID = 0;
+		newPlayer.m_numPacketsExpected = 0;
+		newPlayer.m_numPacketsReceived = 0;
+		newPlayer.m_lossRate = 0.f;
+		newPlayer.m_isParityEnabled = false;
 	}
 
-	player->m_color = GetPlayerColorForID( m_players.size() );
+	Player* player = &m_players[ m_playerIndexBySlot[ sessionID ] ];
 	player->m_position = GetRandomPosition();
 	player->m_velocity = Vector2( 0.f, 0.f );
 	player->m_orientationDegrees = 0.f;
-	player->m_lastUpdateTime = GetCurrentTimeSeconds();
+	player->m_lastUpdateTime = GetFrameTimeSeconds();
+	player->m_stateTime = player->m_lastUpdateTime;
+	player->m_lastStateTimestamp = 0.0;
 
-	m_players[ info ] = player;
+	if( isNewPlayer )
+	{
+		unsigned int timerID = MakeTimerID( GAME_TIMER_PlayerTimeout, m_sessions.GetTimerIndexForSession( sessionID ) );
+		m_timers.AddTimer( timerID, player->m_lastUpdateTime + SECONDS_BEFORE_TIMEOUT_REMOVE );
+	}
 
 	CS6Packet resetPacket;
-	resetPacket.packetNumber = m_nextPacketNumber;
 	resetPacket.packetType = TYPE_Reset;
 	resetPacket.playerColorAndID[0] = player->m_color.r;
 	resetPacket.playerColorAndID[1] = player->m_color.g;
 	resetPacket.playerColorAndID[2] = player->m_color.b;
-	resetPacket.timestamp = GetCurrentTimeSeconds();
+	resetPacket.playerID = player->m_playerID;
+	resetPacket.timestamp = GetFrameTimeSeconds();
 	resetPacket.data.reset.playerXPosition = player->m_position.x;
 	resetPacket.data.reset.playerYPosition = player->m_position.y;
 	resetPacket.data.reset.flagXPosition = m_flagPosition.x;
@@ -73,48 +204,270 @@ void GameServer::AddPlayer( const ClientInfo& info )
 
 
 //-----------------------------------------------------------------------------------------------
-unsigned int GameServer::GetNumberOfPlayers()
+unsigned int GameServer::GetNumberOfPlayers() const
 {
 	return m_players.size();
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void GameServer::SendPacketToClient( const CS6Packet& pkt, const ClientInfo& info, bool requireAck )
+const ClientInfo& GameServer::GetPlayerInfo( unsigned int playerIndex ) const
+{
+	return m_players[ playerIndex ].m_info;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int GameServer::GetNumberOfDroppedPackets() const
+{
+	return m_numDroppedPackets;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The limiter is charged on the receive thread, so this is a total that may be a packet behind
+unsigned int GameServer::GetNumberOfRateLimitedPackets() const
+{
+	return m_rateLimiter.GetNumberOfDroppedPackets();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Heap allocations made while draining the socket into the queue and the queue into the batch.
+//The receive path is meant to make none, and this only counts in debug builds
+unsigned int GameServer::GetNumberOfReceiveAllocations() const
+{
+	return m_numReceiveAllocations;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+UDPSendStats GameServer::GetSendStats() const
+{
+	return m_server.GetSendStats();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int GameServer::GetNumberOfAbandonedMessages() const
+{
+	return m_server.GetNumberOfAbandonedMessages();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Sampled once a tick, before the tick drains anything
+const MetricSummary& GameServer::GetReceiveQueueBytes() const
+{
+	return m_receiveQueueBytes;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void GameServer::ResetReceiveQueueBytes()
+{
+	m_receiveQueueBytes.Reset();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int GameServer::GetNumberOfPiggybackedAcks() const
+{
+	return m_numPiggybackedAcks;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int GameServer::GetNumberOfStandaloneAcks() const
+{
+	return m_numStandaloneAcks;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int GameServer::GetNumberOfPreviousStatesReceived() const
+{
+	return m_numPreviousStatesReceived;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int GameServer::GetNumberOfRecoveredStates() const
+{
+	return m_numRecoveredStates;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int GameServer::GetNumberOfParityPacketsSent() const
+{
+	return m_numParityPacketsSent;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int GameServer::GetNumberOfSessionsUsingParity() const
+{
+	unsigned int numSessionsUsingParity = 0;
+	for( unsigned int playerIndex = 0; playerIndex < m_players.size(); ++playerIndex )
+	{
+		if( m_players[ playerIndex ].m_isParityEnabled )
+			++numSessionsUsingParity;
+	}
+
+	return numSessionsUsingParity;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Fills in the per-recipient fields from the recipient's session, which callers look up once for
+//however many packets they stamp. A waiting ack for the recipient rides along on whatever packet
+//this is, and no longer needs its own
+void GameServer::StampOutgoingPacket( CS6Packet& out_packet, unsigned short sessionID )
 {
+	out_packet.packetNumber = 0;
+	out_packet.echoTimestamp = 0.0;
+	out_packet.echoHoldSeconds = 0.f;
+	out_packet.ackedPacketType = TYPE_None;
+	out_packet.ackedPacketNumber = 0;
+	out_packet.numPreviousStates = 0;
+
+	if( sessionID == INVALID_SESSION_ID )
+		return;
+
+	Session& session = m_sessions.GetSession( sessionID );
+	out_packet.packetNumber = session.m_nextSequenceNumber;
+	++session.m_nextSequenceNumber;
+
+	m_sessions.GetClockSync( sessionID ).GetEchoTimestamps( out_packet.timestamp, out_packet.echoTimestamp, out_packet.echoHoldSeconds );
+
+	if( session.m_pendingAckType != TYPE_None )
+	{
+		out_packet.ackedPacketType = session.m_pendingAckType;
+		out_packet.ackedPacketNumber = session.m_pendingAckNumber;
+		session.m_pendingAckType = TYPE_None;
+		++m_numPiggybackedAcks;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+SequenceNumber GameServer::SendPacketToClient( const CS6Packet& pkt, const ClientInfo& info, bool requireAck )
+{
+	CS6Packet sequencedPacket = pkt;
+	unsigned short sessionID = m_sessions.FindSession( info );
+	StampOutgoingPacket( sequencedPacket, sessionID );
+
 	struct sockaddr_in clientAddr;
 	clientAddr.sin_family = AF_INET;
-	clientAddr.sin_addr.s_addr = inet_addr( info.m_ipAddress );
+	clientAddr.sin_addr.s_addr = info.m_ipAddress;
 	clientAddr.sin_port = info.m_portNumber;
-	m_server.SendPacketToClient( (const char*) &pkt, sizeof( pkt ), clientAddr );
-	++m_nextPacketNumber;
+
+	//Position updates are the only packets a newer one makes worthless, so they go first when
+	//the outbound queue is full
+	m_server.SendPacketToClient( (const char*) &sequencedPacket, GetNumberOfBytesToSend( sequencedPacket ), clientAddr, sequencedPacket.packetType != TYPE_Update );
+	if( sessionID != INVALID_SESSION_ID && sequencedPacket.packetType != TYPE_Update )
+		AddToParityGroup( sessionID, sequencedPacket );
 
 	if( requireAck )
 	{
-		std::vector< CS6Packet > sentPackets;
-		std::map< ClientInfo, std::vector< CS6Packet > >::iterator vecIter = m_sendPacketsPerClient.find( info );
-		if( vecIter != m_sendPacketsPerClient.end() )
-		{
-			sentPackets = vecIter->second;
-		}
-
-		sentPackets.push_back( pkt );
-		m_sendPacketsPerClient[ info ] = sentPackets;
+		m_sendPacketsPerClient[ info ].push_back( sequencedPacket );
+		ArmResendTimer( sessionID, sequencedPacket.timestamp + SECONDS_BEFORE_RESEND_RELIABLE_PACKETS );
 	}
+
+	return sequencedPacket.packetNumber;
 }
 
 
 //-----------------------------------------------------------------------------------------------
 void GameServer::SendPacketToAllClients( const CS6Packet& pkt, bool requireAck )
 {
-	std::map< ClientInfo, Player* >::iterator playerIter;
-	for( playerIter = m_players.begin(); playerIter != m_players.end(); ++playerIter )
+	for( unsigned int playerIndex = 0; playerIndex < m_players.size(); ++playerIndex )
 	{
-		SendPacketToClient( pkt, playerIter->first, requireAck );
+		SendPacketToClient( pkt, m_players[ playerIndex ].m_info, requireAck );
 	}
 }
 
 
+//-----------------------------------------------------------------------------------------------
+//Groups are closed when full here, or at the end of the tick so a short burst isn't held back
+void GameServer::AddToParityGroup( unsigned short sessionID, const CS6Packet& sentPacket )
+{
+	Player* player = FindPlayer( sessionID );
+	if( !player || !player->m_isParityEnabled )
+		return;
+
+	if( player->m_parityEncoder.IsEmpty() )
+		m_sessionsWithOpenParityGroups.push_back( sessionID );
+
+	if( player->m_parityEncoder.AddPacket( sentPacket ) )
+		SendParityPacket( sessionID );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void GameServer::SendParityPacket( unsigned short sessionID )
+{
+	Player* player = FindPlayer( sessionID );
+	CS6ParityPacket parityPacket;
+	player->m_parityEncoder.TakeParityPacket( parityPacket );
+
+	struct sockaddr_in clientAddr;
+	clientAddr.sin_family = AF_INET;
+	clientAddr.sin_addr.s_addr = player->m_info.m_ipAddress;
+	clientAddr.sin_port = player->m_info.m_portNumber;
+
+	//Resends still cover the group if this is lost, so it is the first thing dropped under backpressure
+	m_server.SendPacketToClient( (const char*) &parityPacket, sizeof( parityPacket ), clientAddr, false );
+	++m_numParityPacketsSent;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void GameServer::SendOpenParityGroups()
+{
+	for( unsigned int openIndex = 0; openIndex < m_sessionsWithOpenParityGroups.size(); ++openIndex )
+	{
+		unsigned short sessionID = m_sessionsWithOpenParityGroups[ openIndex ];
+		Player* player = FindPlayer( sessionID );
+		if( player && !player->m_parityEncoder.IsEmpty() )
+			SendParityPacket( sessionID );
+	}
+
+	m_sessionsWithOpenParityGroups.clear();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Nothing tells the server which of its own packets arrived, so the gaps in the client's packet
+//numbers stand in for loss in both directions
+void GameServer::MeasureLoss( unsigned short sessionID, unsigned int numNewPackets )
+{
+	Player* player = FindPlayer( sessionID );
+	if( !player )
+		return;
+
+	player->m_numPacketsExpected += numNewPackets;
+	++player->m_numPacketsReceived;
+	if( player->m_numPacketsExpected < PACKETS_PER_LOSS_SAMPLE )
+		return;
+
+	float sampleLossRate = 0.f;
+	if( player->m_numPacketsReceived < player->m_numPacketsExpected )
+		sampleLossRate = 1.f - (float) player->m_numPacketsReceived / (float) player->m_numPacketsExpected;
+
+	player->m_lossRate += ( sampleLossRate - player->m_lossRate ) * LOSS_SAMPLE_WEIGHT;
+	player->m_numPacketsExpected = 0;
+	player->m_numPacketsReceived = 0;
+
+	//Turning off at half the threshold keeps a player who hovers near it from flapping
+	if( player->m_lossRate > g_parityLossThreshold )
+		player->m_isParityEnabled = true;
+	else if( player->m_lossRate < g_parityLossThreshold * 0.5f )
+		player->m_isParityEnabled = false;
+}
+
+
 //-----------------------------------------------------------------------------------------------
 std::string GameServer::ConvertNumberToString( int number )
 {
@@ -123,26 +476,36 @@ std::string GameServer::ConvertNumberToString( int number )
 
 
 //-----------------------------------------------------------------------------------------------
+//Colors only tell players apart on screen, so they cycle once ids run past the palette
 Color3b GameServer::GetPlayerColorForID( unsigned int playerID )
 {
-	if( playerID == 0 )
+	unsigned int colorIndex = playerID % NUM_PLAYER_COLORS;
+	if( colorIndex == 0 )
 		return Color3b( 255, 0, 0 );
-	if( playerID == 1 )
+	if( colorIndex == 1 )
 		return Color3b( 0, 255, 0 );
-	if( playerID == 2 )
+	if( colorIndex == 2 )
 		return Color3b( 0, 0, 255 );
-	if( playerID == 3 )
+	if( colorIndex == 3 )
 		return Color3b( 255, 255, 0 );
-	if( playerID == 4 )
+	if( colorIndex == 4 )
 		return Color3b( 255, 0, 255 );
-	if( playerID == 5 )
+	if( colorIndex == 5 )
 		return Color3b( 0, 255, 255 );
-	if( playerID == 6 )
+	if( colorIndex == 6 )
 		return Color3b( 255, 165, 0 );
-	if( playerID == 7 )
-		return Color3b( 128, 0, 128 );
 
-	return Color3b( 255, 255, 255 );
+	return Color3b( 128, 0, 128 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+Player* GameServer::FindPlayer( unsigned short sessionID )
+{
+	if( sessionID == INVALID_SESSION_ID || m_playerIndexBySlot[ sessionID ] == INVALID_PLAYER_INDEX )
+		return nullptr;
+
+	return &m_players[ m_playerIndexBySlot[ sessionID ] ];
 }
 
 
@@ -158,13 +521,38 @@ Vector2 GameServer::GetRandomPosition()
 
 
 //-----------------------------------------------------------------------------------------------
-void GameServer::ProcessAckPackets( const CS6Packet& ackPacket, const ClientInfo& info )
+//Sources without a session only ever get a challenge back. Nothing is allocated for them until
+//they echo a cookie that proves they can receive at the address they claim
+void GameServer::ProcessConnectRequest( const CS6Packet& connectPacket, const ClientInfo& info )
+{
+	if( connectPacket.packetType != TYPE_Acknowledge || connectPacket.data.acknowledged.packetType != TYPE_Acknowledge )
+		return;
+
+	double currentTime = GetFrameTimeSeconds();
+	if( m_cookies.IsCookieValid( info, connectPacket.data.acknowledged.cookie, currentTime ) )
+	{
+		AddPlayer( info );
+		return;
+	}
+
+	CS6Packet challengePacket;
+	challengePacket.packetType = TYPE_Challenge;
+	challengePacket.timestamp = currentTime;
+	challengePacket.data.challenge.cookie = m_cookies.MakeCookie( info, currentTime );
+
+	SendPacketToClient( challengePacket, info, false );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Acks arrive either as their own packet or in the header of another one, and are handled the same
+void GameServer::ProcessAck( PacketType ackedPacketType, SequenceNumber ackedPacketNumber, const ClientInfo& info )
 {
-	if( ackPacket.data.acknowledged.packetType == TYPE_Acknowledge )
+	if( ackedPacketType == TYPE_Acknowledge )
 	{
 		AddPlayer( info );
 	}
-	else if( ackPacket.data.acknowledged.packetType == TYPE_GameOver )
+	else if( ackedPacketType == TYPE_GameOver )
 	{
 		RemovePlayer( info );
 	}
@@ -172,14 +560,12 @@ void GameServer::ProcessAckPackets( const CS6Packet& ackPacket, const ClientInfo
 	std::map< ClientInfo, std::vector< CS6Packet > >::iterator vecIter = m_sendPacketsPerClient.find( info );
 	if( vecIter != m_sendPacketsPerClient.end() )
 	{
-		std::vector< CS6Packet > sentPackets = vecIter->second;
+		std::vector< CS6Packet >& sentPackets = vecIter->second;
 		for( unsigned int packetIndex = 0; packetIndex < sentPackets.size(); ++packetIndex )
 		{
-			CS6Packet packet = sentPackets[ packetIndex ];
-			if( packet.packetNumber == ackPacket.data.acknowledged.packetNumber )
+			if( sentPackets[ packetIndex ].packetNumber == ackedPacketNumber )
 			{
 				sentPackets.erase( sentPackets.begin() + packetIndex );
-				m_sendPacketsPerClient[ info ] = sentPackets;
 				break;
 			}
 		}
@@ -187,21 +573,67 @@ void GameServer::ProcessAckPackets( const CS6Packet& ackPacket, const ClientInfo
 }
 
 
+//-----------------------------------------------------------------------------------------------
+//Holds the ack back for the next packet to the client, and arms a timer to send it on its own if
+//nothing else goes out first. A session holds one waiting ack, so an older one is sent right away
+void GameServer::QueueAck( const CS6Packet& reliablePacket, const ClientInfo& info )
+{
+	unsigned short sessionID = m_sessions.FindSession( info );
+	if( sessionID == INVALID_SESSION_ID )
+		return;
+
+	Session& session = m_sessions.GetSession( sessionID );
+	if( session.m_pendingAckType != TYPE_None )
+		SendPendingAck( sessionID );
+
+	session.m_pendingAckType = reliablePacket.packetType;
+	session.m_pendingAckNumber = reliablePacket.packetNumber;
+	m_timers.AddTimer( MakeTimerID( GAME_TIMER_SendAck, m_sessions.GetTimerIndexForSession( sessionID ) ), GetFrameTimeSeconds() + SECONDS_BEFORE_SEND_STANDALONE_ACK );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Does nothing if the ack has already gone out on another packet
+void GameServer::SendPendingAck( unsigned short sessionID )
+{
+	Session& session = m_sessions.GetSession( sessionID );
+	if( session.m_pendingAckType == TYPE_None )
+		return;
+
+	CS6Packet ackPacket;
+	ackPacket.packetType = TYPE_Acknowledge;
+	ackPacket.timestamp = GetFrameTimeSeconds();
+	ackPacket.data.acknowledged.packetNumber = session.m_pendingAckNumber;
+	ackPacket.data.acknowledged.packetType = session.m_pendingAckType;
+	session.m_pendingAckType = TYPE_None;
+
+	SendPacketToClient( ackPacket, session.m_info, false );
+	++m_numStandaloneAcks;
+}
+
+
 //-----------------------------------------------------------------------------------------------
 void GameServer::RemovePlayer( const ClientInfo& info )
 {
-	std::string playerString = std::string( info.m_ipAddress ) + ":" + ConvertNumberToString( info.m_portNumber );
+	std::string playerString = info.GetIPAddressString() + ":" + ConvertNumberToString( info.m_portNumber );
 	if( playerString == m_ownerName )
 		m_isGameOver = true;
 
-	std::map< ClientInfo, Player* >::iterator playerIter = m_players.find( info );
-	if( playerIter != m_players.end() )
+	//Swap the last player into the hole so the array stays packed for the broadcast sweep
+	unsigned short sessionID = m_sessions.FindSession( info );
+	if( FindPlayer( sessionID ) )
 	{
-		Player* player = playerIter->second;
-		m_players.erase( playerIter );
-		delete player;
+		unsigned short playerIndex = m_playerIndexBySlot[ sessionID ];
+		m_playerIndexBySlot[ sessionID ] = INVALID_PLAYER_INDEX;
+
+		m_players[ playerIndex ] = m_players.back();
+		m_players.pop_back();
+		if( playerIndex < m_players.size() )
+			m_playerIndexBySlot[ m_players[ playerIndex ].m_sessionID ] = playerIndex;
 	}
 
+	m_sessions.RemoveSession( info );
+
 	std::map< ClientInfo, std::vector< CS6Packet > >::iterator listIter = m_sendPacketsPerClient.find( info );
 	if( listIter != m_sendPacketsPerClient.end() )
 	{
@@ -211,33 +643,63 @@ void GameServer::RemovePlayer( const ClientInfo& info )
 
 
 //-----------------------------------------------------------------------------------------------
-void GameServer::CheckForTimeOutPlayers()
+void GameServer::ProcessExpiredTimers()
 {
-	std::map< ClientInfo, Player* >::iterator playerIter;
-	for( playerIter = m_players.begin(); playerIter != m_players.end(); ++playerIter )
+	double currentTime = GetFrameTimeSeconds();
+
+	m_expiredTimerIDs.clear();
+	m_timers.AdvanceTime( currentTime, m_expiredTimerIDs );
+
+	for( unsigned int timerIndex = 0; timerIndex < m_expiredTimerIDs.size(); ++timerIndex )
 	{
-		Player* player = playerIter->second;
-		if( ( GetCurrentTimeSeconds() - player->m_lastUpdateTime ) > SECONDS_BEFORE_TIMEOUT_REMOVE )
+		unsigned int timerID = m_expiredTimerIDs[ timerIndex ];
+
+		//Timers armed for a session that has since been removed or reused are dropped here
+		unsigned short sessionID = m_sessions.GetSessionForTimerIndex( GetTimerIndex( timerID ) );
+		if( sessionID == INVALID_SESSION_ID )
+			continue;
+
+		if( GetTimerKind( timerID ) == GAME_TIMER_PlayerTimeout )
 		{
-			RemovePlayer( playerIter->first );
-			SendGameOverToClients();
-			return;
+			CheckForTimeOutPlayer( sessionID, currentTime );
+		}
+		else if( GetTimerKind( timerID ) == GAME_TIMER_ResendReliable )
+		{
+			ResendAckPackets( sessionID, currentTime );
+		}
+		else if( GetTimerKind( timerID ) == GAME_TIMER_SendAck )
+		{
+			SendPendingAck( sessionID );
 		}
 	}
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void GameServer::ResetGame( const CS6Packet& victoryPacket, const ClientInfo& info )
+void GameServer::CheckForTimeOutPlayer( unsigned short sessionID, double currentTime )
 {
-	CS6Packet ackPacket;
-	ackPacket.packetNumber = m_nextPacketNumber;
-	ackPacket.packetType = TYPE_Acknowledge;
-	ackPacket.timestamp = GetCurrentTimeSeconds();
-	ackPacket.data.acknowledged.packetNumber = victoryPacket.packetNumber;
-	ackPacket.data.acknowledged.packetType = TYPE_Victory;
+	Player* player = FindPlayer( sessionID );
+	if( !player )
+		return;
+
+	//Updates only touch the timestamp, so a timer that fires for a live player is re-armed here
+	double timeoutTime = player->m_lastUpdateTime + SECONDS_BEFORE_TIMEOUT_REMOVE;
+	if( timeoutTime >= currentTime )
+	{
+		m_timers.AddTimer( MakeTimerID( GAME_TIMER_PlayerTimeout, m_sessions.GetTimerIndexForSession( sessionID ) ), timeoutTime );
+		return;
+	}
+
+	RemovePlayer( m_sessions.GetSession( sessionID ).m_info );
+	SendGameOverToClients();
+}
 
-	SendPacketToClient( ackPacket, info, false );
+
+//-----------------------------------------------------------------------------------------------
+void GameServer::ResetGame( const CS6Packet& victoryPacket, const ClientInfo& info )
+{
+	//Every path below sends the victor something straight away, and the ack goes with it
+	QueueAck( victoryPacket, info );
 
 	m_flagPosition = GetRandomPosition();
 	++m_numFlagsCaptured;
@@ -248,19 +710,18 @@ void GameServer::ResetGame( const CS6Packet& victoryPacket, const ClientInfo& in
 		return;
 	}
 
-	std::map< ClientInfo, Player* >::iterator playerIter;
-	for( playerIter = m_players.begin(); playerIter != m_players.end(); ++playerIter )
+	for( unsigned int playerIndex = 0; playerIndex < m_players.size(); ++playerIndex )
 	{
-		Player* player = playerIter->second;
+		Player* player = &m_players[ playerIndex ];
 		Vector2 resetPlayerPos = GetRandomPosition();
 
 		CS6Packet resetPacket;
-		resetPacket.packetNumber = m_nextPacketNumber;
 		resetPacket.packetType = TYPE_Reset;
 		resetPacket.playerColorAndID[0] = player->m_color.r;
 		resetPacket.playerColorAndID[1] = player->m_color.g;
 		resetPacket.playerColorAndID[2] = player->m_color.b;
-		resetPacket.timestamp = GetCurrentTimeSeconds();
+		resetPacket.playerID = player->m_playerID;
+		resetPacket.timestamp = GetFrameTimeSeconds();
 		resetPacket.data.reset.playerColorAndID[0] = player->m_color.r;
 		resetPacket.data.reset.playerColorAndID[1] = player->m_color.g;
 		resetPacket.data.reset.playerColorAndID[2] = player->m_color.b;
@@ -272,7 +733,7 @@ void GameServer::ResetGame( const CS6Packet& victoryPacket, const ClientInfo& in
 		resetPacket.data.reset.playerColorAndID[1] = player->m_color.g;
 		resetPacket.data.reset.playerColorAndID[2] = player->m_color.b;
 
-		SendPacketToClient( resetPacket, playerIter->first, true );
+		SendPacketToClient( resetPacket, player->m_info, true );
 	}
 }
 
@@ -280,50 +741,112 @@ void GameServer::ResetGame( const CS6Packet& victoryPacket, const ClientInfo& in
 //-----------------------------------------------------------------------------------------------
 void GameServer::UpdatePlayer( const CS6Packet& updatePacket, const ClientInfo& info )
 {
-	std::map< ClientInfo, Player* >::iterator playerIter = m_players.find( info );
-	if( playerIter != m_players.end() )
+	unsigned short sessionID = m_sessions.FindSession( info );
+	Player* player = FindPlayer( sessionID );
+	if( !player )
+		return;
+
+	//Hearing from the client at all keeps it alive, even when the update brings nothing new
+	player->m_lastUpdateTime = GetFrameTimeSeconds();
+
+	UpdateState previousStates[ MAX_PREVIOUS_UPDATE_STATES ];
+	unsigned int numPreviousStates = ReadPreviousStates( updatePacket, previousStates );
+	m_numPreviousStatesReceived += numPreviousStates;
+
+	//An update that arrives behind a later one was already carried in that one's history
+	if( updatePacket.timestamp <= player->m_lastStateTimestamp )
+		return;
+
+	//States lost in a gap before this update are played through oldest first, so the player's
+	//state only ever moves forward along what the client actually sent
+	for( unsigned int stateIndex = numPreviousStates; stateIndex > 0; --stateIndex )
 	{
-		Player* player = playerIter->second;
-		player->m_position.x = updatePacket.data.updated.xPosition;
-		player->m_position.y = updatePacket.data.updated.yPosition;
-		player->m_velocity.x = updatePacket.data.updated.xVelocity;
-		player->m_velocity.y = updatePacket.data.updated.yVelocity;
-		player->m_orientationDegrees = updatePacket.data.updated.yawDegrees;
-		player->m_lastUpdateTime = GetCurrentTimeSeconds();
+		const UpdateState& recoveredState = previousStates[ stateIndex - 1 ];
+		if( recoveredState.m_timestamp > player->m_lastStateTimestamp )
+		{
+			++m_numRecoveredStates;
+			ApplyPlayerState( player, recoveredState );
+		}
 	}
+
+	UpdateState currentState;
+	currentState.m_timestamp = updatePacket.timestamp;
+	currentState.m_xPosition = updatePacket.data.updated.xPosition;
+	currentState.m_yPosition = updatePacket.data.updated.yPosition;
+	currentState.m_xVelocity = updatePacket.data.updated.xVelocity;
+	currentState.m_yVelocity = updatePacket.data.updated.yVelocity;
+	ApplyPlayerState( player, currentState );
+	player->m_orientationDegrees = updatePacket.data.updated.yawDegrees;
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void GameServer::SendUpdatesToClients()
+void GameServer::ApplyPlayerState( Player* player, const UpdateState& state )
 {
-	if( m_isGameOver )
-		return;
+	player->m_position.x = state.m_xPosition;
+	player->m_position.y = state.m_yPosition;
+	player->m_velocity.x = state.m_xVelocity;
+	player->m_velocity.y = state.m_yVelocity;
+	player->m_lastStateTimestamp = state.m_timestamp;
+
+	//The state held when the client sent it, not when this tick got to it. Until the clock
+	//estimate settles, and if it would put the state in the future, arrival is the best guess
+	player->m_stateTime = player->m_lastUpdateTime;
+	const ClockSync& clockSync = m_sessions.GetClockSync( player->m_sessionID );
+	if( clockSync.HasEstimate() && clockSync.ConvertRemoteToLocalTime( state.m_timestamp ) < player->m_stateTime )
+		player->m_stateTime = clockSync.ConvertRemoteToLocalTime( state.m_timestamp );
+}
+
 
-	if( ( GetCurrentTimeSeconds() - m_lastUpdateTime ) < SECONDS_BEFORE_SEND_UPDATE )
+//-----------------------------------------------------------------------------------------------
+void GameServer::SendUpdatesToClients( double currentTime )
+{
+	if( m_isGameOver )
 		return;
 
-	std::map< ClientInfo, Player* >::iterator playerIter;
-	for( playerIter = m_players.begin(); playerIter != m_players.end(); ++playerIter )
+	//Each recipient's snapshots are the same size and go to one address, so they are handed to
+	//the socket together and can leave in a single segmented send. Snapshots carry no history, so
+	//they are packed at their wire size
+	for( unsigned int recipientIndex = 0; recipientIndex < m_players.size(); ++recipientIndex )
 	{
-		Player* player = playerIter->second;
-		CS6Packet updatePacket;
-		updatePacket.packetNumber = m_nextPacketNumber;
-		updatePacket.packetType = TYPE_Update;
-		updatePacket.playerColorAndID[0] = player->m_color.r;
-		updatePacket.playerColorAndID[1] = player->m_color.g;
-		updatePacket.playerColorAndID[2] = player->m_color.b;
-		updatePacket.timestamp = GetCurrentTimeSeconds();
-		updatePacket.data.updated.xPosition = player->m_position.x;
-		updatePacket.data.updated.yPosition = player->m_position.y;
-		updatePacket.data.updated.xVelocity = player->m_velocity.x;
-		updatePacket.data.updated.yVelocity = player->m_velocity.y;
-		updatePacket.data.updated.yawDegrees = player->m_orientationDegrees;
-
-		SendPacketToAllClients( updatePacket, false );
-	}
+		const ClientInfo& recipientInfo = m_players[ recipientIndex ].m_info;
+		unsigned short recipientSessionID = m_players[ recipientIndex ].m_sessionID;
+		m_updateBatch.clear();
 
-	m_lastUpdateTime = GetCurrentTimeSeconds();
+		for( unsigned int playerIndex = 0; playerIndex < m_players.size(); ++playerIndex )
+		{
+			const Player* player = &m_players[ playerIndex ];
+
+			//Clients only send when their motion changes, so the last state is carried forward to
+			//now exactly the way the client predicts it
+			Vector2 position = player->m_position + player->m_velocity * (float) ( currentTime - player->m_stateTime );
+			position.x = position.x < 0.f ? 0.f : ( position.x > MAP_SIZE_WIDTH ? (float) MAP_SIZE_WIDTH : position.x );
+			position.y = position.y < 0.f ? 0.f : ( position.y > MAP_SIZE_HEIGHT ? (float) MAP_SIZE_HEIGHT : position.y );
+
+			CS6Packet updatePacket;
+			updatePacket.packetType = TYPE_Update;
+			updatePacket.playerColorAndID[0] = player->m_color.r;
+			updatePacket.playerColorAndID[1] = player->m_color.g;
+			updatePacket.playerColorAndID[2] = player->m_color.b;
+			updatePacket.playerID = player->m_playerID;
+			updatePacket.timestamp = currentTime;
+			updatePacket.data.updated.xPosition = position.x;
+			updatePacket.data.updated.yPosition = position.y;
+			updatePacket.data.updated.xVelocity = player->m_velocity.x;
+			updatePacket.data.updated.yVelocity = player->m_velocity.y;
+			updatePacket.data.updated.yawDegrees = player->m_orientationDegrees;
+
+			StampOutgoingPacket( updatePacket, recipientSessionID );
+			const char* updateBytes = (const char*) &updatePacket;
+			m_updateBatch.insert( m_updateBatch.end(), updateBytes, updateBytes + CS6_PACKET_BYTES_WITHOUT_HISTORY );
+		}
+
+		struct sockaddr_in clientAddr;
+		clientAddr.sin_family = AF_INET;
+		clientAddr.sin_addr.s_addr = recipientInfo.m_ipAddress;
+		clientAddr.sin_port = recipientInfo.m_portNumber;
+		m_server.SendPacketsToClient( &m_updateBatch[ 0 ], CS6_PACKET_BYTES_WITHOUT_HISTORY, m_updateBatch.size() / CS6_PACKET_BYTES_WITHOUT_HISTORY, clientAddr );
+	}
 }
 
 
@@ -331,43 +854,112 @@ void GameServer::SendUpdatesToClients()
 void GameServer::SendGameOverToClients()
 {
 	CS6Packet gameOverPacket;
-	gameOverPacket.packetNumber = m_nextPacketNumber;
 	gameOverPacket.packetType = TYPE_GameOver;
-	gameOverPacket.timestamp = GetCurrentTimeSeconds();
+	gameOverPacket.timestamp = GetFrameTimeSeconds();
 
 	SendPacketToAllClients( gameOverPacket, true );
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void GameServer::GetPackets()
+//Receive thread only. The rate limiter is charged here, before a packet takes a queue slot, so
+//it belongs to this thread once the game is running
+void GameServer::ReceivePackets()
 {
-	CS6Packet pkt;
 	struct sockaddr_in clientAddr;
 	clientAddr.sin_family = AF_INET;
 	int clientLen = sizeof( clientAddr );
 
-	std::set< CS6Packet > recvPackets;
-	std::map< CS6Packet, ClientInfo > infoByPacket;
-	while( m_server.ReceivePacketFromClient( (char*) &pkt, sizeof( pkt ), clientAddr, clientLen ) )
+	unsigned int numAllocationsBeforeReceive = GetNumberOfThreadAllocations();
+	InboundPacket overflowPacket;
+	for( ;; )
 	{
-		ClientInfo info;
-		info.m_ipAddress = inet_ntoa( clientAddr.sin_addr );
-		info.m_portNumber = clientAddr.sin_port;
+		//Packets are received straight into the next free slot. With the queue full they still
+		//have to be read off the socket, and reliable messages are sent again by the client
+		InboundPacket* inboundPacket = m_inboundPackets.GetNextElementToFill();
+		bool isQueueFull = ( inboundPacket == nullptr );
+		if( isQueueFull )
+			inboundPacket = &overflowPacket;
+
+		//A datagram too short to reach the history count leaves it alone, so it is cleared first
+		inboundPacket->m_packet.numPreviousStates = 0;
+		if( !m_server.ReceivePacketFromClient( (char*) &inboundPacket->m_packet, sizeof( inboundPacket->m_packet ), clientAddr, clientLen ) )
+			break;
+
+		inboundPacket->m_source = GetClientInfoForAddress( clientAddr );
+		inboundPacket->m_arrivalTimeSeconds = GetCurrentTimeSeconds();
+		clientLen = sizeof( clientAddr );
+
+		//Only the type byte is read before the sender's bucket is charged, and a refused packet's
+		//slot is simply received into again
+		if( !m_rateLimiter.AllowPacket( inboundPacket->m_source, GetRateClassForPacketType( inboundPacket->m_packet.packetType ), inboundPacket->m_arrivalTimeSeconds ) )
+			continue;
+
+		if( isQueueFull )
+			InterlockedIncrement( &m_numDroppedPackets );
+		else
+			m_inboundPackets.PushElement();
+	}
+
+	InterlockedExchangeAdd( &m_numReceiveAllocations, (LONG) ( GetNumberOfThreadAllocations() - numAllocationsBeforeReceive ) );
+}
 
-		recvPackets.insert( pkt );
-		infoByPacket[ pkt ] = info;
+
+//-----------------------------------------------------------------------------------------------
+//Returns true when the batch filled up, so there may be more packets waiting
+bool GameServer::GetPackets()
+{
+	if( m_server.IsSimulated() )
+		ReceivePackets();
+
+	unsigned int numAllocationsBeforeReceive = GetNumberOfThreadAllocations();
+	m_receiveBatch.Clear();
+	CS6Packet* pkt = m_receiveBatch.GetNextPacketToFill();
+	const InboundPacket* inboundPacket = m_inboundPackets.PeekElement();
+	while( pkt && inboundPacket )
+	{
+		*pkt = inboundPacket->m_packet;
+		m_receiveBatch.CommitPacket( inboundPacket->m_source, m_sessions.FindSession( inboundPacket->m_source ), inboundPacket->m_arrivalTimeSeconds );
+		m_inboundPackets.PopElement();
+
+		pkt = m_receiveBatch.GetNextPacketToFill();
+		inboundPacket = m_inboundPackets.PeekElement();
 	}
 
-	std::set< CS6Packet >::iterator setIter;
-	for( setIter = recvPackets.begin(); setIter != recvPackets.end(); ++setIter )
+	m_receiveBatch.SortPacketsWithinSessions();
+	InterlockedExchangeAdd( &m_numReceiveAllocations, (LONG) ( GetNumberOfThreadAllocations() - numAllocationsBeforeReceive ) );
+
+	for( unsigned int packetIndex = 0; packetIndex < m_receiveBatch.GetNumberOfPackets(); ++packetIndex )
 	{
-		CS6Packet orderedPacket = *setIter;
-		ClientInfo info = infoByPacket[ orderedPacket ];
+		const CS6Packet& orderedPacket = m_receiveBatch.GetPacket( packetIndex );
+		const ClientInfo& info = m_receiveBatch.GetSource( packetIndex );
+
+		unsigned short sessionID = m_receiveBatch.GetSessionID( packetIndex );
+		if( sessionID == INVALID_SESSION_ID || !m_sessions.GetSession( sessionID ).m_isActive || !( m_sessions.GetSession( sessionID ).m_info == info ) )
+		{
+			ProcessConnectRequest( orderedPacket, info );
+			continue;
+		}
+
+		//A stale update is still carrying a good ack, so acks are taken before the window check
+		if( orderedPacket.ackedPacketType != TYPE_None )
+			ProcessAck( orderedPacket.ackedPacketType, orderedPacket.ackedPacketNumber, info );
+
+		//Updates are unreliable snapshots, so one that arrives behind a newer one is only stale state
+		Session& session = m_sessions.GetSession( sessionID );
+		bool allowOutOfOrder = ( orderedPacket.packetType != TYPE_Update );
+		bool hadReceivedAny = session.m_receiveWindow.m_hasReceivedAny;
+		SequenceNumber previousMostRecent = session.m_receiveWindow.m_mostRecentSequence;
+		if( !session.m_receiveWindow.AcceptSequence( orderedPacket.packetNumber, allowOutOfOrder ) )
+			continue;
+
+		MeasureLoss( sessionID, hadReceivedAny ? (SequenceNumber) ( session.m_receiveWindow.m_mostRecentSequence - previousMostRecent ) : 1 );
+
+		m_sessions.GetClockSync( sessionID ).ReceiveTimestamps( orderedPacket.timestamp, orderedPacket.echoTimestamp, orderedPacket.echoHoldSeconds, m_receiveBatch.GetArrivalTime( packetIndex ) );
 
 		if( orderedPacket.packetType == TYPE_Acknowledge )
 		{
-			ProcessAckPackets( orderedPacket, info );
+			ProcessAck( orderedPacket.data.acknowledged.packetType, orderedPacket.data.acknowledged.packetNumber, info );
 		}
 		else if( orderedPacket.packetType == TYPE_Update )
 		{
@@ -378,27 +970,74 @@ void GameServer::GetPackets()
 			ResetGame( orderedPacket, info );
 		}
 	}
+
+	return m_receiveBatch.GetNumberOfPackets() == MAX_PACKETS_PER_RECEIVE_BATCH;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//A victory resets every player and broadcasts to the whole game, so it gets a far tighter budget
+RateClass GameServer::GetRateClassForPacketType( PacketType packetType ) const
+{
+	if( packetType == TYPE_Victory )
+		return RATE_CLASS_Expensive;
+
+	return RATE_CLASS_Default;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Each session keeps at most one resend timer, armed for the oldest packet still waiting on an ack
+void GameServer::ArmResendTimer( unsigned short sessionID, double resendTime )
+{
+	if( sessionID == INVALID_SESSION_ID )
+		return;
+
+	Session& session = m_sessions.GetSession( sessionID );
+	if( session.m_hasResendTimer )
+		return;
+
+	session.m_hasResendTimer = true;
+	m_timers.AddTimer( MakeTimerID( GAME_TIMER_ResendReliable, m_sessions.GetTimerIndexForSession( sessionID ) ), resendTime );
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void GameServer::ResendAckPackets()
+void GameServer::ResendAckPackets( unsigned short sessionID, double currentTime )
 {
-	std::map< ClientInfo, std::vector< CS6Packet > >::iterator vecIter;
-	for( vecIter = m_sendPacketsPerClient.begin(); vecIter != m_sendPacketsPerClient.end(); ++vecIter )
+	ClientInfo info = m_sessions.GetSession( sessionID ).m_info;
+	m_sessions.GetSession( sessionID ).m_hasResendTimer = false;
+
+	std::map< ClientInfo, std::vector< CS6Packet > >::iterator vecIter = m_sendPacketsPerClient.find( info );
+	if( vecIter == m_sendPacketsPerClient.end() || vecIter->second.empty() )
+		return;
+
+	//While the client's earlier packets are still stuck in the outbound queue, resending would
+	//only pile more on behind them
+	struct sockaddr_in clientAddr;
+	clientAddr.sin_family = AF_INET;
+	clientAddr.sin_addr.s_addr = info.m_ipAddress;
+	clientAddr.sin_port = info.m_portNumber;
+	if( m_server.HasQueuedPackets( clientAddr ) )
 	{
-		std::vector< CS6Packet > sentPackets = vecIter->second;
-		for( unsigned int packetIndex = 0; packetIndex < sentPackets.size(); ++packetIndex )
+		ArmResendTimer( sessionID, currentTime + SECONDS_BEFORE_RESEND_RELIABLE_PACKETS );
+		return;
+	}
+
+	double nextResendTime = currentTime + SECONDS_BEFORE_RESEND_RELIABLE_PACKETS;
+	std::vector< CS6Packet >& sentPackets = vecIter->second;
+	for( unsigned int packetIndex = 0; packetIndex < sentPackets.size(); ++packetIndex )
+	{
+		CS6Packet* packet = &sentPackets[ packetIndex ];
+		if( ( currentTime - packet->timestamp ) >= SECONDS_BEFORE_RESEND_RELIABLE_PACKETS )
 		{
-			CS6Packet* packet = &sentPackets[ packetIndex ];
-			if( ( GetCurrentTimeSeconds() - packet->timestamp ) > SECONDS_BEFORE_RESEND_RELIABLE_PACKETS )
-			{
-				packet->packetNumber = m_nextPacketNumber;
-				packet->timestamp = GetCurrentTimeSeconds();
-				SendPacketToClient( *packet, vecIter->first, false );
-			}
+			packet->timestamp = currentTime;
+			packet->packetNumber = SendPacketToClient( *packet, info, false );
 		}
 
-		m_sendPacketsPerClient[ vecIter->first ] = sentPackets;
+		if( packet->timestamp + SECONDS_BEFORE_RESEND_RELIABLE_PACKETS < nextResendTime )
+			nextResendTime = packet->timestamp + SECONDS_BEFORE_RESEND_RELIABLE_PACKETS;
 	}
+
+	ArmResendTimer( sessionID, nextResendTime );
 }
\ No newline at end of file
@@ -13,8 +13,16 @@
 #include "Player.hpp"
 #include "Color3b.hpp"
 #include "CS6Packet.hpp"
+#include "Metrics.hpp"
 #include "UDPServer.hpp"
+#include "SPSCQueue.hpp"
 #include "ClientInfo.hpp"
+#include "TimerWheel.hpp"
+#include "ReceiveBatch.hpp"
+#include "SessionTable.hpp"
+#include "RateLimiter.hpp"
+#include "ConnectionCookies.hpp"
+#include "UpdateHistory.hpp"
 #include "../Engine/Time.hpp"
 
 
@@ -22,47 +30,143 @@
 const unsigned short PORT_NUMBER = 5000;
 const int MAP_SIZE_WIDTH = 500;
 const int MAP_SIZE_HEIGHT = 500;
+const unsigned int MAX_PLAYERS_PER_GAME = INVALID_SESSION_ID - 1;
+const unsigned short INVALID_PLAYER_INDEX = 0xffff;
+const unsigned int NUM_PLAYER_COLORS = 8;
 const double SECONDS_BEFORE_SEND_UPDATE = 0.1;
+const float DEFAULT_GAME_TICKS_PER_SECOND = 10.f;
 const double SECONDS_BEFORE_RESEND_RELIABLE_PACKETS = 0.25;
+const double SECONDS_BEFORE_SEND_STANDALONE_ACK = 0.005;
 const double SECONDS_BEFORE_TIMEOUT_REMOVE = 5.0;
+const float DEFAULT_PACKETS_PER_SECOND = 300.f;
+const float DEFAULT_PACKET_BURST = 600.f;
+const float VICTORY_PACKETS_PER_SECOND = 1.f;
+const float VICTORY_PACKET_BURST = 2.f;
+const unsigned int INBOUND_PACKET_QUEUE_CAPACITY = 1024;
+const unsigned int MAX_RECEIVE_BATCHES_PER_TICK = INBOUND_PACKET_QUEUE_CAPACITY / MAX_PACKETS_PER_RECEIVE_BATCH;
+const long RECEIVE_THREAD_WAIT_MICROSECONDS = 1000;
+const float DEFAULT_PARITY_LOSS_THRESHOLD = 0.02f;
+const unsigned int PACKETS_PER_LOSS_SAMPLE = 100;
+const float LOSS_SAMPLE_WEIGHT = 0.5f;
 
 
 //-----------------------------------------------------------------------------------------------
+enum GameServerTimerKind
+{
+	GAME_TIMER_PlayerTimeout,
+	GAME_TIMER_ResendReliable,
+	GAME_TIMER_SendAck,
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct InboundPacket
+{
+	CS6Packet		m_packet;
+	ClientInfo		m_source;
+	double			m_arrivalTimeSeconds;
+};
+typedef SPSCQueue< InboundPacket, INBOUND_PACKET_QUEUE_CAPACITY > InboundPacketQueue;
+
+
+//-----------------------------------------------------------------------------------------------
+void GameServerReceiveThreadEntryFunc( void* data );
+void SetParityLossThreshold( float lossRate );
+
+
+//-----------------------------------------------------------------------------------------------
+//Each game drains its socket on its own receive thread and hands the packets to the simulation
+//through a ring of preallocated slots, so a slow tick never leaves packets waiting in the socket
+//buffer. That thread is the ring's only producer and the tick its only consumer.
+//The lobby's scheduler calls Tick at the game's own rate, and each tick sends one snapshot
 class GameServer
 {
+	friend void GameServerReceiveThreadEntryFunc( void* data );
+
 public:
-	GameServer() {}
+	GameServer();
 	void Initalize();
-	void Update();
+	void Shutdown();
+	void SetTicksPerSecond( float ticksPerSecond );
+	double GetSecondsPerTick() const;
+	void Tick();
 	void AddPlayer( const ClientInfo& info );
-	unsigned int GetNumberOfPlayers();
+	unsigned int GetNumberOfPlayers() const;
+	const ClientInfo& GetPlayerInfo( unsigned int playerIndex ) const;
+	unsigned int GetNumberOfDroppedPackets() const;
+	unsigned int GetNumberOfRateLimitedPackets() const;
+	unsigned int GetNumberOfReceiveAllocations() const;
+	UDPSendStats GetSendStats() const;
+	unsigned int GetNumberOfAbandonedMessages() const;
+	const MetricSummary& GetReceiveQueueBytes() const;
+	void ResetReceiveQueueBytes();
+	unsigned int GetNumberOfPiggybackedAcks() const;
+	unsigned int GetNumberOfStandaloneAcks() const;
+	unsigned int GetNumberOfPreviousStatesReceived() const;
+	unsigned int GetNumberOfRecoveredStates() const;
+	unsigned int GetNumberOfParityPacketsSent() const;
+	unsigned int GetNumberOfSessionsUsingParity() const;
 
 	bool								m_isGameOver;
 	bool								m_addedPlayersToLobby;
 	unsigned int						m_gameID;
 	unsigned short						m_portNumber;
 	std::string							m_ownerName;
-	std::map< ClientInfo, Player* >		m_players;
 
 private:
-	void SendPacketToClient( const CS6Packet& pkt, const ClientInfo& info, bool requireAck );
+	void StampOutgoingPacket( CS6Packet& out_packet, unsigned short sessionID );
+	SequenceNumber SendPacketToClient( const CS6Packet& pkt, const ClientInfo& info, bool requireAck );
 	void SendPacketToAllClients( const CS6Packet& pkt, bool requireAck );
+	void AddToParityGroup( unsigned short sessionID, const CS6Packet& sentPacket );
+	void SendParityPacket( unsigned short sessionID );
+	void SendOpenParityGroups();
+	void MeasureLoss( unsigned short sessionID, unsigned int numNewPackets );
 	std::string ConvertNumberToString( int number );
 	Color3b GetPlayerColorForID( unsigned int playerID );
 	Vector2 GetRandomPosition();
-	void ProcessAckPackets( const CS6Packet& ackPacket, const ClientInfo& info );
+	Player* FindPlayer( unsigned short sessionID );
+	void ProcessConnectRequest( const CS6Packet& connectPacket, const ClientInfo& info );
+	void ProcessAck( PacketType ackedPacketType, SequenceNumber ackedPacketNumber, const ClientInfo& info );
+	void QueueAck( const CS6Packet& reliablePacket, const ClientInfo& info );
+	void SendPendingAck( unsigned short sessionID );
 	void RemovePlayer( const ClientInfo& info );
-	void CheckForTimeOutPlayers();
+	void ProcessExpiredTimers();
+	void CheckForTimeOutPlayer( unsigned short sessionID, double currentTime );
 	void ResetGame( const CS6Packet& victoryPacket, const ClientInfo& info );
 	void UpdatePlayer( const CS6Packet& updatePacket, const ClientInfo& info );
-	void SendUpdatesToClients();
+	void ApplyPlayerState( Player* player, const UpdateState& state );
+	void SendUpdatesToClients( double currentTime );
 	void SendGameOverToClients();
-	void GetPackets();
-	void ResendAckPackets();
+	void ReceivePackets();
+	bool GetPackets();
+	RateClass GetRateClassForPacketType( PacketType packetType ) const;
+	void ArmResendTimer( unsigned short sessionID, double resendTime );
+	void ResendAckPackets( unsigned short sessionID, double currentTime );
 
 	UDPServer											m_server;
-	unsigned int										m_nextPacketNumber;
-	double												m_lastUpdateTime;
+	SessionTable										m_sessions;
+	ConnectionCookies									m_cookies;
+	RateLimiter											m_rateLimiter;
+	InboundPacketQueue									m_inboundPackets;
+	volatile LONG										m_isReceiving;
+	HANDLE												m_receiveThreadExitedEvent;
+	volatile LONG										m_numDroppedPackets;
+	volatile LONG										m_numReceiveAllocations;
+	MetricSummary										m_receiveQueueBytes;
+	unsigned int										m_numPiggybackedAcks;
+	unsigned int										m_numStandaloneAcks;
+	unsigned int										m_numPreviousStatesReceived;
+	unsigned int										m_numRecoveredStates;
+	unsigned int										m_numParityPacketsSent;
+	std::vector< unsigned short >						m_sessionsWithOpenParityGroups;
+	ReceiveBatch< CS6Packet >							m_receiveBatch;
+	TimerWheel											m_timers;
+	std::vector< unsigned int >							m_expiredTimerIDs;
+	std::vector< Player >								m_players;
+	std::vector< unsigned short >						m_playerIndexBySlot;
+	unsigned short										m_nextPlayerID;
+	std::vector< char >									m_updateBatch;
+	double												m_secondsPerTick;
 	int													m_numFlagsCaptured;
 	Vector2												m_flagPosition;
 	std::map< ClientInfo, std::vector< CS6Packet > >	m_sendPacketsPerClient;
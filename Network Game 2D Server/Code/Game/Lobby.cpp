@@ -1,65 +1,140 @@
 #include "Lobby.hpp"
+#include "AllocationCounter.hpp"
 
 
 //-----------------------------------------------------------------------------------------------
 void Lobby::Initalize()
 {
 	InitializeTime();
+	UpdateFrameTime();
+	InstallAllocationCounter();
 	m_server.StartServer( PORT_NUMBER );
-	m_nextPacketNumber = 0;
+	m_sessions.Initialize( MAX_SESSIONS_PER_SERVER );
+	m_cookies.Initialize();
+	m_rateLimiter.Initialize( MAX_RATE_LIMITED_SOURCES );
+	m_rateLimiter.SetClassLimit( RATE_CLASS_Default, DEFAULT_PACKETS_PER_SECOND, DEFAULT_PACKET_BURST );
+	m_rateLimiter.SetClassLimit( RATE_CLASS_Expensive, GAME_REQUESTS_PER_SECOND, GAME_REQUEST_BURST );
 	m_nextGameID = 0;
 	m_nextPortNumber = PORT_NUMBER + 1;
-	m_lastUpdateTime = GetCurrentTimeSeconds();
 
-	std::cout << "Server is up and running\n";
+	double currentTime = GetFrameTimeSeconds();
+	m_timers.Initialize( currentTime, SECONDS_PER_TIMER_WHEEL_TICK );
+	m_timers.AddTimer( MakeTimerID( LOBBY_TIMER_Broadcast, 0 ), currentTime + SECONDS_BEFORE_SEND_UPDATE );
+	m_tickBusySeconds = 0.0;
+	m_lastLoadCheckTime = currentTime;
+	m_tickUtilization = 0.0;
+	m_isSheddingLoad = false;
+	m_numBusyResponses = 0;
+	m_numReceiveAllocations = 0;
+	m_hasForgetGameAnswersTimer = false;
+	m_numRepeatedGameAnswers = 0;
+	m_receiveQueueBytes.Reset();
+	m_lastUDPReceiveErrors = 0;
+	m_hasUDPReceiveErrors = m_server.GetUDPReceiveErrors( m_lastUDPReceiveErrors );
+	m_timers.AddTimer( MakeTimerID( LOBBY_TIMER_LoadCheck, 0 ), currentTime + SECONDS_BETWEEN_LOAD_CHECKS );
+	if( GetSecondsBetweenMetricsReports() > 0.0 )
+		m_timers.AddTimer( MakeTimerID( LOBBY_TIMER_MetricsReport, 0 ), currentTime + GetSecondsBetweenMetricsReports() );
+
+	std::cout << "Server is up and running" << ( m_server.IsUsingRegisteredIO() ? " on registered I/O" : "" ) << "\n";
 }
 
 
 //-----------------------------------------------------------------------------------------------
+//The lobby's own work in a pass runs on the time captured at the top of it, and each game tick
+//captures a fresh one
 void Lobby::Update()
 {
+	UpdateFrameTime();
+	m_server.FlushQueuedPackets();
 	UpdateGames();
 	GetPackets();
-	SendLobbyUpdates();
+	ProcessExpiredTimers();
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void Lobby::SendPacketToClient( const LobbyPacket& pkt, const ClientInfo& info, bool requireAck )
+//Sleeps on the lobby socket until the next game tick is due, the timer wheel is due to advance,
+//or a lobby packet arrives, whichever comes first. Sends still backed up in the socket's queue
+//only get a short wait before they are tried again
+void Lobby::WaitForNextUpdate()
 {
+	double waitSeconds = SECONDS_PER_TIMER_WHEEL_TICK;
+	if( m_server.GetSendStats().m_numQueuedPackets > 0 )
+		waitSeconds = MAX_SECONDS_TO_WAIT_WITH_QUEUED_SENDS;
+
+	double nextDeadline = m_gameScheduler.GetNextDeadline();
+	if( nextDeadline >= 0.0 && nextDeadline - GetCurrentTimeSeconds() < waitSeconds )
+		waitSeconds = nextDeadline - GetCurrentTimeSeconds();
+
+	if( waitSeconds <= 0.0 )
+		return;
+
+	m_server.WaitForPacketFromClient( (long) ( waitSeconds * 1000000.0 ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+SequenceNumber Lobby::SendPacketToClient( const LobbyPacket& pkt, const ClientInfo& info, bool requireAck )
+{
+	LobbyPacket sequencedPacket = pkt;
+	sequencedPacket.packetNumber = GetNextSequenceNumber( info );
+	sequencedPacket.echoTimestamp = 0.0;
+	sequencedPacket.echoHoldSeconds = 0.f;
+
+	unsigned short sessionID = m_sessions.FindSession( info );
+	if( sessionID != INVALID_SESSION_ID )
+		m_sessions.GetClockSync( sessionID ).GetEchoTimestamps( sequencedPacket.timestamp, sequencedPacket.echoTimestamp, sequencedPacket.echoHoldSeconds );
+
 	struct sockaddr_in clientAddr;
 	clientAddr.sin_family = AF_INET;
-	clientAddr.sin_addr.s_addr = inet_addr( info.m_ipAddress );
+	clientAddr.sin_addr.s_addr = info.m_ipAddress;
 	clientAddr.sin_port = info.m_portNumber;
-	m_server.SendPacketToClient( (const char*) &pkt, sizeof( pkt ), clientAddr );
-	++m_nextPacketNumber;
+
+	//Game listings go out again on the next broadcast, so they are the ones a full queue gives up
+	m_server.SendPacketToClient( (const char*) &sequencedPacket, sizeof( sequencedPacket ), clientAddr, sequencedPacket.packetType != LOBBY_TYPE_Update );
 
 	if( requireAck )
 	{
-		std::vector< LobbyPacket > sentPackets;
-		std::map< ClientInfo, std::vector< LobbyPacket > >::iterator vecIter = m_sendPacketsPerClient.find( info );
-		if( vecIter != m_sendPacketsPerClient.end() )
-		{
-			sentPackets = vecIter->second;
-		}
-
-		sentPackets.push_back( pkt );
-		m_sendPacketsPerClient[ info ] = sentPackets;
+		m_sendPacketsPerClient[ info ].push_back( sequencedPacket );
+		ArmResendTimer( sessionID, sequencedPacket.timestamp + SECONDS_BEFORE_RESEND_RELIABLE_PACKETS );
 	}
+
+	return sequencedPacket.packetNumber;
 }
 
 
 //-----------------------------------------------------------------------------------------------
 void Lobby::SendPacketToAllClients( const LobbyPacket& pkt, bool requireAck )
 {
-	std::set< ClientInfo >::iterator playerIter;
+	std::map< ClientInfo, LobbyPresence >::iterator playerIter;
 	for( playerIter = m_lobbyPlayers.begin(); playerIter != m_lobbyPlayers.end(); ++playerIter )
 	{
-		SendPacketToClient( pkt, *playerIter, requireAck );
+		SendPacketToClient( pkt, playerIter->first, requireAck );
 	}
 }
 
 
+//-----------------------------------------------------------------------------------------------
+SequenceNumber Lobby::GetNextSequenceNumber( const ClientInfo& info )
+{
+	unsigned short sessionID = m_sessions.FindSession( info );
+	if( sessionID == INVALID_SESSION_ID )
+	{
+		std::map< ClientInfo, GameAnswer >::iterator answerIter = m_gameAnswers.find( info );
+		if( answerIter == m_gameAnswers.end() )
+			return 0;
+
+		return answerIter->second.m_nextSequenceNumber++;
+	}
+
+	Session& session = m_sessions.GetSession( sessionID );
+	SequenceNumber sequenceNumber = session.m_nextSequenceNumber;
+	++session.m_nextSequenceNumber;
+
+	return sequenceNumber;
+}
+
+
 //-----------------------------------------------------------------------------------------------
 std::string Lobby::ConvertNumberToString( int number )
 {
@@ -68,15 +143,25 @@ std::string Lobby::ConvertNumberToString( int number )
 
 
 //-----------------------------------------------------------------------------------------------
+//Only games whose deadline has passed are ticked, most overdue first. The clock is read again
+//before each one, so time spent in one game's tick shows up as lateness for the next
 void Lobby::UpdateGames()
 {
-	std::map< int, GameServer* >::iterator gameIter;
-	std::vector< std::map< int, GameServer* >::iterator > gamesToRemove;
-
-	for( gameIter = m_games.begin(); gameIter != m_games.end(); ++gameIter )
+	unsigned int gameID = 0;
+	while( m_gameScheduler.PopDueTask( GetCurrentTimeSeconds(), gameID ) )
 	{
+		std::map< int, GameServer* >::iterator gameIter = m_games.find( gameID );
+		if( gameIter == m_games.end() )
+			continue;
+
 		GameServer* game = gameIter->second;
-		game->Update();
+		UpdateFrameTime();
+		game->Tick();
+
+		double finishTime = GetCurrentTimeSeconds();
+		m_tickBusySeconds += finishTime - GetFrameTimeSeconds();
+		m_gameScheduler.FinishTask( gameID, GetFrameTimeSeconds(), finishTime );
+
 		if( game->m_isGameOver )
 		{
 			if( !game->m_addedPlayersToLobby )
@@ -85,45 +170,71 @@ void Lobby::UpdateGames()
 				game->m_addedPlayersToLobby = true;
 			}
 
-			if( game->m_players.size() == 0 )
+			if( game->GetNumberOfPlayers() == 0 )
 			{
-				gamesToRemove.push_back( gameIter );
+				m_gameScheduler.RemoveTask( gameID );
+				m_reducedGameIDs.erase( std::remove( m_reducedGameIDs.begin(), m_reducedGameIDs.end(), (int) gameID ), m_reducedGameIDs.end() );
+				game->Shutdown();
+				delete game;
+
+				m_games.erase( gameIter );
 			}
 		}
 	}
-
-	for( unsigned int removeIndex = 0; removeIndex < gamesToRemove.size(); ++removeIndex )
-	{
-		m_games.erase( gamesToRemove[ removeIndex ] );
-	}
 }
 
 
 //-----------------------------------------------------------------------------------------------
 void Lobby::GetPackets()
 {
-	LobbyPacket pkt;
 	struct sockaddr_in clientAddr;
 	clientAddr.sin_family = AF_INET;
 	int clientLen = sizeof( clientAddr );
+	double currentTime = GetFrameTimeSeconds();
 
-	std::set< LobbyPacket > recvPackets;
-	std::map< LobbyPacket, ClientInfo > infoByPacket;
-	while( m_server.ReceivePacketFromClient( (char*) &pkt, sizeof( pkt ), clientAddr, clientLen ) )
+	m_receiveQueueBytes.AddSample( (double) m_server.GetPendingReceiveBytes() );
+
+	unsigned int numAllocationsBeforeReceive = GetNumberOfThreadAllocations();
+	m_receiveBatch.Clear();
+	LobbyPacket* pkt = m_receiveBatch.GetNextPacketToFill();
+	while( pkt && m_server.ReceivePacketFromClient( (char*) pkt, sizeof( *pkt ), clientAddr, clientLen ) )
 	{
-		ClientInfo info;
-		info.m_ipAddress = inet_ntoa( clientAddr.sin_addr );
-		info.m_portNumber = clientAddr.sin_port;
+		ClientInfo info = GetClientInfoForAddress( clientAddr );
+		clientLen = sizeof( clientAddr );
+
+		//Only the type byte is read before the sender's bucket is charged, and a refused packet's
+		//slot is simply received into again
+		if( !m_rateLimiter.AllowPacket( info, GetRateClassForPacketType( pkt->packetType ), currentTime ) )
+			continue;
 
-		recvPackets.insert( pkt );
-		infoByPacket[ pkt ] = info;
+		m_receiveBatch.CommitPacket( info, m_sessions.FindSession( info ), currentTime );
+		pkt = m_receiveBatch.GetNextPacketToFill();
 	}
 
-	std::set< LobbyPacket >::iterator setIter;
-	for( setIter = recvPackets.begin(); setIter != recvPackets.end(); ++setIter )
+	m_receiveBatch.SortPacketsWithinSessions();
+	m_numReceiveAllocations += GetNumberOfThreadAllocations() - numAllocationsBeforeReceive;
+
+	for( unsigned int packetIndex = 0; packetIndex < m_receiveBatch.GetNumberOfPackets(); ++packetIndex )
 	{
-		LobbyPacket orderedPacket = *setIter;
-		ClientInfo info = infoByPacket[ orderedPacket ];
+		const LobbyPacket& orderedPacket = m_receiveBatch.GetPacket( packetIndex );
+		const ClientInfo& info = m_receiveBatch.GetSource( packetIndex );
+
+		unsigned short sessionID = m_receiveBatch.GetSessionID( packetIndex );
+		if( sessionID == INVALID_SESSION_ID || !m_sessions.GetSession( sessionID ).m_isActive || !( m_sessions.GetSession( sessionID ).m_info == info ) )
+		{
+			ProcessConnectRequest( orderedPacket, info );
+			continue;
+		}
+
+		//A heartbeat that arrives behind a newer packet carries nothing worth processing
+		Session& session = m_sessions.GetSession( sessionID );
+		bool allowOutOfOrder = ( orderedPacket.packetType != LOBBY_TYPE_Heartbeat );
+		if( !session.m_receiveWindow.AcceptSequence( orderedPacket.packetNumber, allowOutOfOrder ) )
+			continue;
+
+		m_sessions.GetClockSync( sessionID ).ReceiveTimestamps( orderedPacket.timestamp, orderedPacket.echoTimestamp, orderedPacket.echoHoldSeconds, currentTime );
+
+		RefreshLobbyPlayer( info );
 
 		if( orderedPacket.packetType == LOBBY_TYPE_Acknowledge )
 		{
@@ -137,16 +248,29 @@ void Lobby::GetPackets()
 		{
 			AddPlayerToGame( orderedPacket, info );
 		}
+		else if( orderedPacket.packetType == LOBBY_TYPE_Heartbeat )
+		{
+			AddOrRefreshLobbyPlayer( info );
+		}
 	}
 }
 
 
 //-----------------------------------------------------------------------------------------------
-void Lobby::SendLobbyUpdates()
+//Creating a game opens a socket and starts a server, and joining one adds a player to it, so both
+//get a far tighter budget than everything else
+RateClass Lobby::GetRateClassForPacketType( PacketType packetType ) const
 {
-	if( ( GetCurrentTimeSeconds() - m_lastUpdateTime ) < SECONDS_BEFORE_SEND_UPDATE )
-		return;
+	if( packetType == LOBBY_TYPE_CreateGame || packetType == LOBBY_TYPE_JoinGame )
+		return RATE_CLASS_Expensive;
 
+	return RATE_CLASS_Default;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void Lobby::SendLobbyUpdates( double currentTime )
+{
 	std::map< int, GameServer* >::iterator gameIter;
 	for( gameIter = m_games.begin(); gameIter != m_games.end(); ++gameIter )
 	{
@@ -154,36 +278,189 @@ void Lobby::SendLobbyUpdates()
 
 		LobbyPacket updatePacket;
 		updatePacket.packetType = LOBBY_TYPE_Update;
-		updatePacket.timestamp = GetCurrentTimeSeconds();
+		updatePacket.timestamp = currentTime;
 		updatePacket.data.update.gameID = gameIter->first;
 		updatePacket.data.update.numPlayersInGame = (unsigned char) game->GetNumberOfPlayers();
 		strcpy_s( updatePacket.data.update.gameOwner, game->m_ownerName.c_str() );
 
-		std::set< ClientInfo >::iterator playerIter;
+		std::map< ClientInfo, LobbyPresence >::iterator playerIter;
 		for( playerIter = m_lobbyPlayers.begin(); playerIter != m_lobbyPlayers.end(); ++playerIter )
 		{
-			updatePacket.packetNumber = m_nextPacketNumber;
-			SendPacketToClient( updatePacket, *playerIter, false );
+			SendPacketToClient( updatePacket, playerIter->first, false );
 		}
 	}
 
-	m_lastUpdateTime = GetCurrentTimeSeconds();
+	m_timers.AddTimer( MakeTimerID( LOBBY_TIMER_Broadcast, 0 ), currentTime + SECONDS_BEFORE_SEND_UPDATE );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void Lobby::AddOrRefreshLobbyPlayer( const ClientInfo& info )
+{
+	std::map< ClientInfo, LobbyPresence >::iterator playerIter = m_lobbyPlayers.find( info );
+	if( playerIter != m_lobbyPlayers.end() )
+	{
+		playerIter->second.m_lastHeardTime = GetFrameTimeSeconds();
+		return;
+	}
+
+	//A full session table turns the player away, since nothing could time them out of the lobby
+	unsigned short sessionID = m_sessions.AddSession( info );
+	if( sessionID == INVALID_SESSION_ID )
+		return;
+
+	LobbyPresence presence;
+	presence.m_lastHeardTime = GetFrameTimeSeconds();
+	m_lobbyPlayers[ info ] = presence;
+	m_gameAnswers.erase( info );
+
+	unsigned int timerID = MakeTimerID( LOBBY_TIMER_Presence, m_sessions.GetTimerIndexForSession( sessionID ) );
+	m_timers.AddTimer( timerID, presence.m_lastHeardTime + SECONDS_BEFORE_LOBBY_TIMEOUT_REMOVE );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void Lobby::RefreshLobbyPlayer( const ClientInfo& info )
+{
+	std::map< ClientInfo, LobbyPresence >::iterator playerIter = m_lobbyPlayers.find( info );
+	if( playerIter != m_lobbyPlayers.end() )
+	{
+		playerIter->second.m_lastHeardTime = GetFrameTimeSeconds();
+	}
 }
 
 
 //-----------------------------------------------------------------------------------------------
 void Lobby::RemovePlayerFromLobby( const ClientInfo& info )
 {
-	std::set< ClientInfo >::iterator playerIter;
-	for( playerIter = m_lobbyPlayers.begin(); playerIter != m_lobbyPlayers.end(); ++playerIter )
+	std::map< ClientInfo, LobbyPresence >::iterator playerIter = m_lobbyPlayers.find( info );
+	if( playerIter != m_lobbyPlayers.end() )
+	{
+		//The presence timer is left in the wheel and ignored when it fires
+		m_lobbyPlayers.erase( playerIter );
+		m_sendPacketsPerClient.erase( info );
+		m_sessions.RemoveSession( info );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void Lobby::ProcessExpiredTimers()
+{
+	double currentTime = GetFrameTimeSeconds();
+
+	m_expiredTimerIDs.clear();
+	m_timers.AdvanceTime( currentTime, m_expiredTimerIDs );
+
+	for( unsigned int timerIndex = 0; timerIndex < m_expiredTimerIDs.size(); ++timerIndex )
 	{
-		ClientInfo playerInfo = *playerIter;
-		if( playerInfo.m_ipAddress == info.m_ipAddress && playerInfo.m_portNumber == info.m_portNumber )
+		unsigned int timerID = m_expiredTimerIDs[ timerIndex ];
+		if( GetTimerKind( timerID ) == LOBBY_TIMER_Broadcast )
 		{
-			m_lobbyPlayers.erase( playerIter );
-			return;
+			SendLobbyUpdates( currentTime );
+			continue;
+		}
+
+		if( GetTimerKind( timerID ) == LOBBY_TIMER_MetricsReport )
+		{
+			ReportMetrics( currentTime );
+			continue;
+		}
+
+		if( GetTimerKind( timerID ) == LOBBY_TIMER_LoadCheck )
+		{
+			CheckLoad( currentTime );
+			continue;
+		}
+
+		if( GetTimerKind( timerID ) == LOBBY_TIMER_ForgetGameAnswers )
+		{
+			ForgetExpiredGameAnswers( currentTime );
+			continue;
 		}
+
+		//Timers armed for a session that has since been removed or reused are dropped here
+		unsigned short sessionID = m_sessions.GetSessionForTimerIndex( GetTimerIndex( timerID ) );
+		if( sessionID == INVALID_SESSION_ID )
+			continue;
+
+		if( GetTimerKind( timerID ) == LOBBY_TIMER_Presence )
+		{
+			RemoveTimedOutLobbyPlayer( sessionID, currentTime );
+		}
+		else if( GetTimerKind( timerID ) == LOBBY_TIMER_ResendReliable )
+		{
+			ResendAckPackets( sessionID, currentTime );
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void Lobby::RemoveTimedOutLobbyPlayer( unsigned short sessionID, double currentTime )
+{
+	ClientInfo info = m_sessions.GetSession( sessionID ).m_info;
+	std::map< ClientInfo, LobbyPresence >::iterator playerIter = m_lobbyPlayers.find( info );
+	if( playerIter == m_lobbyPlayers.end() )
+		return;
+
+	//Heartbeats only touch the timestamp, so a timer that fires for a live client is re-armed here
+	double deadline = playerIter->second.m_lastHeardTime + SECONDS_BEFORE_LOBBY_TIMEOUT_REMOVE;
+	if( deadline > currentTime )
+	{
+		m_timers.AddTimer( MakeTimerID( LOBBY_TIMER_Presence, m_sessions.GetTimerIndexForSession( sessionID ) ), deadline );
+		return;
 	}
+
+	m_lobbyPlayers.erase( playerIter );
+	m_sendPacketsPerClient.erase( info );
+	m_sessions.RemoveSession( info );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Sources outside the lobby only ever get a challenge back. Nothing is allocated for them until
+//they echo a cookie, either on a connect ack or on a heartbeat after being timed out, and both
+//get a connection ack that tells the client the old session's numbering is gone. A client that
+//was just sent to a game and is still heartbeating hasn't seen that ack yet, so it isn't let
+//back in, and its next game request gets the same ack again
+void Lobby::ProcessConnectRequest( const LobbyPacket& connectPacket, const ClientInfo& info )
+{
+	double currentTime = GetFrameTimeSeconds();
+	std::map< ClientInfo, GameAnswer >::iterator answerIter = m_gameAnswers.find( info );
+	bool hasGameAnswer = ( answerIter != m_gameAnswers.end() && answerIter->second.m_expiryTime > currentTime );
+
+	unsigned long long echoedCookie = 0;
+	if( connectPacket.packetType == LOBBY_TYPE_Acknowledge && connectPacket.data.acknowledged.packetType == LOBBY_TYPE_Acknowledge )
+	{
+		echoedCookie = connectPacket.data.acknowledged.cookie;
+	}
+	else if( connectPacket.packetType == LOBBY_TYPE_Heartbeat && !hasGameAnswer )
+	{
+		echoedCookie = connectPacket.data.challenge.cookie;
+	}
+	else
+	{
+		bool isGameRequest = ( connectPacket.packetType == LOBBY_TYPE_CreateGame || connectPacket.packetType == LOBBY_TYPE_JoinGame );
+		if( isGameRequest && hasGameAnswer )
+			AnswerRepeatedGameRequest( connectPacket, info, answerIter->second );
+
+		return;
+	}
+
+	if( m_cookies.IsCookieValid( info, echoedCookie, currentTime ) )
+	{
+		AddOrRefreshLobbyPlayer( info );
+		AcknowledgeConnection( connectPacket, info );
+		return;
+	}
+
+	LobbyPacket challengePacket;
+	challengePacket.packetType = LOBBY_TYPE_Challenge;
+	challengePacket.timestamp = currentTime;
+	challengePacket.data.challenge.cookie = m_cookies.MakeCookie( info, currentTime );
+
+	SendPacketToClient( challengePacket, info, false );
 }
 
 
@@ -191,9 +468,8 @@ void Lobby::RemovePlayerFromLobby( const ClientInfo& info )
 void Lobby::AcknowledgeConnection( const LobbyPacket& packet, const ClientInfo& info )
 {
 	LobbyPacket ackPacket;
-	ackPacket.packetNumber = m_nextPacketNumber;
 	ackPacket.packetType = LOBBY_TYPE_Acknowledge;
-	ackPacket.timestamp = GetCurrentTimeSeconds();
+	ackPacket.timestamp = GetFrameTimeSeconds();
 	ackPacket.data.acknowledged.packetNumber = packet.packetNumber;
 	ackPacket.data.acknowledged.packetType = LOBBY_TYPE_Acknowledge;
 
@@ -206,21 +482,19 @@ void Lobby::ProcessAckPackets( const LobbyPacket& ackPacket, const ClientInfo& i
 {
 	if( ackPacket.data.acknowledged.packetType == LOBBY_TYPE_Acknowledge )
 	{
-		m_lobbyPlayers.insert( info );
+		AddOrRefreshLobbyPlayer( info );
 		AcknowledgeConnection( ackPacket, info );
 	}
 
 	std::map< ClientInfo, std::vector< LobbyPacket > >::iterator vecIter = m_sendPacketsPerClient.find( info );
 	if( vecIter != m_sendPacketsPerClient.end() )
 	{
-		std::vector< LobbyPacket > sentPackets = vecIter->second;
+		std::vector< LobbyPacket >& sentPackets = vecIter->second;
 		for( unsigned int packetIndex = 0; packetIndex < sentPackets.size(); ++packetIndex )
 		{
-			LobbyPacket packet = sentPackets[ packetIndex ];
-			if( packet.packetNumber == ackPacket.data.acknowledged.packetNumber )
+			if( sentPackets[ packetIndex ].packetNumber == ackPacket.data.acknowledged.packetNumber )
 			{
 				sentPackets.erase( sentPackets.begin() + packetIndex );
-				m_sendPacketsPerClient[ info ] = sentPackets;
 				break;
 			}
 		}
@@ -231,23 +505,31 @@ void Lobby::ProcessAckPackets( const LobbyPacket& ackPacket, const ClientInfo& i
 //-----------------------------------------------------------------------------------------------
 void Lobby::CreateGame( const LobbyPacket& createPacket, const ClientInfo& gameOwner )
 {
+	if( m_isSheddingLoad )
+	{
+		SendBusyResponse( createPacket, gameOwner );
+		return;
+	}
+
 	GameServer* game = new GameServer();
 	game->m_gameID = m_nextGameID;
 	game->m_portNumber = m_nextPortNumber;
-	game->m_ownerName = std::string( gameOwner.m_ipAddress ) + ":" + ConvertNumberToString( gameOwner.m_portNumber );
+	game->m_ownerName = gameOwner.GetIPAddressString() + ":" + ConvertNumberToString( gameOwner.m_portNumber );
+	game->SetTicksPerSecond( DEFAULT_GAME_TICKS_PER_SECOND );
 	game->Initalize();
 	game->AddPlayer( gameOwner );
 	m_games[ m_nextGameID ] = game;
+	m_gameScheduler.AddTask( m_nextGameID, game->GetSecondsPerTick(), GetFrameTimeSeconds() );
 
 	LobbyPacket ackPacket;
-	ackPacket.packetNumber = m_nextPacketNumber;
 	ackPacket.packetType = LOBBY_TYPE_Acknowledge;
-	ackPacket.timestamp = GetCurrentTimeSeconds();
+	ackPacket.timestamp = GetFrameTimeSeconds();
 	ackPacket.data.acknowledged.packetNumber = createPacket.packetNumber;
 	ackPacket.data.acknowledged.portNumber = m_nextPortNumber;
 	ackPacket.data.acknowledged.packetType = LOBBY_TYPE_CreateGame;
 
 	SendPacketToClient( ackPacket, gameOwner, false );
+	RememberGameAnswer( ackPacket, gameOwner );
 	RemovePlayerFromLobby( gameOwner );
 
 	++m_nextGameID;
@@ -255,14 +537,99 @@ void Lobby::CreateGame( const LobbyPacket& createPacket, const ClientInfo& gameO
 }
 
 
+//-----------------------------------------------------------------------------------------------
+void Lobby::SendBusyResponse( const LobbyPacket& requestPacket, const ClientInfo& info )
+{
+	LobbyPacket busyPacket;
+	busyPacket.packetType = LOBBY_TYPE_Busy;
+	busyPacket.timestamp = GetFrameTimeSeconds();
+	busyPacket.data.busy.packetType = requestPacket.packetType;
+	busyPacket.data.busy.packetNumber = requestPacket.packetNumber;
+	busyPacket.data.busy.retryAfterSeconds = SECONDS_BEFORE_RETRY_WHEN_BUSY;
+
+	SendPacketToClient( busyPacket, info, false );
+	++m_numBusyResponses;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Utilization is the share of the last interval spent inside game ticks. Between the two
+//thresholds nothing changes, so the server doesn't flap around a single value
+void Lobby::CheckLoad( double currentTime )
+{
+	double elapsedSeconds = currentTime - m_lastLoadCheckTime;
+	m_tickUtilization = elapsedSeconds > 0.0 ? m_tickBusySeconds / elapsedSeconds : 0.0;
+	m_tickBusySeconds = 0.0;
+	m_lastLoadCheckTime = currentTime;
+
+	if( m_tickUtilization >= LOAD_SHEDDING_START_UTILIZATION )
+	{
+		m_isSheddingLoad = true;
+		ReduceGameTickRate();
+	}
+	else if( m_tickUtilization <= LOAD_SHEDDING_STOP_UTILIZATION && m_isSheddingLoad )
+	{
+		RestoreGameTickRate();
+		m_isSheddingLoad = !m_reducedGameIDs.empty();
+	}
+
+	m_timers.AddTimer( MakeTimerID( LOBBY_TIMER_LoadCheck, 0 ), currentTime + SECONDS_BETWEEN_LOAD_CHECKS );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The game with the fewest players goes first, and the newest of those, so the fewest players
+//feel it and long-running games are left alone longest
+void Lobby::ReduceGameTickRate()
+{
+	GameServer* reducedGame = nullptr;
+	int reducedGameID = 0;
+
+	std::map< int, GameServer* >::iterator gameIter;
+	for( gameIter = m_games.begin(); gameIter != m_games.end(); ++gameIter )
+	{
+		GameServer* game = gameIter->second;
+		if( std::find( m_reducedGameIDs.begin(), m_reducedGameIDs.end(), gameIter->first ) != m_reducedGameIDs.end() )
+			continue;
+
+		if( !reducedGame || game->GetNumberOfPlayers() <= reducedGame->GetNumberOfPlayers() )
+		{
+			reducedGame = game;
+			reducedGameID = gameIter->first;
+		}
+	}
+
+	if( !reducedGame )
+		return;
+
+	reducedGame->SetTicksPerSecond( REDUCED_GAME_TICKS_PER_SECOND );
+	m_gameScheduler.SetTaskSecondsPerTick( reducedGameID, reducedGame->GetSecondsPerTick() );
+	m_reducedGameIDs.push_back( reducedGameID );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Games come back in the reverse of the order they were reduced
+void Lobby::RestoreGameTickRate()
+{
+	if( m_reducedGameIDs.empty() )
+		return;
+
+	int gameID = m_reducedGameIDs.back();
+	m_reducedGameIDs.pop_back();
+
+	GameServer* game = m_games[ gameID ];
+	game->SetTicksPerSecond( DEFAULT_GAME_TICKS_PER_SECOND );
+	m_gameScheduler.SetTaskSecondsPerTick( gameID, game->GetSecondsPerTick() );
+}
+
+
 //-----------------------------------------------------------------------------------------------
 void Lobby::AddPlayersToLobby( const GameServer* game )
 {
-	std::map< ClientInfo, Player* > players = game->m_players;
-	std::map< ClientInfo, Player* >::iterator playerIter;
-	for( playerIter = players.begin(); playerIter != players.end(); ++playerIter )
+	for( unsigned int playerIndex = 0; playerIndex < game->GetNumberOfPlayers(); ++playerIndex )
 	{
-		m_lobbyPlayers.insert( playerIter->first );
+		AddOrRefreshLobbyPlayer( game->GetPlayerInfo( playerIndex ) );
 	}
 }
 
@@ -279,14 +646,14 @@ void Lobby::AddPlayerToGame( const LobbyPacket& joinPacket, const ClientInfo& in
 			game->AddPlayer( info );
 
 			LobbyPacket ackPacket;
-			ackPacket.packetNumber = m_nextPacketNumber;
 			ackPacket.packetType = LOBBY_TYPE_Acknowledge;
-			ackPacket.timestamp = GetCurrentTimeSeconds();
+			ackPacket.timestamp = GetFrameTimeSeconds();
 			ackPacket.data.acknowledged.packetNumber = joinPacket.packetNumber;
 			ackPacket.data.acknowledged.portNumber = game->m_portNumber;
 			ackPacket.data.acknowledged.packetType = LOBBY_TYPE_JoinGame;
 
 			SendPacketToClient( ackPacket, info, false );
+			RememberGameAnswer( ackPacket, info );
 			RemovePlayerFromLobby( info );
 
 			return;
@@ -294,9 +661,8 @@ void Lobby::AddPlayerToGame( const LobbyPacket& joinPacket, const ClientInfo& in
 	}
 
 	LobbyPacket ackPacket;
-	ackPacket.packetNumber = m_nextPacketNumber;
 	ackPacket.packetType = LOBBY_TYPE_Acknowledge;
-	ackPacket.timestamp = GetCurrentTimeSeconds();
+	ackPacket.timestamp = GetFrameTimeSeconds();
 	ackPacket.data.acknowledged.packetNumber = joinPacket.packetNumber;
 	ackPacket.data.acknowledged.portNumber = PORT_NUMBER;
 	ackPacket.data.acknowledged.packetType = LOBBY_TYPE_JoinGame;
@@ -306,21 +672,204 @@ void Lobby::AddPlayerToGame( const LobbyPacket& joinPacket, const ClientInfo& in
 
 
 //-----------------------------------------------------------------------------------------------
-void Lobby::ResendAckPackets()
+//Called just before the client's lobby session is removed, while its packet numbering is still there
+void Lobby::RememberGameAnswer( const LobbyPacket& ackPacket, const ClientInfo& info )
 {
-	std::map< ClientInfo, std::vector< LobbyPacket > >::iterator vecIter;
-	for( vecIter = m_sendPacketsPerClient.begin(); vecIter != m_sendPacketsPerClient.end(); ++vecIter )
+	unsigned short sessionID = m_sessions.FindSession( info );
+	if( sessionID == INVALID_SESSION_ID )
+		return;
+
+	GameAnswer& answer = m_gameAnswers[ info ];
+	answer.m_requestType = ackPacket.data.acknowledged.packetType;
+	answer.m_portNumber = ackPacket.data.acknowledged.portNumber;
+	answer.m_nextSequenceNumber = m_sessions.GetSession( sessionID ).m_nextSequenceNumber;
+	answer.m_expiryTime = GetFrameTimeSeconds() + SECONDS_TO_REMEMBER_GAME_ANSWER;
+
+	if( !m_hasForgetGameAnswersTimer )
 	{
-		std::vector< LobbyPacket > sentPackets = vecIter->second;
-		for( unsigned int packetIndex = 0; packetIndex < sentPackets.size(); ++packetIndex )
+		m_hasForgetGameAnswersTimer = true;
+		m_timers.AddTimer( MakeTimerID( LOBBY_TIMER_ForgetGameAnswers, 0 ), answer.m_expiryTime );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Resends are renumbered by the client, so the ack names the packet that just arrived
+void Lobby::AnswerRepeatedGameRequest( const LobbyPacket& requestPacket, const ClientInfo& info, const GameAnswer& answer )
+{
+	LobbyPacket ackPacket;
+	ackPacket.packetType = LOBBY_TYPE_Acknowledge;
+	ackPacket.timestamp = GetFrameTimeSeconds();
+	ackPacket.data.acknowledged.packetNumber = requestPacket.packetNumber;
+	ackPacket.data.acknowledged.portNumber = answer.m_portNumber;
+	ackPacket.data.acknowledged.packetType = answer.m_requestType;
+
+	SendPacketToClient( ackPacket, info, false );
+	++m_numRepeatedGameAnswers;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void Lobby::ForgetExpiredGameAnswers( double currentTime )
+{
+	m_hasForgetGameAnswersTimer = false;
+
+	double nextExpiryTime = 0.0;
+	std::map< ClientInfo, GameAnswer >::iterator answerIter = m_gameAnswers.begin();
+	while( answerIter != m_gameAnswers.end() )
+	{
+		if( answerIter->second.m_expiryTime <= currentTime )
 		{
-			LobbyPacket* packet = &sentPackets[ packetIndex ];
-			if( ( GetCurrentTimeSeconds() - packet->timestamp ) > SECONDS_BEFORE_RESEND_RELIABLE_PACKETS )
-			{
-				packet->packetNumber = m_nextPacketNumber;
-				packet->timestamp = GetCurrentTimeSeconds();
-				SendPacketToClient( *packet, vecIter->first, false );
-			}
+			m_gameAnswers.erase( answerIter++ );
+			continue;
+		}
+
+		if( !m_hasForgetGameAnswersTimer || answerIter->second.m_expiryTime < nextExpiryTime )
+			nextExpiryTime = answerIter->second.m_expiryTime;
+
+		m_hasForgetGameAnswersTimer = true;
+		++answerIter;
+	}
+
+	if( m_hasForgetGameAnswersTimer )
+		m_timers.AddTimer( MakeTimerID( LOBBY_TIMER_ForgetGameAnswers, 0 ), nextExpiryTime );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Each session keeps at most one resend timer, armed for the oldest packet still waiting on an ack
+void Lobby::ArmResendTimer( unsigned short sessionID, double resendTime )
+{
+	if( sessionID == INVALID_SESSION_ID )
+		return;
+
+	Session& session = m_sessions.GetSession( sessionID );
+	if( session.m_hasResendTimer )
+		return;
+
+	session.m_hasResendTimer = true;
+	m_timers.AddTimer( MakeTimerID( LOBBY_TIMER_ResendReliable, m_sessions.GetTimerIndexForSession( sessionID ) ), resendTime );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void Lobby::ResendAckPackets( unsigned short sessionID, double currentTime )
+{
+	ClientInfo info = m_sessions.GetSession( sessionID ).m_info;
+	m_sessions.GetSession( sessionID ).m_hasResendTimer = false;
+
+	std::map< ClientInfo, std::vector< LobbyPacket > >::iterator vecIter = m_sendPacketsPerClient.find( info );
+	if( vecIter == m_sendPacketsPerClient.end() || vecIter->second.empty() )
+		return;
+
+	//Try again later rather than add copies behind packets the socket hasn't taken yet
+	struct sockaddr_in clientAddr;
+	clientAddr.sin_family = AF_INET;
+	clientAddr.sin_addr.s_addr = info.m_ipAddress;
+	clientAddr.sin_port = info.m_portNumber;
+	if( m_server.HasQueuedPackets( clientAddr ) )
+	{
+		ArmResendTimer( sessionID, currentTime + SECONDS_BEFORE_RESEND_RELIABLE_PACKETS );
+		return;
+	}
+
+	double nextResendTime = currentTime + SECONDS_BEFORE_RESEND_RELIABLE_PACKETS;
+	std::vector< LobbyPacket >& sentPackets = vecIter->second;
+	for( unsigned int packetIndex = 0; packetIndex < sentPackets.size(); ++packetIndex )
+	{
+		LobbyPacket* packet = &sentPackets[ packetIndex ];
+		if( ( currentTime - packet->timestamp ) >= SECONDS_BEFORE_RESEND_RELIABLE_PACKETS )
+		{
+			packet->timestamp = currentTime;
+			packet->packetNumber = SendPacketToClient( *packet, info, false );
 		}
+
+		if( packet->timestamp + SECONDS_BEFORE_RESEND_RELIABLE_PACKETS < nextResendTime )
+			nextResendTime = packet->timestamp + SECONDS_BEFORE_RESEND_RELIABLE_PACKETS;
 	}
+
+	ArmResendTimer( sessionID, nextResendTime );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Tick figures cover the time since the last report and are reset here. Jitter and tick times are
+//shown in milliseconds. Receive queue depth is sampled before each batch is drained, so a mean that
+//keeps climbing along with the UDP receive errors means the loop can't keep up and packets are
+//being lost on this machine, not on the network
+void Lobby::ReportMetrics( double currentTime )
+{
+	m_metricsReport.BeginReport( currentTime );
+	m_metricsReport.BeginLine( "lobby" );
+	m_metricsReport.AddValue( "players", (double) m_lobbyPlayers.size() );
+	m_metricsReport.AddValue( "games", (double) m_games.size() );
+	m_metricsReport.AddValue( "tick utilization", m_tickUtilization );
+	m_metricsReport.AddValue( "shedding load", m_isSheddingLoad ? 1.0 : 0.0 );
+	m_metricsReport.AddValue( "reduced games", (double) m_reducedGameIDs.size() );
+	m_metricsReport.AddValue( "busy responses", (double) m_numBusyResponses );
+	m_metricsReport.AddValue( "rate limited packets", (double) m_rateLimiter.GetNumberOfDroppedPackets() );
+	m_metricsReport.AddValue( "repeated game answers", (double) m_numRepeatedGameAnswers );
+	AddSendStatsToReport( m_server.GetSendStats() );
+	m_metricsReport.AddValue( "abandoned messages", (double) m_server.GetNumberOfAbandonedMessages() );
+	if( IsCountingAllocations() )
+		m_metricsReport.AddValue( "receive allocations", (double) m_numReceiveAllocations );
+
+	m_metricsReport.AddSummary( "receive queue bytes", m_receiveQueueBytes, 1.0 );
+	m_receiveQueueBytes.Reset();
+
+	unsigned int numUDPReceiveErrors = 0;
+	if( m_hasUDPReceiveErrors && m_server.GetUDPReceiveErrors( numUDPReceiveErrors ) )
+	{
+		m_metricsReport.AddValue( "udp receive errors", (double) ( numUDPReceiveErrors - m_lastUDPReceiveErrors ) );
+		m_lastUDPReceiveErrors = numUDPReceiveErrors;
+	}
+
+	std::map< int, GameServer* >::iterator gameIter;
+	for( gameIter = m_games.begin(); gameIter != m_games.end(); ++gameIter )
+	{
+		GameServer* game = gameIter->second;
+		const TickStats& tickStats = m_gameScheduler.GetTickStats( gameIter->first );
+
+		m_metricsReport.BeginLine( "game " + ConvertNumberToString( gameIter->first ) );
+		m_metricsReport.AddValue( "players", (double) game->GetNumberOfPlayers() );
+		m_metricsReport.AddValue( "ticks per second", 1.0 / game->GetSecondsPerTick() );
+		m_metricsReport.AddValue( "ticks", (double) tickStats.m_numTicks );
+		m_metricsReport.AddSummary( "jitter ms", tickStats.m_jitterSeconds, 1000.0 );
+		m_metricsReport.AddSummary( "tick ms", tickStats.m_tickSeconds, 1000.0 );
+		m_metricsReport.AddValue( "merged", (double) tickStats.m_numMergedTicks );
+		m_metricsReport.AddValue( "skipped", (double) tickStats.m_numSkippedTicks );
+		m_metricsReport.AddValue( "overruns", (double) tickStats.m_numOverruns );
+		m_metricsReport.AddValue( "dropped packets", (double) game->GetNumberOfDroppedPackets() );
+		m_metricsReport.AddValue( "rate limited packets", (double) game->GetNumberOfRateLimitedPackets() );
+		m_metricsReport.AddValue( "piggybacked acks", (double) game->GetNumberOfPiggybackedAcks() );
+		m_metricsReport.AddValue( "standalone acks", (double) game->GetNumberOfStandaloneAcks() );
+		m_metricsReport.AddValue( "redundant states", (double) game->GetNumberOfPreviousStatesReceived() );
+		m_metricsReport.AddValue( "redundant bytes", (double) ( game->GetNumberOfPreviousStatesReceived() * sizeof( PreviousStateGame ) ) );
+		m_metricsReport.AddValue( "recovered states", (double) game->GetNumberOfRecoveredStates() );
+		m_metricsReport.AddValue( "sessions using parity", (double) game->GetNumberOfSessionsUsingParity() );
+		m_metricsReport.AddValue( "parity packets", (double) game->GetNumberOfParityPacketsSent() );
+		AddSendStatsToReport( game->GetSendStats() );
+		m_metricsReport.AddValue( "abandoned messages", (double) game->GetNumberOfAbandonedMessages() );
+		if( IsCountingAllocations() )
+			m_metricsReport.AddValue( "receive allocations", (double) game->GetNumberOfReceiveAllocations() );
+
+		m_metricsReport.AddSummary( "receive queue bytes", game->GetReceiveQueueBytes(), 1.0 );
+		game->ResetReceiveQueueBytes();
+	}
+
+	m_metricsReport.PrintReport();
+	m_gameScheduler.ResetTickStats();
+
+	m_timers.AddTimer( MakeTimerID( LOBBY_TIMER_MetricsReport, 0 ), currentTime + GetSecondsBetweenMetricsReports() );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Queue depth is a snapshot, the drop counts are totals since the server started
+void Lobby::AddSendStatsToReport( const UDPSendStats& sendStats )
+{
+	m_metricsReport.AddValue( "queued sends", (double) sendStats.m_numQueuedPackets );
+	m_metricsReport.AddValue( "queued clients", (double) sendStats.m_numQueuedClients );
+	m_metricsReport.AddValue( "unreliable sends dropped", (double) sendStats.m_numDroppedUnreliable );
+	m_metricsReport.AddValue( "reliable sends dropped", (double) sendStats.m_numDroppedReliable );
 }
\ No newline at end of file
@@ -5,44 +5,130 @@
 //-----------------------------------------------------------------------------------------------
 #include <map>
 #include <set>
+#include <algorithm>
 #include "Player.hpp"
 #include "GameServer.hpp"
+#include "TimerWheel.hpp"
+#include "TickScheduler.hpp"
 #include "LobbyPacket.hpp"
+#include "RateLimiter.hpp"
+#include "ConnectionCookies.hpp"
 
 
 //-----------------------------------------------------------------------------------------------
 const double SECONDS_BEFORE_SEND_LOBBY_UPDATE = 5.0;
+const double SECONDS_BEFORE_LOBBY_TIMEOUT_REMOVE = 5.0;
+const float GAME_REQUESTS_PER_SECOND = 0.5f;
+const float GAME_REQUEST_BURST = 2.f;
+const double SECONDS_BETWEEN_LOAD_CHECKS = 1.0;
+const double LOAD_SHEDDING_START_UTILIZATION = 0.8;
+const double LOAD_SHEDDING_STOP_UTILIZATION = 0.5;
+const float REDUCED_GAME_TICKS_PER_SECOND = 5.f;
+const float SECONDS_BEFORE_RETRY_WHEN_BUSY = 5.f;
+const double SECONDS_TO_REMEMBER_GAME_ANSWER = 10.0;
+const double MAX_SECONDS_TO_WAIT_WITH_QUEUED_SENDS = 0.001;
 
 
 //-----------------------------------------------------------------------------------------------
+enum LobbyTimerKind
+{
+	LOBBY_TIMER_Broadcast,
+	LOBBY_TIMER_Presence,
+	LOBBY_TIMER_ResendReliable,
+	LOBBY_TIMER_MetricsReport,
+	LOBBY_TIMER_LoadCheck,
+	LOBBY_TIMER_ForgetGameAnswers,
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct LobbyPresence
+{
+	double			m_lastHeardTime;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//The ack that sent a client to a game, kept after its lobby session is gone. The session's next
+//packet number carries on here so a repeated ack still gets past the client's receive window
+struct GameAnswer
+{
+	PacketType		m_requestType;
+	unsigned short	m_portNumber;
+	SequenceNumber	m_nextSequenceNumber;
+	double			m_expiryTime;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Sheds load when game ticks take up too much of the wall clock: one game at a time drops to a
+//reduced tick rate, fewest players first, and no new games are created until every reduced game
+//has been restored
 class Lobby
 {
 public:
 	void Initalize();
 	void Update();
+	void WaitForNextUpdate();
 
 private:
-	void SendPacketToClient( const LobbyPacket& pkt, const ClientInfo& info, bool requireAck );
+	SequenceNumber SendPacketToClient( const LobbyPacket& pkt, const ClientInfo& info, bool requireAck );
 	void SendPacketToAllClients( const LobbyPacket& pkt, bool requireAck );
+	SequenceNumber GetNextSequenceNumber( const ClientInfo& info );
 	std::string ConvertNumberToString( int number );
 	void UpdateGames();
 	void GetPackets();
-	void SendLobbyUpdates();
+	RateClass GetRateClassForPacketType( PacketType packetType ) const;
+	void SendLobbyUpdates( double currentTime );
+	void AddOrRefreshLobbyPlayer( const ClientInfo& info );
+	void RefreshLobbyPlayer( const ClientInfo& info );
 	void RemovePlayerFromLobby( const ClientInfo& info );
+	void ProcessExpiredTimers();
+	void RemoveTimedOutLobbyPlayer( unsigned short sessionID, double currentTime );
+	void ProcessConnectRequest( const LobbyPacket& connectPacket, const ClientInfo& info );
 	void AcknowledgeConnection( const LobbyPacket& packet, const ClientInfo& info );
 	void ProcessAckPackets( const LobbyPacket& ackPacket, const ClientInfo& info );
 	void CreateGame( const LobbyPacket& createPacket, const ClientInfo& gameOwner );
+	void SendBusyResponse( const LobbyPacket& requestPacket, const ClientInfo& info );
+	void CheckLoad( double currentTime );
+	void ReduceGameTickRate();
+	void RestoreGameTickRate();
 	void AddPlayersToLobby( const GameServer* game );
 	void AddPlayerToGame( const LobbyPacket& joinPacket, const ClientInfo& info );
-	void ResendAckPackets();
+	void RememberGameAnswer( const LobbyPacket& ackPacket, const ClientInfo& info );
+	void AnswerRepeatedGameRequest( const LobbyPacket& requestPacket, const ClientInfo& info, const GameAnswer& answer );
+	void ForgetExpiredGameAnswers( double currentTime );
+	void ArmResendTimer( unsigned short sessionID, double resendTime );
+	void ResendAckPackets( unsigned short sessionID, double currentTime );
+	void ReportMetrics( double currentTime );
+	void AddSendStatsToReport( const UDPSendStats& sendStats );
 
 	UDPServer											m_server;
-	unsigned int										m_nextPacketNumber;
+	SessionTable										m_sessions;
+	ConnectionCookies									m_cookies;
+	RateLimiter											m_rateLimiter;
+	ReceiveBatch< LobbyPacket >							m_receiveBatch;
 	unsigned int										m_nextGameID;
 	unsigned short										m_nextPortNumber;
-	double												m_lastUpdateTime;
-	std::set< ClientInfo >								m_lobbyPlayers;
+	std::map< ClientInfo, LobbyPresence >				m_lobbyPlayers;
+	TimerWheel											m_timers;
+	std::vector< unsigned int >							m_expiredTimerIDs;
 	std::map< int, GameServer* >						m_games;
+	TickScheduler										m_gameScheduler;
+	MetricsReport										m_metricsReport;
+	double												m_tickBusySeconds;
+	double												m_lastLoadCheckTime;
+	double												m_tickUtilization;
+	bool												m_isSheddingLoad;
+	std::vector< int >									m_reducedGameIDs;
+	unsigned int										m_numBusyResponses;
+	unsigned int										m_numReceiveAllocations;
+	std::map< ClientInfo, GameAnswer >					m_gameAnswers;
+	bool												m_hasForgetGameAnswersTimer;
+	unsigned int										m_numRepeatedGameAnswers;
+	MetricSummary										m_receiveQueueBytes;
+	bool												m_hasUDPReceiveErrors;
+	unsigned int										m_lastUDPReceiveErrors;
 	std::map< ClientInfo, std::vector< LobbyPacket > >	m_sendPacketsPerClient;
 };
 
@@ -2,12 +2,19 @@
 #define include_LobbyPacket
 #pragma once
 
+//-----------------------------------------------------------------------------------------------
+#include "SequenceNumber.hpp"
+
+
 //-----------------------------------------------------------------------------------------------
 typedef unsigned char PacketType;
 static const PacketType LOBBY_TYPE_Acknowledge = 20;
 static const PacketType LOBBY_TYPE_Update = 21;
 static const PacketType LOBBY_TYPE_CreateGame = 22;
 static const PacketType LOBBY_TYPE_JoinGame = 23;
+static const PacketType LOBBY_TYPE_Heartbeat = 24;
+static const PacketType LOBBY_TYPE_Challenge = 25;
+static const PacketType LOBBY_TYPE_Busy = 26;
 
 
 //-----------------------------------------------------------------------------------------------
@@ -15,7 +22,8 @@ struct AckPacketLobby
 {
 	PacketType packetType;
 	unsigned short portNumber;
-	unsigned int packetNumber;
+	SequenceNumber packetNumber;
+	unsigned long long cookie;
 };
 
 
@@ -35,19 +43,44 @@ struct JoinGamePacketLobby
 };
 
 
+//-----------------------------------------------------------------------------------------------
+//Sent by the server with a fresh cookie, and echoed back by the client on heartbeats
+struct ChallengePacketLobby
+{
+	unsigned long long cookie;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Refuses a request while the server is overloaded. It settles the request like an ack does, so
+//the client waits out the retry time instead of resending
+struct BusyPacketLobby
+{
+	PacketType packetType;
+	SequenceNumber packetNumber;
+	float retryAfterSeconds;
+};
+
+
 //-----------------------------------------------------------------------------------------------
 struct LobbyPacket
 {
 	bool operator<( const LobbyPacket& other ) const;
 
 	PacketType packetType;
-	unsigned int packetNumber;
+	SequenceNumber packetNumber;
 	double timestamp;
+	//Newest timestamp the sender has from the receiver, and how long it held it before sending
+	//this one. Zero until it has heard anything. Lets each side estimate the other's clock
+	double echoTimestamp;
+	float echoHoldSeconds;
 	union PacketData
 	{
 		AckPacketLobby acknowledged;
 		UpdatePacketLobby update;
 		JoinGamePacketLobby join;
+		ChallengePacketLobby challenge;
+		BusyPacketLobby busy;
 	} data;
 };
 
@@ -55,7 +88,7 @@ struct LobbyPacket
 //-----------------------------------------------------------------------------------------------
 inline bool LobbyPacket::operator<( const LobbyPacket& other ) const
 {
-	return this->packetNumber < other.packetNumber;
+	return IsSequenceMoreRecent( other.packetNumber, this->packetNumber );
 }
 
 
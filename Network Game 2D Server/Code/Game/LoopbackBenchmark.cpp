@@ -0,0 +1,342 @@
+#include "LoopbackBenchmark.hpp"
+#include <vector>
+#include <string.h>
+#include <iostream>
+#include <windows.h>
+#include <process.h>
+#include "UDPServer.hpp"
+#include "CS6Packet.hpp"
+#include "AllocationCounter.hpp"
+#include "../Engine/Time.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+static const unsigned int NUM_FRAGMENT_BENCHMARK_SIZES = 7;
+static const unsigned int FRAGMENT_BENCHMARK_SIZES[ NUM_FRAGMENT_BENCHMARK_SIZES ] = { 64, 512, 1024, 2048, 4096, 16384, MAX_MESSAGE_BYTES };
+static const unsigned char FRAGMENT_BENCHMARK_FILL_BYTE = 0xbe;
+static const double RECEIVE_BENCHMARK_IDLE_SECONDS = 0.5;
+static const long RECEIVE_BENCHMARK_WAIT_MICROSECONDS = 1000;
+static const unsigned int NUM_OFFLOAD_BENCHMARK_SETTINGS = 4;
+static const unsigned int OFFLOAD_BENCHMARK_SETTINGS[ NUM_OFFLOAD_BENCHMARK_SETTINGS ] = { 0, UDP_OFFLOAD_Send, UDP_OFFLOAD_Receive, UDP_OFFLOAD_Send | UDP_OFFLOAD_Receive };
+static const char* OFFLOAD_BENCHMARK_NAMES[ NUM_OFFLOAD_BENCHMARK_SETTINGS ] = { "No offload", "Send offload", "Receive offload", "Both offloads" };
+
+
+//-----------------------------------------------------------------------------------------------
+struct ReceiveBenchmarkRun
+{
+	UDPServer*			m_sender;
+	struct sockaddr_in	m_receiverAddr;
+	volatile LONG		m_numPacketsSent;
+	volatile LONG		m_isSending;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//User and kernel time together, since a receive path mostly differs in how long it spends in the
+//kernel
+static double GetThreadCPUSeconds()
+{
+	FILETIME creationTime;
+	FILETIME exitTime;
+	FILETIME kernelTime;
+	FILETIME userTime;
+	if( !GetThreadTimes( GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime ) )
+		return 0.0;
+
+	unsigned long long kernelTicks = ( (unsigned long long) kernelTime.dwHighDateTime << 32 ) | kernelTime.dwLowDateTime;
+	unsigned long long userTicks = ( (unsigned long long) userTime.dwHighDateTime << 32 ) | userTime.dwLowDateTime;
+	return (double) ( kernelTicks + userTicks ) * 0.0000001;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Drains everything that has arrived so far
+static unsigned int ReceiveAllMessages( UDPServer& receiver, std::vector< char >& receiveBuffer )
+{
+	unsigned int numMessages = 0;
+	struct sockaddr_in sourceAddr;
+	int sourceLen = sizeof( sourceAddr );
+	while( receiver.ReceivePacketFromClient( &receiveBuffer[ 0 ], receiveBuffer.size(), sourceAddr, sourceLen ) )
+	{
+		++numMessages;
+		sourceLen = sizeof( sourceAddr );
+	}
+
+	return numMessages;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Sending and receiving take turns on the one thread, so the receiver's buffer never has more
+//than a message's fragments in it and anything lost was lost to the fragment path, not overflow
+static void RunFragmentBenchmarkForSize( UDPServer& sender, UDPServer& receiver, const struct sockaddr_in& receiverAddr, unsigned int messageBytes )
+{
+	//The fill never looks like a fragment header, so a message that fits one datagram goes out whole
+	std::vector< char > message( messageBytes, (char) FRAGMENT_BENCHMARK_FILL_BYTE );
+	std::vector< char > receiveBuffer( MAX_MESSAGE_BYTES );
+
+	unsigned int numSent = 0;
+	unsigned int numReceived = 0;
+	double startTime = GetCurrentTimeSeconds();
+	double endTime = startTime + LOOPBACK_BENCHMARK_SECONDS_PER_RUN;
+	while( GetCurrentTimeSeconds() < endTime )
+	{
+		if( sender.SendPacketToClient( &message[ 0 ], messageBytes, receiverAddr, false ) != UDP_SEND_Dropped )
+			++numSent;
+
+		sender.FlushQueuedPackets();
+		numReceived += ReceiveAllMessages( receiver, receiveBuffer );
+	}
+
+	double elapsedSeconds = GetCurrentTimeSeconds() - startTime;
+
+	//Whatever is still on its way gets a moment to land before the count is taken
+	double drainEndTime = GetCurrentTimeSeconds() + 0.1;
+	while( GetCurrentTimeSeconds() < drainEndTime )
+	{
+		sender.FlushQueuedPackets();
+		numReceived += ReceiveAllMessages( receiver, receiveBuffer );
+	}
+
+	unsigned int numFragments = 1;
+	if( messageBytes > sender.GetMaxDatagramBytes() )
+		numFragments = GetNumberOfFragments( messageBytes, sender.GetMaxDatagramBytes() );
+
+	std::cout << messageBytes << " byte messages, " << numFragments << " datagrams each: " << (unsigned int) ( numReceived / elapsedSeconds ) << " messages per second, "
+		<< (unsigned int) ( numReceived * (double) messageBytes / elapsedSeconds / 1024.0 ) << " KB per second, "
+		<< ( numSent - numReceived ) << " of " << numSent << " lost\n";
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//A packet the socket can't take yet is flushed until it goes, so every packet is sent once
+static void ReceiveBenchmarkSenderEntryFunc( void* data )
+{
+	ReceiveBenchmarkRun* run = static_cast< ReceiveBenchmarkRun* >( data );
+
+	CS6Packet packet;
+	memset( &packet, 0, sizeof( packet ) );
+	packet.packetType = TYPE_Update;
+
+	LONG numPacketsSent = 0;
+	for( unsigned int packetIndex = 0; packetIndex < RECEIVE_BENCHMARK_PACKETS_PER_RUN; ++packetIndex )
+	{
+		packet.packetNumber = (SequenceNumber) packetIndex;
+		if( run->m_sender->SendPacketToClient( (const char*) &packet, sizeof( packet ), run->m_receiverAddr, false ) != UDP_SEND_Dropped )
+			++numPacketsSent;
+
+		while( run->m_sender->HasQueuedPackets( run->m_receiverAddr ) )
+		{
+			Sleep( 0 );
+			run->m_sender->FlushQueuedPackets();
+		}
+	}
+
+	InterlockedExchange( &run->m_numPacketsSent, numPacketsSent );
+	InterlockedExchange( &run->m_isSending, 0 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The receiver waits and drains like a game's receive thread. A run ends once everything sent has
+//arrived, or once the sender is done and nothing more has come for a while
+static void RunReceiveBenchmarkForBackend( const char* backendName, UDPBackend backend )
+{
+	UDPServer sender;
+	UDPServer receiver;
+	SetPreferredUDPBackend( UDP_BACKEND_Sockets );
+	bool isStarted = sender.StartServer( LOOPBACK_BENCHMARK_SENDER_PORT );
+	SetPreferredUDPBackend( backend );
+	isStarted = receiver.StartServer( LOOPBACK_BENCHMARK_RECEIVER_PORT ) && isStarted;
+	if( !isStarted )
+	{
+		std::cout << backendName << ": couldn't open the benchmark's loopback sockets\n";
+		receiver.EndServer();
+		sender.EndServer();
+		return;
+	}
+
+	if( backend == UDP_BACKEND_RegisteredIO && !receiver.IsUsingRegisteredIO() )
+	{
+		std::cout << backendName << ": not available here, skipped\n";
+		receiver.EndServer();
+		sender.EndServer();
+		return;
+	}
+
+	ReceiveBenchmarkRun run;
+	run.m_sender = &sender;
+	memset( &run.m_receiverAddr, 0, sizeof( run.m_receiverAddr ) );
+	run.m_receiverAddr.sin_family = AF_INET;
+	run.m_receiverAddr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	run.m_receiverAddr.sin_port = htons( LOOPBACK_BENCHMARK_RECEIVER_PORT );
+	run.m_numPacketsSent = 0;
+	run.m_isSending = 1;
+
+	CS6Packet packet;
+	struct sockaddr_in sourceAddr;
+	int sourceLen = sizeof( sourceAddr );
+	unsigned int numReceived = 0;
+
+	double startTime = GetCurrentTimeSeconds();
+	double startCPUSeconds = GetThreadCPUSeconds();
+	double lastReceiveTime = startTime;
+	_beginthread( ReceiveBenchmarkSenderEntryFunc, 0, &run );
+	unsigned int numAllocationsBeforeReceive = GetNumberOfThreadAllocations();
+	for( ;; )
+	{
+		if( receiver.WaitForPacketFromClient( RECEIVE_BENCHMARK_WAIT_MICROSECONDS ) )
+		{
+			while( receiver.ReceivePacketFromClient( (char*) &packet, sizeof( packet ), sourceAddr, sourceLen ) )
+			{
+				++numReceived;
+				sourceLen = sizeof( sourceAddr );
+			}
+
+			lastReceiveTime = GetCurrentTimeSeconds();
+		}
+
+		if( run.m_isSending )
+			continue;
+
+		if( numReceived >= (unsigned int) run.m_numPacketsSent || GetCurrentTimeSeconds() - lastReceiveTime > RECEIVE_BENCHMARK_IDLE_SECONDS )
+			break;
+	}
+
+	double elapsedSeconds = lastReceiveTime - startTime;
+	double cpuSeconds = GetThreadCPUSeconds() - startCPUSeconds;
+	unsigned int numAllocations = GetNumberOfThreadAllocations() - numAllocationsBeforeReceive;
+	receiver.EndServer();
+	sender.EndServer();
+
+	if( numReceived == 0 )
+	{
+		std::cout << backendName << ": nothing arrived\n";
+		return;
+	}
+
+	std::cout << backendName << ": " << (unsigned int) ( numReceived / elapsedSeconds ) << " packets per second, "
+		<< ( cpuSeconds * 1000000000.0 / numReceived ) << " CPU ns per packet, "
+		<< ( run.m_numPacketsSent - numReceived ) << " of " << run.m_numPacketsSent << " lost";
+
+	if( IsCountingAllocations() )
+		std::cout << ", " << numAllocations << " allocations while receiving";
+
+	std::cout << "\n";
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RunFragmentBenchmark()
+{
+	InitializeTime();
+
+	UDPServer sender;
+	UDPServer receiver;
+	if( !sender.StartServer( LOOPBACK_BENCHMARK_SENDER_PORT ) || !receiver.StartServer( LOOPBACK_BENCHMARK_RECEIVER_PORT ) )
+	{
+		std::cout << "Couldn't open the benchmark's loopback sockets\n";
+		return;
+	}
+
+	struct sockaddr_in receiverAddr;
+	memset( &receiverAddr, 0, sizeof( receiverAddr ) );
+	receiverAddr.sin_family = AF_INET;
+	receiverAddr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	receiverAddr.sin_port = htons( LOOPBACK_BENCHMARK_RECEIVER_PORT );
+
+	std::cout << "Datagrams of at most " << sender.GetMaxDatagramBytes() << " bytes\n";
+	for( unsigned int sizeIndex = 0; sizeIndex < NUM_FRAGMENT_BENCHMARK_SIZES; ++sizeIndex )
+	{
+		RunFragmentBenchmarkForSize( sender, receiver, receiverAddr, FRAGMENT_BENCHMARK_SIZES[ sizeIndex ] );
+	}
+
+	receiver.EndServer();
+	sender.EndServer();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RunReceiveBenchmark()
+{
+	InitializeTime();
+	InstallAllocationCounter();
+
+	RunReceiveBenchmarkForBackend( "recvfrom", UDP_BACKEND_Sockets );
+	RunReceiveBenchmarkForBackend( "Registered I/O", UDP_BACKEND_RegisteredIO );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Each send is one batch of snapshot-sized packets, the same call SendUpdatesToClients makes
+static void RunOffloadBenchmarkForSetting( const char* settingName, unsigned int offloadFlags )
+{
+	UDPServer sender;
+	UDPServer receiver;
+	SetPreferredUDPOffloads( offloadFlags );
+	bool isStarted = sender.StartServer( LOOPBACK_BENCHMARK_SENDER_PORT );
+	isStarted = receiver.StartServer( LOOPBACK_BENCHMARK_RECEIVER_PORT ) && isStarted;
+	if( !isStarted )
+	{
+		std::cout << settingName << ": couldn't open the benchmark's loopback sockets\n";
+		receiver.EndServer();
+		sender.EndServer();
+		return;
+	}
+
+	unsigned int enabledOffloads = ( sender.GetEnabledOffloads() & UDP_OFFLOAD_Send ) | ( receiver.GetEnabledOffloads() & UDP_OFFLOAD_Receive );
+
+	struct sockaddr_in receiverAddr;
+	memset( &receiverAddr, 0, sizeof( receiverAddr ) );
+	receiverAddr.sin_family = AF_INET;
+	receiverAddr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	receiverAddr.sin_port = htons( LOOPBACK_BENCHMARK_RECEIVER_PORT );
+
+	CS6Packet packet;
+	memset( &packet, 0, sizeof( packet ) );
+	packet.packetType = TYPE_Update;
+
+	std::vector< char > batch( FANOUT_BENCHMARK_PACKETS_PER_SEND * CS6_PACKET_BYTES_WITHOUT_HISTORY );
+	for( unsigned int packetIndex = 0; packetIndex < FANOUT_BENCHMARK_PACKETS_PER_SEND; ++packetIndex )
+	{
+		memcpy( &batch[ packetIndex * CS6_PACKET_BYTES_WITHOUT_HISTORY ], &packet, CS6_PACKET_BYTES_WITHOUT_HISTORY );
+	}
+
+	std::vector< char > receiveBuffer( MAX_MESSAGE_BYTES );
+	unsigned int numSent = 0;
+	unsigned int numReceived = 0;
+	double startTime = GetCurrentTimeSeconds();
+	double endTime = startTime + LOOPBACK_BENCHMARK_SECONDS_PER_RUN;
+	while( GetCurrentTimeSeconds() < endTime )
+	{
+		if( sender.SendPacketsToClient( &batch[ 0 ], CS6_PACKET_BYTES_WITHOUT_HISTORY, FANOUT_BENCHMARK_PACKETS_PER_SEND, receiverAddr ) != UDP_SEND_Dropped )
+			numSent += FANOUT_BENCHMARK_PACKETS_PER_SEND;
+
+		sender.FlushQueuedPackets();
+		numReceived += ReceiveAllMessages( receiver, receiveBuffer );
+	}
+
+	double elapsedSeconds = GetCurrentTimeSeconds() - startTime;
+	numReceived += ReceiveAllMessages( receiver, receiveBuffer );
+	receiver.EndServer();
+	sender.EndServer();
+
+	std::cout << settingName;
+	if( enabledOffloads != offloadFlags )
+		std::cout << " (not all available here, plain calls stood in)";
+
+	std::cout << ": " << (unsigned int) ( numSent / elapsedSeconds ) << " datagrams per second sent, "
+		<< (unsigned int) ( numReceived / elapsedSeconds ) << " received\n";
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RunOffloadBenchmark()
+{
+	InitializeTime();
+
+	for( unsigned int settingIndex = 0; settingIndex < NUM_OFFLOAD_BENCHMARK_SETTINGS; ++settingIndex )
+	{
+		RunOffloadBenchmarkForSetting( OFFLOAD_BENCHMARK_NAMES[ settingIndex ], OFFLOAD_BENCHMARK_SETTINGS[ settingIndex ] );
+	}
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef include_LoopbackBenchmark
+#define include_LoopbackBenchmark
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+const unsigned short LOOPBACK_BENCHMARK_SENDER_PORT = 5900;
+const unsigned short LOOPBACK_BENCHMARK_RECEIVER_PORT = 5901;
+const double LOOPBACK_BENCHMARK_SECONDS_PER_RUN = 1.0;
+const unsigned int RECEIVE_BENCHMARK_PACKETS_PER_RUN = 1 << 18;
+const unsigned int FANOUT_BENCHMARK_PACKETS_PER_SEND = 64;
+
+
+//-----------------------------------------------------------------------------------------------
+//Sends messages from one UDPServer to another over loopback for a second at each of a range of
+//sizes, from well under one datagram to the largest message that can be fragmented, and prints
+//how many whole messages and bytes arrived per second. Sockets are set up the way the game's
+//are, so -mtu and the other socket flags apply
+void RunFragmentBenchmark();
+
+//Blasts game-sized packets from a sender thread at a server receiving the way a game does, once
+//on plain recvfrom and once on registered I/O, and prints how many packets per second each
+//received and how much of the receiving thread's CPU time each packet took. Debug builds also
+//print how many allocations the receiving thread made
+void RunReceiveBenchmark();
+
+//Sends a tick's worth of snapshots to one client at a time, the way a game fans its updates out,
+//with neither offload, each one and both, and prints how many datagrams per second were sent and
+//received under each. Offloads the OS or adapter turn down are reported as such
+void RunOffloadBenchmark();
+
+
+#endif // include_LoopbackBenchmark
\ No newline at end of file
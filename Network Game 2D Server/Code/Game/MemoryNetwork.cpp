@@ -0,0 +1,195 @@
+#include "MemoryNetwork.hpp"
+#include <string.h>
+
+
+//-----------------------------------------------------------------------------------------------
+MemoryNetwork::MemoryNetwork()
+	: m_latencySeconds( 0.0 )
+	, m_lossThreshold( 0 )
+	, m_randomState( 1 )
+	, m_numSentDatagrams( 0 )
+	, m_numDeliveredDatagrams( 0 )
+	, m_numLostDatagrams( 0 )
+	, m_numUndeliverableDatagrams( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void MemoryNetwork::Initialize( double latencySeconds, float lossChance, unsigned int randomSeed )
+{
+	m_endpoints.clear();
+	m_endpointIndexByAddress.clear();
+	m_latencySeconds = latencySeconds;
+	m_lossThreshold = (unsigned int) ( lossChance * 65536.f );
+	m_randomState = randomSeed;
+	m_numSentDatagrams = 0;
+	m_numDeliveredDatagrams = 0;
+	m_numLostDatagrams = 0;
+	m_numUndeliverableDatagrams = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Returns INVALID_ENDPOINT_INDEX if the address is already taken
+unsigned int MemoryNetwork::AddEndpoint( const ClientInfo& address )
+{
+	if( m_endpointIndexByAddress.find( address ) != m_endpointIndexByAddress.end() )
+		return INVALID_ENDPOINT_INDEX;
+
+	unsigned int endpointIndex = m_endpoints.size();
+	m_endpoints.push_back( Endpoint() );
+
+	Endpoint& endpoint = m_endpoints.back();
+	endpoint.m_address = address;
+	endpoint.m_isOpen = true;
+	endpoint.m_nextDatagram = 0;
+
+	m_endpointIndexByAddress[ address ] = endpointIndex;
+	return endpointIndex;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Indices are never reused, so a closed endpoint's slot just stays empty
+void MemoryNetwork::RemoveEndpoint( unsigned int endpointIndex )
+{
+	Endpoint& endpoint = m_endpoints[ endpointIndex ];
+	if( !endpoint.m_isOpen )
+		return;
+
+	endpoint.m_isOpen = false;
+	endpoint.m_datagrams.clear();
+	endpoint.m_payloads.clear();
+	endpoint.m_nextDatagram = 0;
+	m_endpointIndexByAddress.erase( endpoint.m_address );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Like a real socket, a send to nobody or one lost on the way still succeeds
+bool MemoryNetwork::SendDatagram( unsigned int sourceEndpoint, const ClientInfo& destination, const char* datagram, unsigned int datagramBytes, double currentTime )
+{
+	++m_numSentDatagrams;
+
+	std::map< ClientInfo, unsigned int >::const_iterator destinationIter = m_endpointIndexByAddress.find( destination );
+	if( destinationIter == m_endpointIndexByAddress.end() )
+	{
+		++m_numUndeliverableDatagrams;
+		return true;
+	}
+
+	if( ( GetNextRandom() & 0xffff ) < m_lossThreshold )
+	{
+		++m_numLostDatagrams;
+		return true;
+	}
+
+	Endpoint& endpoint = m_endpoints[ destinationIter->second ];
+
+	InFlightDatagram inFlight;
+	inFlight.m_source = m_endpoints[ sourceEndpoint ].m_address;
+	inFlight.m_deliveryTime = currentTime + m_latencySeconds;
+	inFlight.m_payloadOffset = endpoint.m_payloads.size();
+	inFlight.m_numBytes = datagramBytes;
+
+	endpoint.m_datagrams.push_back( inFlight );
+	endpoint.m_payloads.insert( endpoint.m_payloads.end(), datagram, datagram + datagramBytes );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Datagrams bigger than the buffer are cut short, as recvfrom would
+bool MemoryNetwork::ReceiveDatagram( unsigned int endpointIndex, char* out_datagram, unsigned int maxDatagramBytes, unsigned int& out_datagramBytes, ClientInfo& out_source, double currentTime )
+{
+	Endpoint& endpoint = m_endpoints[ endpointIndex ];
+	if( endpoint.m_nextDatagram >= endpoint.m_datagrams.size() )
+		return false;
+
+	const InFlightDatagram& inFlight = endpoint.m_datagrams[ endpoint.m_nextDatagram ];
+	if( inFlight.m_deliveryTime > currentTime )
+		return false;
+
+	out_datagramBytes = inFlight.m_numBytes;
+	if( out_datagramBytes > maxDatagramBytes )
+		out_datagramBytes = maxDatagramBytes;
+
+	if( out_datagramBytes > 0 )
+		memcpy( out_datagram, &endpoint.m_payloads[ inFlight.m_payloadOffset ], out_datagramBytes );
+
+	out_source = inFlight.m_source;
+	++endpoint.m_nextDatagram;
+	++m_numDeliveredDatagrams;
+
+	CompactEndpoint( endpoint );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int MemoryNetwork::GetNumberOfSentDatagrams() const
+{
+	return m_numSentDatagrams;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int MemoryNetwork::GetNumberOfDeliveredDatagrams() const
+{
+	return m_numDeliveredDatagrams;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int MemoryNetwork::GetNumberOfLostDatagrams() const
+{
+	return m_numLostDatagrams;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int MemoryNetwork::GetNumberOfUndeliverableDatagrams() const
+{
+	return m_numUndeliverableDatagrams;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Xorshift, so a run depends on nothing but its seed
+unsigned int MemoryNetwork::GetNextRandom()
+{
+	m_randomState ^= m_randomState << 13;
+	m_randomState ^= m_randomState >> 17;
+	m_randomState ^= m_randomState << 5;
+	return m_randomState;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Read datagrams are dropped all at once when the queue empties, or a chunk at a time once they
+//make up most of it, so the queue never shifts on every read
+void MemoryNetwork::CompactEndpoint( Endpoint& endpoint )
+{
+	if( endpoint.m_nextDatagram == endpoint.m_datagrams.size() )
+	{
+		endpoint.m_datagrams.clear();
+		endpoint.m_payloads.clear();
+		endpoint.m_nextDatagram = 0;
+		return;
+	}
+
+	if( endpoint.m_nextDatagram < MIN_DATAGRAMS_BEFORE_COMPACTING || endpoint.m_nextDatagram * 2 < endpoint.m_datagrams.size() )
+		return;
+
+	unsigned int payloadBytesRead = endpoint.m_datagrams[ endpoint.m_nextDatagram ].m_payloadOffset;
+	endpoint.m_datagrams.erase( endpoint.m_datagrams.begin(), endpoint.m_datagrams.begin() + endpoint.m_nextDatagram );
+	endpoint.m_payloads.erase( endpoint.m_payloads.begin(), endpoint.m_payloads.begin() + payloadBytesRead );
+	endpoint.m_nextDatagram = 0;
+
+	for( unsigned int datagramIndex = 0; datagramIndex < endpoint.m_datagrams.size(); ++datagramIndex )
+	{
+		endpoint.m_datagrams[ datagramIndex ].m_payloadOffset -= payloadBytesRead;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#ifndef include_MemoryNetwork
+#define include_MemoryNetwork
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <map>
+#include <vector>
+#include "ClientInfo.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int INVALID_ENDPOINT_INDEX = 0xffffffff;
+const unsigned int MIN_DATAGRAMS_BEFORE_COMPACTING = 1024;
+
+
+//-----------------------------------------------------------------------------------------------
+//Stands in for the sockets when everything runs in one process. Datagrams are copied into the
+//receiving endpoint's queue and become readable once the current time passes their delivery
+//time. Latency is fixed, so each endpoint's queue stays in delivery order, and losses come from a
+//seeded generator, so the same sends always give the same deliveries
+class MemoryNetwork
+{
+public:
+	MemoryNetwork();
+	void Initialize( double latencySeconds, float lossChance, unsigned int randomSeed );
+	unsigned int AddEndpoint( const ClientInfo& address );
+	void RemoveEndpoint( unsigned int endpointIndex );
+	bool SendDatagram( unsigned int sourceEndpoint, const ClientInfo& destination, const char* datagram, unsigned int datagramBytes, double currentTime );
+	bool ReceiveDatagram( unsigned int endpointIndex, char* out_datagram, unsigned int maxDatagramBytes, unsigned int& out_datagramBytes, ClientInfo& out_source, double currentTime );
+	unsigned int GetNumberOfSentDatagrams() const;
+	unsigned int GetNumberOfDeliveredDatagrams() const;
+	unsigned int GetNumberOfLostDatagrams() const;
+	unsigned int GetNumberOfUndeliverableDatagrams() const;
+
+private:
+	struct InFlightDatagram
+	{
+		ClientInfo		m_source;
+		double			m_deliveryTime;
+		unsigned int	m_payloadOffset;
+		unsigned int	m_numBytes;
+	};
+
+	struct Endpoint
+	{
+		ClientInfo							m_address;
+		bool								m_isOpen;
+		std::vector< InFlightDatagram >		m_datagrams;
+		std::vector< char >					m_payloads;
+		unsigned int						m_nextDatagram;
+	};
+
+	unsigned int GetNextRandom();
+	void CompactEndpoint( Endpoint& endpoint );
+
+	std::vector< Endpoint >					m_endpoints;
+	std::map< ClientInfo, unsigned int >	m_endpointIndexByAddress;
+	double									m_latencySeconds;
+	unsigned int							m_lossThreshold;
+	unsigned int							m_randomState;
+	unsigned int							m_numSentDatagrams;
+	unsigned int							m_numDeliveredDatagrams;
+	unsigned int							m_numLostDatagrams;
+	unsigned int							m_numUndeliverableDatagrams;
+};
+
+
+#endif // include_MemoryNetwork
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "Metrics.hpp"
+#include <iostream>
+
+
+//-----------------------------------------------------------------------------------------------
+static double g_secondsBetweenMetricsReports = DEFAULT_SECONDS_BETWEEN_METRICS_REPORTS;
+
+
+//-----------------------------------------------------------------------------------------------
+//Zero turns reports off. Only affects servers started afterwards
+void SetSecondsBetweenMetricsReports( double seconds )
+{
+	g_secondsBetweenMetricsReports = seconds;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double GetSecondsBetweenMetricsReports()
+{
+	return g_secondsBetweenMetricsReports;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void MetricSummary::Reset()
+{
+	m_numSamples = 0;
+	m_total = 0.0;
+	m_maximum = 0.0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void MetricSummary::AddSample( double value )
+{
+	if( m_numSamples == 0 || value > m_maximum )
+		m_maximum = value;
+
+	m_total += value;
+	++m_numSamples;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+double MetricSummary::GetMean() const
+{
+	if( m_numSamples == 0 )
+		return 0.0;
+
+	return m_total / (double) m_numSamples;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void MetricsReport::BeginReport( double currentTime )
+{
+	m_text.str( "" );
+	m_text << "Metrics at " << currentTime << "s";
+	m_isLineEmpty = true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void MetricsReport::BeginLine( const std::string& scope )
+{
+	m_text << "\n  " << scope << ":";
+	m_isLineEmpty = true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void MetricsReport::AddValue( const char* name, double value )
+{
+	m_text << ( m_isLineEmpty ? " " : ", " ) << name << " " << value;
+	m_isLineEmpty = false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Scale converts the summary's units for display, such as 1000 to show seconds as milliseconds
+void MetricsReport::AddSummary( const char* name, const MetricSummary& summary, double scale )
+{
+	m_text << ( m_isLineEmpty ? " " : ", " ) << name << " mean " << summary.GetMean() * scale << " max " << summary.m_maximum * scale;
+	m_isLineEmpty = false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void MetricsReport::PrintReport()
+{
+	m_text << "\n";
+	std::cout << m_text.str();
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef include_Metrics
+#define include_Metrics
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <string>
+#include <sstream>
+
+
+//-----------------------------------------------------------------------------------------------
+const double DEFAULT_SECONDS_BETWEEN_METRICS_REPORTS = 10.0;
+
+
+//-----------------------------------------------------------------------------------------------
+void SetSecondsBetweenMetricsReports( double seconds );
+double GetSecondsBetweenMetricsReports();
+
+
+//-----------------------------------------------------------------------------------------------
+//Running count, mean and maximum of one measured quantity over a report interval
+struct MetricSummary
+{
+	MetricSummary() { Reset(); }
+	void Reset();
+	void AddSample( double value );
+	double GetMean() const;
+
+	unsigned int	m_numSamples;
+	double			m_total;
+	double			m_maximum;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//One report's lines, built up and then written to the console together. Each line is one scope,
+//such as the lobby or a single game, followed by its named values
+class MetricsReport
+{
+public:
+	void BeginReport( double currentTime );
+	void BeginLine( const std::string& scope );
+	void AddValue( const char* name, double value );
+	void AddSummary( const char* name, const MetricSummary& summary, double scale );
+	void PrintReport();
+
+private:
+	std::ostringstream	m_text;
+	bool				m_isLineEmpty;
+};
+
+
+#endif // include_Metrics
\ No newline at end of file
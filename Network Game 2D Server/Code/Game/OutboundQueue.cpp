@@ -0,0 +1,112 @@
+#include "OutboundQueue.hpp"
+#include <string.h>
+
+
+//-----------------------------------------------------------------------------------------------
+OutboundQueue::OutboundQueue()
+	: m_firstPacket( 0 )
+	, m_numPackets( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void OutboundQueue::Initialize( const struct sockaddr_in& destinationAddr )
+{
+	m_packets.resize( OUTBOUND_QUEUE_CAPACITY );
+	m_firstPacket = 0;
+	m_numPackets = 0;
+	m_destinationAddr = destinationAddr;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const struct sockaddr_in& OutboundQueue::GetDestination() const
+{
+	return m_destinationAddr;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Returns false if the queue is full or the packet is too big to hold
+bool OutboundQueue::PushPacket( const char* packet, unsigned int packetBytes, bool isReliable )
+{
+	if( IsFull() || packetBytes > MAX_QUEUED_PACKET_BYTES )
+		return false;
+
+	QueuedPacket& queuedPacket = m_packets[ ( m_firstPacket + m_numPackets ) % OUTBOUND_QUEUE_CAPACITY ];
+	queuedPacket.m_numBytes = packetBytes;
+	queuedPacket.m_isReliable = isReliable;
+	memcpy( queuedPacket.m_bytes, packet, packetBytes );
+	++m_numPackets;
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const char* OutboundQueue::PeekPacket( unsigned int& out_packetBytes ) const
+{
+	if( IsEmpty() )
+		return nullptr;
+
+	const QueuedPacket& queuedPacket = m_packets[ m_firstPacket ];
+	out_packetBytes = queuedPacket.m_numBytes;
+	return queuedPacket.m_bytes;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void OutboundQueue::PopPacket()
+{
+	if( IsEmpty() )
+		return;
+
+	m_firstPacket = ( m_firstPacket + 1 ) % OUTBOUND_QUEUE_CAPACITY;
+	--m_numPackets;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Closes the gap by shifting everything queued before it up one place, so the order of the rest
+//is kept. Returns false if every queued packet is reliable
+bool OutboundQueue::RemoveOldestUnreliablePacket()
+{
+	for( unsigned int queueIndex = 0; queueIndex < m_numPackets; ++queueIndex )
+	{
+		if( m_packets[ ( m_firstPacket + queueIndex ) % OUTBOUND_QUEUE_CAPACITY ].m_isReliable )
+			continue;
+
+		for( unsigned int shiftIndex = queueIndex; shiftIndex > 0; --shiftIndex )
+		{
+			m_packets[ ( m_firstPacket + shiftIndex ) % OUTBOUND_QUEUE_CAPACITY ] = m_packets[ ( m_firstPacket + shiftIndex - 1 ) % OUTBOUND_QUEUE_CAPACITY ];
+		}
+
+		PopPacket();
+		return true;
+	}
+
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool OutboundQueue::IsFull() const
+{
+	return m_numPackets >= m_packets.size();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool OutboundQueue::IsEmpty() const
+{
+	return m_numPackets == 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int OutboundQueue::GetNumberOfPackets() const
+{
+	return m_numPackets;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef include_OutboundQueue
+#define include_OutboundQueue
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <vector>
+#include <WinSock2.h>
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int OUTBOUND_QUEUE_CAPACITY = 64;
+const unsigned int MAX_QUEUED_PACKET_BYTES = 256;
+
+
+//-----------------------------------------------------------------------------------------------
+//Packets for one client that found the socket's send buffer full, held oldest first until there
+//is room again. Storage is only allocated once a client actually backs up
+class OutboundQueue
+{
+public:
+	OutboundQueue();
+	void Initialize( const struct sockaddr_in& destinationAddr );
+	const struct sockaddr_in& GetDestination() const;
+	bool PushPacket( const char* packet, unsigned int packetBytes, bool isReliable );
+	const char* PeekPacket( unsigned int& out_packetBytes ) const;
+	void PopPacket();
+	bool RemoveOldestUnreliablePacket();
+	bool IsFull() const;
+	bool IsEmpty() const;
+	unsigned int GetNumberOfPackets() const;
+
+private:
+	struct QueuedPacket
+	{
+		unsigned int	m_numBytes;
+		bool			m_isReliable;
+		char			m_bytes[ MAX_QUEUED_PACKET_BYTES ];
+	};
+
+	std::vector< QueuedPacket >		m_packets;
+	unsigned int					m_firstPacket;
+	unsigned int					m_numPackets;
+	struct sockaddr_in				m_destinationAddr;
+};
+
+
+#endif // include_OutboundQueue
\ No newline at end of file
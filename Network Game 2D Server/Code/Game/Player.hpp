@@ -4,17 +4,29 @@
 
 //-----------------------------------------------------------------------------------------------
 #include "Color3b.hpp"
+#include "ClientInfo.hpp"
+#include "ParityGroup.hpp"
 #include "../Engine/Vector2.hpp"
 
 
 //-----------------------------------------------------------------------------------------------
 struct Player
 {
+	ClientInfo		m_info;
+	unsigned short	m_sessionID;
+	unsigned short	m_playerID;
 	Color3b			m_color;
 	Vector2			m_position;
 	Vector2			m_velocity;
 	float			m_orientationDegrees;
 	double			m_lastUpdateTime;
+	double			m_stateTime;
+	double			m_lastStateTimestamp;
+	unsigned int	m_numPacketsExpected;
+	unsigned int	m_numPacketsReceived;
+	float			m_lossRate;
+	bool			m_isParityEnabled;
+	ParityEncoder	m_parityEncoder;
 };
 
 
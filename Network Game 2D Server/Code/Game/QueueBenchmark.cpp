@@ -0,0 +1,225 @@
+#include "QueueBenchmark.hpp"
+#include <string.h>
+#include <iostream>
+#include <process.h>
+#include "GameServer.hpp"
+#include "../Engine/Time.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+//As big as a received packet, so each push copies as much as a receive thread's does
+struct BenchmarkElement
+{
+	unsigned int	m_sequence;
+	char			m_payload[ sizeof( InboundPacket ) ];
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//The same ring as SPSCQueue, with every index read and write made under one critical section
+template< typename T_ElementType, unsigned int T_Capacity >
+class LockedQueue
+{
+public:
+	LockedQueue();
+	~LockedQueue();
+	T_ElementType* GetNextElementToFill();
+	void PushElement();
+	const T_ElementType* PeekElement();
+	void PopElement();
+
+private:
+	CRITICAL_SECTION	m_lock;
+	unsigned int		m_pushIndex;
+	unsigned int		m_popIndex;
+	T_ElementType		m_elements[ T_Capacity ];
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_ElementType, unsigned int T_Capacity >
+LockedQueue< T_ElementType, T_Capacity >::LockedQueue()
+	: m_pushIndex( 0 )
+	, m_popIndex( 0 )
+{
+	InitializeCriticalSection( &m_lock );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_ElementType, unsigned int T_Capacity >
+LockedQueue< T_ElementType, T_Capacity >::~LockedQueue()
+{
+	DeleteCriticalSection( &m_lock );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The consumer never touches a slot that hasn't been pushed, so it can be filled unlocked
+template< typename T_ElementType, unsigned int T_Capacity >
+T_ElementType* LockedQueue< T_ElementType, T_Capacity >::GetNextElementToFill()
+{
+	EnterCriticalSection( &m_lock );
+	bool hasRoom = ( m_pushIndex - m_popIndex < T_Capacity );
+	LeaveCriticalSection( &m_lock );
+
+	if( !hasRoom )
+		return nullptr;
+
+	return &m_elements[ m_pushIndex % T_Capacity ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_ElementType, unsigned int T_Capacity >
+void LockedQueue< T_ElementType, T_Capacity >::PushElement()
+{
+	EnterCriticalSection( &m_lock );
+	++m_pushIndex;
+	LeaveCriticalSection( &m_lock );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The producer never writes to a slot that hasn't been popped, so the element can be read unlocked
+template< typename T_ElementType, unsigned int T_Capacity >
+const T_ElementType* LockedQueue< T_ElementType, T_Capacity >::PeekElement()
+{
+	EnterCriticalSection( &m_lock );
+	bool isEmpty = ( m_pushIndex == m_popIndex );
+	LeaveCriticalSection( &m_lock );
+
+	if( isEmpty )
+		return nullptr;
+
+	return &m_elements[ m_popIndex % T_Capacity ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_ElementType, unsigned int T_Capacity >
+void LockedQueue< T_ElementType, T_Capacity >::PopElement()
+{
+	EnterCriticalSection( &m_lock );
+	++m_popIndex;
+	LeaveCriticalSection( &m_lock );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+typedef SPSCQueue< BenchmarkElement, INBOUND_PACKET_QUEUE_CAPACITY > BenchmarkSPSCQueue;
+typedef LockedQueue< BenchmarkElement, INBOUND_PACKET_QUEUE_CAPACITY > BenchmarkLockedQueue;
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_QueueType >
+struct BenchmarkRun
+{
+	T_QueueType			m_queue;
+	volatile LONG		m_isProducerReady;
+	volatile LONG		m_isProducerRunning;
+	volatile LONG		m_isStarted;
+	volatile LONG		m_numFullQueueRetries;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//The producer waits for the start flag, so it doesn't get a head start on an empty queue
+template< typename T_QueueType >
+void BenchmarkProducerEntryFunc( void* data )
+{
+	BenchmarkRun< T_QueueType >* run = static_cast< BenchmarkRun< T_QueueType >* >( data );
+
+	BenchmarkElement element;
+	memset( &element, 0, sizeof( element ) );
+	InterlockedExchange( &run->m_isProducerReady, 1 );
+
+	while( !run->m_isStarted )
+	{
+		Sleep( 0 );
+	}
+
+	LONG numFullQueueRetries = 0;
+	for( unsigned int pushIndex = 0; pushIndex < QUEUE_BENCHMARK_PUSHES_PER_RUN; ++pushIndex )
+	{
+		BenchmarkElement* slot = run->m_queue.GetNextElementToFill();
+		while( !slot )
+		{
+			++numFullQueueRetries;
+			Sleep( 0 );
+			slot = run->m_queue.GetNextElementToFill();
+		}
+
+		element.m_sequence = pushIndex;
+		*slot = element;
+		run->m_queue.PushElement();
+	}
+
+	InterlockedExchange( &run->m_numFullQueueRetries, numFullQueueRetries );
+	InterlockedExchange( &run->m_isProducerRunning, 0 );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The calling thread is the consumer, and the clock only runs while elements are moving. It gives
+//up its time slice when the queue is empty, so on a single core the producer still gets to run
+template< typename T_QueueType >
+static void RunBenchmark( const char* queueName )
+{
+	BenchmarkRun< T_QueueType >* run = new BenchmarkRun< T_QueueType >();
+	run->m_isProducerReady = 0;
+	run->m_isProducerRunning = 1;
+	run->m_isStarted = 0;
+	run->m_numFullQueueRetries = 0;
+
+	_beginthread( BenchmarkProducerEntryFunc< T_QueueType >, 0, run );
+
+	while( !run->m_isProducerReady )
+	{
+		Sleep( 0 );
+	}
+
+	unsigned int nextSequence = 0;
+	unsigned int numOutOfOrder = 0;
+
+	double startTime = GetCurrentTimeSeconds();
+	InterlockedExchange( &run->m_isStarted, 1 );
+	for( unsigned int elementIndex = 0; elementIndex < QUEUE_BENCHMARK_PUSHES_PER_RUN; )
+	{
+		const BenchmarkElement* element = run->m_queue.PeekElement();
+		if( !element )
+		{
+			Sleep( 0 );
+			continue;
+		}
+
+		if( element->m_sequence != nextSequence )
+			++numOutOfOrder;
+
+		nextSequence = element->m_sequence + 1;
+		run->m_queue.PopElement();
+		++elementIndex;
+	}
+
+	double elapsedSeconds = GetCurrentTimeSeconds() - startTime;
+
+	while( run->m_isProducerRunning )
+	{
+		Sleep( 0 );
+	}
+
+	std::cout << queueName << ": " << (unsigned int) ( QUEUE_BENCHMARK_PUSHES_PER_RUN / elapsedSeconds ) << " elements per second, "
+		<< run->m_numFullQueueRetries << " pushes retried on a full queue, " << numOutOfOrder << " out of order\n";
+
+	delete run;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RunQueueBenchmark()
+{
+	InitializeTime();
+
+	RunBenchmark< BenchmarkSPSCQueue >( "SPSC queue" );
+	RunBenchmark< BenchmarkLockedQueue >( "Locked queue" );
+}
\ No newline at end of file
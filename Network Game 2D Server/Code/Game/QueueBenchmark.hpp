@@ -0,0 +1,17 @@
+#ifndef include_QueueBenchmark
+#define include_QueueBenchmark
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int QUEUE_BENCHMARK_PUSHES_PER_RUN = 1 << 20;
+
+
+//-----------------------------------------------------------------------------------------------
+//Pushes packet-sized elements from one producer thread to one consumer, the way a game's receive
+//thread feeds its tick, once through the SPSCQueue the games receive on and once through the same
+//ring behind a critical section. Prints how many elements each run moved per second, and the
+//consumer checks that they come out in the order they went in
+void RunQueueBenchmark();
+
+
+#endif // include_QueueBenchmark
\ No newline at end of file
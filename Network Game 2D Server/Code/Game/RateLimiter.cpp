@@ -0,0 +1,124 @@
+#include "RateLimiter.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+RateLimiter::RateLimiter()
+	: m_slotMask( 0 )
+	, m_numDroppedPackets( 0 )
+{
+	for( unsigned int classIndex = 0; classIndex < NUM_RATE_CLASSES; ++classIndex )
+	{
+		m_tokensPerSecond[ classIndex ] = 0.f;
+		m_burstTokens[ classIndex ] = 0.f;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RateLimiter::Initialize( unsigned int maxSources )
+{
+	unsigned int numSlots = MAX_RATE_LIMITER_PROBES;
+	while( numSlots < maxSources )
+	{
+		numSlots <<= 1;
+	}
+
+	SourceBuckets emptyBuckets;
+	emptyBuckets.m_ipAddress = 0;
+	emptyBuckets.m_portNumber = 0;
+	emptyBuckets.m_isUsed = false;
+	emptyBuckets.m_lastRefillTime = 0.0;
+	for( unsigned int classIndex = 0; classIndex < NUM_RATE_CLASSES; ++classIndex )
+	{
+		emptyBuckets.m_tokens[ classIndex ] = 0.f;
+	}
+
+	m_buckets.assign( numSlots, emptyBuckets );
+	m_slotMask = numSlots - 1;
+	m_numDroppedPackets = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RateLimiter::SetClassLimit( RateClass rateClass, float tokensPerSecond, float burstTokens )
+{
+	m_tokensPerSecond[ rateClass ] = tokensPerSecond;
+	m_burstTokens[ rateClass ] = burstTokens;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool RateLimiter::AllowPacket( const ClientInfo& source, RateClass rateClass, double currentTime )
+{
+	if( m_buckets.empty() )
+		return true;
+
+	SourceBuckets& buckets = FindOrClaimBuckets( source, currentTime );
+
+	float secondsSinceRefill = (float) ( currentTime - buckets.m_lastRefillTime );
+	if( secondsSinceRefill > 0.f )
+	{
+		for( unsigned int classIndex = 0; classIndex < NUM_RATE_CLASSES; ++classIndex )
+		{
+			buckets.m_tokens[ classIndex ] += secondsSinceRefill * m_tokensPerSecond[ classIndex ];
+			if( buckets.m_tokens[ classIndex ] > m_burstTokens[ classIndex ] )
+				buckets.m_tokens[ classIndex ] = m_burstTokens[ classIndex ];
+		}
+
+		buckets.m_lastRefillTime = currentTime;
+	}
+
+	if( buckets.m_tokens[ rateClass ] < 1.f )
+	{
+		++m_numDroppedPackets;
+		return false;
+	}
+
+	buckets.m_tokens[ rateClass ] -= 1.f;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int RateLimiter::GetNumberOfDroppedPackets() const
+{
+	return m_numDroppedPackets;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+RateLimiter::SourceBuckets& RateLimiter::FindOrClaimBuckets( const ClientInfo& source, double currentTime )
+{
+	unsigned int homeSlot = HashClientInfo( source ) & m_slotMask;
+	unsigned int claimSlot = homeSlot;
+
+	for( unsigned int probeIndex = 0; probeIndex < MAX_RATE_LIMITER_PROBES; ++probeIndex )
+	{
+		unsigned int slotIndex = ( homeSlot + probeIndex ) & m_slotMask;
+		SourceBuckets& buckets = m_buckets[ slotIndex ];
+		if( !buckets.m_isUsed )
+		{
+			claimSlot = slotIndex;
+			break;
+		}
+
+		if( buckets.m_ipAddress == source.m_ipAddress && buckets.m_portNumber == source.m_portNumber )
+			return buckets;
+
+		if( buckets.m_lastRefillTime < m_buckets[ claimSlot ].m_lastRefillTime )
+			claimSlot = slotIndex;
+	}
+
+	//New sources start with full buckets, as if they had been idle forever
+	SourceBuckets& buckets = m_buckets[ claimSlot ];
+	buckets.m_ipAddress = source.m_ipAddress;
+	buckets.m_portNumber = source.m_portNumber;
+	buckets.m_isUsed = true;
+	buckets.m_lastRefillTime = currentTime;
+	for( unsigned int classIndex = 0; classIndex < NUM_RATE_CLASSES; ++classIndex )
+	{
+		buckets.m_tokens[ classIndex ] = m_burstTokens[ classIndex ];
+	}
+
+	return buckets;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef include_RateLimiter
+#define include_RateLimiter
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <vector>
+#include "ClientInfo.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int MAX_RATE_LIMITED_SOURCES = 4096;
+const unsigned int MAX_RATE_LIMITER_PROBES = 8;
+
+
+//-----------------------------------------------------------------------------------------------
+enum RateClass
+{
+	RATE_CLASS_Default,
+	RATE_CLASS_Expensive,
+	NUM_RATE_CLASSES,
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Token buckets per source address and packet class. Buckets live in a fixed open-addressed table
+//and are only refilled when their source sends again, so a check is one probe and a few multiplies.
+//When a probe run is full the least recently heard source in it gives up its slot
+class RateLimiter
+{
+public:
+	RateLimiter();
+	void Initialize( unsigned int maxSources );
+	void SetClassLimit( RateClass rateClass, float tokensPerSecond, float burstTokens );
+	bool AllowPacket( const ClientInfo& source, RateClass rateClass, double currentTime );
+	unsigned int GetNumberOfDroppedPackets() const;
+
+private:
+	struct SourceBuckets
+	{
+		unsigned long	m_ipAddress;
+		unsigned short	m_portNumber;
+		bool			m_isUsed;
+		float			m_tokens[ NUM_RATE_CLASSES ];
+		double			m_lastRefillTime;
+	};
+
+	SourceBuckets& FindOrClaimBuckets( const ClientInfo& source, double currentTime );
+
+	std::vector< SourceBuckets >	m_buckets;
+	unsigned int					m_slotMask;
+	float							m_tokensPerSecond[ NUM_RATE_CLASSES ];
+	float							m_burstTokens[ NUM_RATE_CLASSES ];
+	unsigned int					m_numDroppedPackets;
+};
+
+
+#endif // include_RateLimiter
\ No newline at end of file
@@ -0,0 +1,171 @@
+#ifndef include_ReceiveBatch
+#define include_ReceiveBatch
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "ClientInfo.hpp"
+#include "SequenceNumber.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int MAX_PACKETS_PER_RECEIVE_BATCH = 256;
+
+
+//-----------------------------------------------------------------------------------------------
+//Fixed-size buffer that one poll of the socket drains into, each packet with the time it arrived.
+//Packets are ordered through an index array, so a poll never allocates or moves a packet
+template< typename T_PacketType >
+class ReceiveBatch
+{
+public:
+	ReceiveBatch();
+	void Clear();
+	T_PacketType* GetNextPacketToFill();
+	void CommitPacket( const ClientInfo& source, unsigned short sessionID, double arrivalTimeSeconds );
+	void SortPacketsWithinSessions();
+	unsigned int GetNumberOfPackets() const;
+	const T_PacketType& GetPacket( unsigned int orderIndex ) const;
+	const ClientInfo& GetSource( unsigned int orderIndex ) const;
+	unsigned short GetSessionID( unsigned int orderIndex ) const;
+	double GetArrivalTime( unsigned int orderIndex ) const;
+
+private:
+	struct SessionOrder
+	{
+		SessionOrder( const ReceiveBatch* batch ) : m_batch( batch ) {}
+		bool operator()( unsigned short lhs, unsigned short rhs ) const;
+
+		const ReceiveBatch*		m_batch;
+	};
+
+	T_PacketType	m_packets[ MAX_PACKETS_PER_RECEIVE_BATCH ];
+	ClientInfo		m_sources[ MAX_PACKETS_PER_RECEIVE_BATCH ];
+	unsigned short	m_sessionIDs[ MAX_PACKETS_PER_RECEIVE_BATCH ];
+	double			m_arrivalTimes[ MAX_PACKETS_PER_RECEIVE_BATCH ];
+	unsigned short	m_order[ MAX_PACKETS_PER_RECEIVE_BATCH ];
+	unsigned int	m_numPackets;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+ReceiveBatch< T_PacketType >::ReceiveBatch()
+	: m_numPackets( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+void ReceiveBatch< T_PacketType >::Clear()
+{
+	m_numPackets = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+T_PacketType* ReceiveBatch< T_PacketType >::GetNextPacketToFill()
+{
+	if( m_numPackets >= MAX_PACKETS_PER_RECEIVE_BATCH )
+		return nullptr;
+
+	return &m_packets[ m_numPackets ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+void ReceiveBatch< T_PacketType >::CommitPacket( const ClientInfo& source, unsigned short sessionID, double arrivalTimeSeconds )
+{
+	m_sources[ m_numPackets ] = source;
+	m_sessionIDs[ m_numPackets ] = sessionID;
+	m_arrivalTimes[ m_numPackets ] = arrivalTimeSeconds;
+	m_order[ m_numPackets ] = (unsigned short) m_numPackets;
+	++m_numPackets;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+void ReceiveBatch< T_PacketType >::SortPacketsWithinSessions()
+{
+	//Insertion sort: batches arrive nearly in order, and it stays well behaved even when the
+	//wrapping sequence comparison is not a strict ordering across a whole batch
+	SessionOrder isOrderedBefore( this );
+	for( unsigned int sortIndex = 1; sortIndex < m_numPackets; ++sortIndex )
+	{
+		unsigned short packetIndex = m_order[ sortIndex ];
+		unsigned int insertIndex = sortIndex;
+		while( insertIndex > 0 && isOrderedBefore( packetIndex, m_order[ insertIndex - 1 ] ) )
+		{
+			m_order[ insertIndex ] = m_order[ insertIndex - 1 ];
+			--insertIndex;
+		}
+
+		m_order[ insertIndex ] = packetIndex;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+unsigned int ReceiveBatch< T_PacketType >::GetNumberOfPackets() const
+{
+	return m_numPackets;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+const T_PacketType& ReceiveBatch< T_PacketType >::GetPacket( unsigned int orderIndex ) const
+{
+	return m_packets[ m_order[ orderIndex ] ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+const ClientInfo& ReceiveBatch< T_PacketType >::GetSource( unsigned int orderIndex ) const
+{
+	return m_sources[ m_order[ orderIndex ] ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+unsigned short ReceiveBatch< T_PacketType >::GetSessionID( unsigned int orderIndex ) const
+{
+	return m_sessionIDs[ m_order[ orderIndex ] ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+template< typename T_PacketType >
+double ReceiveBatch< T_PacketType >::GetArrivalTime( unsigned int orderIndex ) const
+{
+	return m_arrivalTimes[ m_order[ orderIndex ] ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Packet numbers are only comparable within one sender, so the batch is grouped by session first
+template< typename T_PacketType >
+bool ReceiveBatch< T_PacketType >::SessionOrder::operator()( unsigned short lhs, unsigned short rhs ) const
+{
+	if( m_batch->m_sessionIDs[ lhs ] != m_batch->m_sessionIDs[ rhs ] )
+		return m_batch->m_sessionIDs[ lhs ] < m_batch->m_sessionIDs[ rhs ];
+
+	//Sources without a session share an id, so keep each address together among them
+	if( !( m_batch->m_sources[ lhs ] == m_batch->m_sources[ rhs ] ) )
+		return m_batch->m_sources[ lhs ] < m_batch->m_sources[ rhs ];
+
+	if( m_batch->m_packets[ lhs ].packetNumber != m_batch->m_packets[ rhs ].packetNumber )
+		return IsSequenceMoreRecent( m_batch->m_packets[ rhs ].packetNumber, m_batch->m_packets[ lhs ].packetNumber );
+
+	return lhs < rhs;
+}
+
+
+#endif // include_ReceiveBatch
\ No newline at end of file
@@ -0,0 +1,312 @@
+#include "RegisteredIO.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+RegisteredIOSocket::RegisteredIOSocket()
+	: m_memory( nullptr )
+	, m_memoryBytes( 0 )
+	, m_maxDatagramBytes( 0 )
+	, m_slotBytes( 0 )
+	, m_addressOffset( 0 )
+	, m_bufferID( RIO_INVALID_BUFFERID )
+	, m_receiveCompletions( RIO_INVALID_CQ )
+	, m_sendCompletions( RIO_INVALID_CQ )
+	, m_requests( RIO_INVALID_RQ )
+	, m_receiveEvent( NULL )
+	, m_numReceiveResults( 0 )
+	, m_nextReceiveResult( 0 )
+	, m_heldReceiveSlot( INVALID_REGISTERED_SLOT )
+	, m_hasDeferredReceives( false )
+	, m_isInitialized( false )
+{
+	memset( &m_rio, 0, sizeof( m_rio ) );
+	InitializeCriticalSection( &m_requestLock );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+RegisteredIOSocket::~RegisteredIOSocket()
+{
+	DeleteCriticalSection( &m_requestLock );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Returns false if registered I/O isn't supported here, leaving the socket free for plain calls
+bool RegisteredIOSocket::Initialize( SOCKET socket, unsigned int maxDatagramBytes )
+{
+	GUID functionTableID = WSAID_MULTIPLE_RIO;
+	DWORD bytesReturned = 0;
+	m_rio.cbSize = sizeof( m_rio );
+	if( WSAIoctl( socket, SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER, &functionTableID, sizeof( functionTableID ), &m_rio, sizeof( m_rio ), &bytesReturned, NULL, NULL ) != 0 )
+		return false;
+
+	//Each slot holds one datagram followed by the address it came from or is going to
+	m_maxDatagramBytes = maxDatagramBytes;
+	m_addressOffset = ( maxDatagramBytes + 15 ) & ~15;
+	m_slotBytes = m_addressOffset + ( ( sizeof( SOCKADDR_INET ) + 15 ) & ~15 );
+	m_memoryBytes = m_slotBytes * ( NUM_REGISTERED_RECEIVE_SLOTS + NUM_REGISTERED_SEND_SLOTS );
+	m_memory = (char*) VirtualAlloc( NULL, m_memoryBytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE );
+	if( !m_memory )
+	{
+		Shutdown();
+		return false;
+	}
+
+	m_bufferID = m_rio.RIORegisterBuffer( m_memory, m_memoryBytes );
+	m_receiveEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
+
+	RIO_NOTIFICATION_COMPLETION receiveNotification;
+	receiveNotification.Type = RIO_EVENT_COMPLETION;
+	receiveNotification.Event.EventHandle = m_receiveEvent;
+	receiveNotification.Event.NotifyReset = TRUE;
+	m_receiveCompletions = m_rio.RIOCreateCompletionQueue( NUM_REGISTERED_RECEIVE_SLOTS, &receiveNotification );
+	m_sendCompletions = m_rio.RIOCreateCompletionQueue( NUM_REGISTERED_SEND_SLOTS, NULL );
+	if( m_bufferID == RIO_INVALID_BUFFERID || m_receiveCompletions == RIO_INVALID_CQ || m_sendCompletions == RIO_INVALID_CQ )
+	{
+		Shutdown();
+		return false;
+	}
+
+	m_requests = m_rio.RIOCreateRequestQueue( socket, NUM_REGISTERED_RECEIVE_SLOTS, 1, NUM_REGISTERED_SEND_SLOTS, 1, m_receiveCompletions, m_sendCompletions, NULL );
+	if( m_requests == RIO_INVALID_RQ )
+	{
+		Shutdown();
+		return false;
+	}
+
+	for( unsigned int slotIndex = 0; slotIndex < NUM_REGISTERED_RECEIVE_SLOTS; ++slotIndex )
+	{
+		if( !PostReceive( slotIndex, RIO_MSG_DEFER ) )
+		{
+			Shutdown();
+			return false;
+		}
+	}
+
+	CommitReceives();
+
+	m_freeSendSlots.clear();
+	m_freeSendSlots.reserve( NUM_REGISTERED_SEND_SLOTS );
+	for( unsigned int sendIndex = 0; sendIndex < NUM_REGISTERED_SEND_SLOTS; ++sendIndex )
+	{
+		m_freeSendSlots.push_back( NUM_REGISTERED_RECEIVE_SLOTS + sendIndex );
+	}
+
+	m_isInitialized = true;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The socket has to be closed first, so nothing is still posted against the queues torn down here
+void RegisteredIOSocket::Shutdown()
+{
+	if( m_receiveCompletions != RIO_INVALID_CQ )
+		m_rio.RIOCloseCompletionQueue( m_receiveCompletions );
+
+	if( m_sendCompletions != RIO_INVALID_CQ )
+		m_rio.RIOCloseCompletionQueue( m_sendCompletions );
+
+	if( m_bufferID != RIO_INVALID_BUFFERID )
+		m_rio.RIODeregisterBuffer( m_bufferID );
+
+	if( m_memory )
+		VirtualFree( m_memory, 0, MEM_RELEASE );
+
+	if( m_receiveEvent )
+		CloseHandle( m_receiveEvent );
+
+	m_memory = nullptr;
+	m_bufferID = RIO_INVALID_BUFFERID;
+	m_receiveCompletions = RIO_INVALID_CQ;
+	m_sendCompletions = RIO_INVALID_CQ;
+	m_requests = RIO_INVALID_RQ;
+	m_receiveEvent = NULL;
+	m_numReceiveResults = 0;
+	m_nextReceiveResult = 0;
+	m_heldReceiveSlot = INVALID_REGISTERED_SLOT;
+	m_hasDeferredReceives = false;
+	m_freeSendSlots.clear();
+	m_isInitialized = false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool RegisteredIOSocket::IsInitialized() const
+{
+	return m_isInitialized;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Returns true once a completed receive is waiting, or false if the timeout runs out first
+bool RegisteredIOSocket::WaitForDatagram( DWORD timeoutMilliseconds )
+{
+	if( m_nextReceiveResult < m_numReceiveResults )
+		return true;
+
+	CommitReceives();
+
+	//Arming the notification fires it straight away if completions are already queued
+	INT notifyResult = m_rio.RIONotify( m_receiveCompletions );
+	if( notifyResult != 0 && notifyResult != WSAEALREADY )
+		return false;
+
+	return WaitForSingleObject( m_receiveEvent, timeoutMilliseconds ) == WAIT_OBJECT_0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Completions are dequeued a batch at a time. The datagram is handed back in place, so its slot
+//stays out of the kernel's hands until the next call, and reposted slots go back in one commit
+//once the batch is used up
+const char* RegisteredIOSocket::ReceiveDatagram( int& out_datagramBytes, struct sockaddr_in& out_sourceAddr )
+{
+	if( m_heldReceiveSlot != INVALID_REGISTERED_SLOT )
+	{
+		PostReceive( m_heldReceiveSlot, RIO_MSG_DEFER );
+		m_heldReceiveSlot = INVALID_REGISTERED_SLOT;
+	}
+
+	for( ;; )
+	{
+		if( m_nextReceiveResult >= m_numReceiveResults )
+		{
+			CommitReceives();
+
+			m_nextReceiveResult = 0;
+			m_numReceiveResults = m_rio.RIODequeueCompletion( m_receiveCompletions, m_receiveResults, NUM_REGISTERED_RECEIVE_SLOTS );
+			if( m_numReceiveResults == 0 || m_numReceiveResults == RIO_CORRUPT_CQ )
+			{
+				m_numReceiveResults = 0;
+				return nullptr;
+			}
+		}
+
+		const RIORESULT& result = m_receiveResults[ m_nextReceiveResult ];
+		++m_nextReceiveResult;
+
+		unsigned int slotIndex = (unsigned int) result.RequestContext;
+		if( result.Status != 0 )
+		{
+			PostReceive( slotIndex, RIO_MSG_DEFER );
+			continue;
+		}
+
+		m_heldReceiveSlot = slotIndex;
+		out_datagramBytes = result.BytesTransferred;
+		out_sourceAddr = GetSlotAddress( slotIndex )->Ipv4;
+		return GetSlotData( slotIndex );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Returns false when the datagram is too big or every send slot is still in flight
+bool RegisteredIOSocket::SendDatagram( const char* datagram, int datagramBytes, const struct sockaddr_in& destinationAddr )
+{
+	if( datagramBytes < 0 || (unsigned int) datagramBytes > m_maxDatagramBytes )
+		return false;
+
+	ReclaimSendSlots();
+	if( m_freeSendSlots.empty() )
+		return false;
+
+	unsigned int slotIndex = m_freeSendSlots.back();
+	m_freeSendSlots.pop_back();
+
+	memcpy( GetSlotData( slotIndex ), datagram, datagramBytes );
+	SOCKADDR_INET* slotAddress = GetSlotAddress( slotIndex );
+	memset( slotAddress, 0, sizeof( *slotAddress ) );
+	slotAddress->Ipv4 = destinationAddr;
+
+	RIO_BUF dataBuffer;
+	dataBuffer.BufferId = m_bufferID;
+	dataBuffer.Offset = slotIndex * m_slotBytes;
+	dataBuffer.Length = datagramBytes;
+
+	RIO_BUF addressBuffer;
+	addressBuffer.BufferId = m_bufferID;
+	addressBuffer.Offset = dataBuffer.Offset + m_addressOffset;
+	addressBuffer.Length = sizeof( SOCKADDR_INET );
+
+	EnterCriticalSection( &m_requestLock );
+	BOOL wasPosted = m_rio.RIOSendEx( m_requests, &dataBuffer, 1, NULL, &addressBuffer, NULL, NULL, 0, (PVOID) (size_t) slotIndex );
+	LeaveCriticalSection( &m_requestLock );
+
+	if( !wasPosted )
+	{
+		m_freeSendSlots.push_back( slotIndex );
+		return false;
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+char* RegisteredIOSocket::GetSlotData( unsigned int slotIndex )
+{
+	return m_memory + slotIndex * m_slotBytes;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+SOCKADDR_INET* RegisteredIOSocket::GetSlotAddress( unsigned int slotIndex )
+{
+	return (SOCKADDR_INET*) ( m_memory + slotIndex * m_slotBytes + m_addressOffset );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The request queue isn't safe to use from two threads at once, so receives and sends share a lock
+bool RegisteredIOSocket::PostReceive( unsigned int slotIndex, DWORD flags )
+{
+	RIO_BUF dataBuffer;
+	dataBuffer.BufferId = m_bufferID;
+	dataBuffer.Offset = slotIndex * m_slotBytes;
+	dataBuffer.Length = m_maxDatagramBytes;
+
+	RIO_BUF addressBuffer;
+	addressBuffer.BufferId = m_bufferID;
+	addressBuffer.Offset = dataBuffer.Offset + m_addressOffset;
+	addressBuffer.Length = sizeof( SOCKADDR_INET );
+
+	EnterCriticalSection( &m_requestLock );
+	BOOL wasPosted = m_rio.RIOReceiveEx( m_requests, &dataBuffer, 1, NULL, &addressBuffer, NULL, NULL, flags, (PVOID) (size_t) slotIndex );
+	LeaveCriticalSection( &m_requestLock );
+
+	if( wasPosted && ( flags & RIO_MSG_DEFER ) != 0 )
+		m_hasDeferredReceives = true;
+
+	return wasPosted != FALSE;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RegisteredIOSocket::CommitReceives()
+{
+	if( !m_hasDeferredReceives )
+		return;
+
+	EnterCriticalSection( &m_requestLock );
+	m_rio.RIOReceiveEx( m_requests, NULL, 0, NULL, NULL, NULL, NULL, RIO_MSG_COMMIT_ONLY, NULL );
+	LeaveCriticalSection( &m_requestLock );
+
+	m_hasDeferredReceives = false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void RegisteredIOSocket::ReclaimSendSlots()
+{
+	ULONG numResults = m_rio.RIODequeueCompletion( m_sendCompletions, m_sendResults, NUM_REGISTERED_SEND_SLOTS );
+	if( numResults == RIO_CORRUPT_CQ )
+		return;
+
+	for( ULONG resultIndex = 0; resultIndex < numResults; ++resultIndex )
+	{
+		m_freeSendSlots.push_back( (unsigned int) m_sendResults[ resultIndex ].RequestContext );
+	}
+}
\ No newline at end of file
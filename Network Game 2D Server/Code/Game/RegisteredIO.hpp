@@ -0,0 +1,66 @@
+#ifndef include_RegisteredIO
+#define include_RegisteredIO
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <vector>
+#include <WinSock2.h>
+#include <MSWSock.h>
+#include <WS2tcpip.h>
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int NUM_REGISTERED_RECEIVE_SLOTS = 256;
+const unsigned int NUM_REGISTERED_SEND_SLOTS = 256;
+const unsigned int INVALID_REGISTERED_SLOT = 0xffffffff;
+
+
+//-----------------------------------------------------------------------------------------------
+//Windows Registered I/O on top of a UDP socket. Every datagram and address buffer lives in one
+//block registered with the kernel up front, receives are kept posted ahead of time, and
+//completions are read back without a system call per packet. The socket must have been created
+//with WSA_FLAG_REGISTERED_IO. Receives and sends may come from different threads, but each
+//direction must stay on one thread
+class RegisteredIOSocket
+{
+public:
+	RegisteredIOSocket();
+	~RegisteredIOSocket();
+	bool Initialize( SOCKET socket, unsigned int maxDatagramBytes );
+	void Shutdown();
+	bool IsInitialized() const;
+	bool WaitForDatagram( DWORD timeoutMilliseconds );
+	const char* ReceiveDatagram( int& out_datagramBytes, struct sockaddr_in& out_sourceAddr );
+	bool SendDatagram( const char* datagram, int datagramBytes, const struct sockaddr_in& destinationAddr );
+
+private:
+	char* GetSlotData( unsigned int slotIndex );
+	SOCKADDR_INET* GetSlotAddress( unsigned int slotIndex );
+	bool PostReceive( unsigned int slotIndex, DWORD flags );
+	void CommitReceives();
+	void ReclaimSendSlots();
+
+	RIO_EXTENSION_FUNCTION_TABLE	m_rio;
+	char*							m_memory;
+	unsigned int					m_memoryBytes;
+	unsigned int					m_maxDatagramBytes;
+	unsigned int					m_slotBytes;
+	unsigned int					m_addressOffset;
+	RIO_BUFFERID					m_bufferID;
+	RIO_CQ							m_receiveCompletions;
+	RIO_CQ							m_sendCompletions;
+	RIO_RQ							m_requests;
+	HANDLE							m_receiveEvent;
+	CRITICAL_SECTION				m_requestLock;
+	RIORESULT						m_receiveResults[ NUM_REGISTERED_RECEIVE_SLOTS ];
+	unsigned int					m_numReceiveResults;
+	unsigned int					m_nextReceiveResult;
+	unsigned int					m_heldReceiveSlot;
+	bool							m_hasDeferredReceives;
+	RIORESULT						m_sendResults[ NUM_REGISTERED_SEND_SLOTS ];
+	std::vector< unsigned int >		m_freeSendSlots;
+	bool							m_isInitialized;
+};
+
+
+#endif // include_RegisteredIO
\ No newline at end of file
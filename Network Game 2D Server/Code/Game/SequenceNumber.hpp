@@ -0,0 +1,80 @@
+#ifndef include_SequenceNumber
+#define include_SequenceNumber
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+typedef unsigned short SequenceNumber;
+const unsigned int SEQUENCE_WINDOW_SIZE = 64;
+
+
+//-----------------------------------------------------------------------------------------------
+//True when lhs comes after rhs, treating the 16 bit space as a circle so the counter can wrap
+inline bool IsSequenceMoreRecent( SequenceNumber lhs, SequenceNumber rhs )
+{
+	return (short) ( lhs - rhs ) > 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Sliding window over the last SEQUENCE_WINDOW_SIZE sequence numbers received from one sender
+struct SequenceWindow
+{
+	SequenceWindow() { Reset(); }
+	void Reset();
+	bool AcceptSequence( SequenceNumber sequenceNumber, bool allowOutOfOrder );
+
+	SequenceNumber		m_mostRecentSequence;
+	unsigned long long	m_receivedBits;
+	bool				m_hasReceivedAny;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+inline void SequenceWindow::Reset()
+{
+	m_mostRecentSequence = 0;
+	m_receivedBits = 0;
+	m_hasReceivedAny = false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Returns false for duplicates, for anything older than the window and, unless allowOutOfOrder
+//is set, for packets that arrive after a newer one already has
+inline bool SequenceWindow::AcceptSequence( SequenceNumber sequenceNumber, bool allowOutOfOrder )
+{
+	if( !m_hasReceivedAny )
+	{
+		m_hasReceivedAny = true;
+		m_mostRecentSequence = sequenceNumber;
+		m_receivedBits = 1;
+		return true;
+	}
+
+	if( IsSequenceMoreRecent( sequenceNumber, m_mostRecentSequence ) )
+	{
+		SequenceNumber distance = (SequenceNumber) ( sequenceNumber - m_mostRecentSequence );
+		if( distance >= SEQUENCE_WINDOW_SIZE )
+			m_receivedBits = 0;
+		else
+			m_receivedBits <<= distance;
+
+		m_receivedBits |= 1;
+		m_mostRecentSequence = sequenceNumber;
+		return true;
+	}
+
+	SequenceNumber age = (SequenceNumber) ( m_mostRecentSequence - sequenceNumber );
+	if( age >= SEQUENCE_WINDOW_SIZE )
+		return false;
+
+	unsigned long long sequenceBit = 1ULL << age;
+	if( ( m_receivedBits & sequenceBit ) != 0 )
+		return false;
+
+	m_receivedBits |= sequenceBit;
+	return allowOutOfOrder;
+}
+
+
+#endif // include_SequenceNumber
\ No newline at end of file
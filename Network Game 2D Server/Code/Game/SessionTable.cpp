@@ -0,0 +1,234 @@
+#include "SessionTable.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+SessionTable::SessionTable()
+	: m_slotMask( 0 )
+	, m_numSessions( 0 )
+	, m_maxSessions( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The table starts at INITIAL_SESSION_CAPACITY and AddSession doubles it up to maxSessions
+void SessionTable::Initialize( unsigned int maxSessions )
+{
+	if( maxSessions >= INVALID_SESSION_ID )
+		maxSessions = INVALID_SESSION_ID - 1;
+
+	m_maxSessions = maxSessions;
+	m_sessions.clear();
+	m_clockSyncs.clear();
+	m_freeSessionIDs.clear();
+	m_slots.clear();
+	m_numSessions = 0;
+
+	Grow( maxSessions < INITIAL_SESSION_CAPACITY ? maxSessions : INITIAL_SESSION_CAPACITY );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned short SessionTable::AddSession( const ClientInfo& info )
+{
+	unsigned int slotIndex = FindSlot( info );
+	if( m_slots[ slotIndex ] != INVALID_SESSION_ID )
+		return m_slots[ slotIndex ];
+
+	if( m_freeSessionIDs.empty() )
+	{
+		if( m_sessions.size() >= m_maxSessions )
+			return INVALID_SESSION_ID;
+
+		unsigned int newCapacity = m_sessions.size() * 2;
+		Grow( newCapacity < m_maxSessions ? newCapacity : m_maxSessions );
+		slotIndex = FindSlot( info );
+	}
+
+	unsigned short sessionID = m_freeSessionIDs.back();
+	m_freeSessionIDs.pop_back();
+
+	Session& session = m_sessions[ sessionID ];
+	session.m_info = info;
+	session.m_isActive = true;
+	session.m_nextSequenceNumber = 0;
+	session.m_receiveWindow.Reset();
+	session.m_hasResendTimer = false;
+	session.m_pendingAckType = 0;
+	++session.m_generation;
+
+	//Ids are handed out lowest first, so this only grows when the table is busier than it has been
+	if( sessionID >= m_clockSyncs.size() )
+		m_clockSyncs.resize( sessionID + 1 );
+
+	m_clockSyncs[ sessionID ].Reset();
+
+	m_slots[ slotIndex ] = sessionID;
+	++m_numSessions;
+
+	return sessionID;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned short SessionTable::FindSession( const ClientInfo& info ) const
+{
+	if( m_slots.empty() )
+		return INVALID_SESSION_ID;
+
+	return m_slots[ FindSlot( info ) ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SessionTable::RemoveSession( const ClientInfo& info )
+{
+	if( m_slots.empty() )
+		return;
+
+	unsigned int slotIndex = FindSlot( info );
+	unsigned short sessionID = m_slots[ slotIndex ];
+	if( sessionID == INVALID_SESSION_ID )
+		return;
+
+	m_sessions[ sessionID ].m_isActive = false;
+	m_freeSessionIDs.push_back( sessionID );
+	m_slots[ slotIndex ] = INVALID_SESSION_ID;
+	--m_numSessions;
+
+	//Shift the rest of the probe run back so later lookups don't stop at the hole
+	unsigned int emptySlot = slotIndex;
+	unsigned int probeSlot = ( slotIndex + 1 ) & m_slotMask;
+	while( m_slots[ probeSlot ] != INVALID_SESSION_ID )
+	{
+		unsigned int homeSlot = GetHomeSlot( m_sessions[ m_slots[ probeSlot ] ].m_info );
+		unsigned int distanceFromHome = ( probeSlot - homeSlot ) & m_slotMask;
+		unsigned int distanceFromEmpty = ( probeSlot - emptySlot ) & m_slotMask;
+		if( distanceFromHome >= distanceFromEmpty )
+		{
+			m_slots[ emptySlot ] = m_slots[ probeSlot ];
+			m_slots[ probeSlot ] = INVALID_SESSION_ID;
+			emptySlot = probeSlot;
+		}
+
+		probeSlot = ( probeSlot + 1 ) & m_slotMask;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+Session& SessionTable::GetSession( unsigned short sessionID )
+{
+	return m_sessions[ sessionID ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+ClockSync& SessionTable::GetClockSync( unsigned short sessionID )
+{
+	return m_clockSyncs[ sessionID ];
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int SessionTable::GetCapacity() const
+{
+	return m_sessions.size();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int SessionTable::GetNumberOfSessions() const
+{
+	return m_numSessions;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Timers outlive the session they were armed for, so the index carries the session's generation
+//and a timer left over from an earlier occupant of the same id is recognised and ignored
+unsigned int SessionTable::GetTimerIndexForSession( unsigned short sessionID ) const
+{
+	return ( (unsigned int) m_sessions[ sessionID ].m_generation << 16 ) | sessionID;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned short SessionTable::GetSessionForTimerIndex( unsigned int timerIndex ) const
+{
+	unsigned short sessionID = (unsigned short) ( timerIndex & 0xffff );
+	if( sessionID >= m_sessions.size() )
+		return INVALID_SESSION_ID;
+
+	const Session& session = m_sessions[ sessionID ];
+	if( !session.m_isActive || session.m_generation != (unsigned char) ( timerIndex >> 16 ) )
+		return INVALID_SESSION_ID;
+
+	return sessionID;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Only called with the free list empty. The new ids go on it so the lowest is handed out first,
+//and the slots are rebuilt from the live sessions whenever they'd be more than half full
+void SessionTable::Grow( unsigned int newCapacity )
+{
+	unsigned int oldCapacity = m_sessions.size();
+
+	Session emptySession;
+	emptySession.m_info.m_ipAddress = 0;
+	emptySession.m_info.m_portNumber = 0;
+	emptySession.m_isActive = false;
+	emptySession.m_nextSequenceNumber = 0;
+	emptySession.m_generation = 0;
+	emptySession.m_hasResendTimer = false;
+	emptySession.m_pendingAckType = 0;
+	emptySession.m_pendingAckNumber = 0;
+
+	m_sessions.resize( newCapacity, emptySession );
+	for( unsigned int sessionID = newCapacity; sessionID > oldCapacity; --sessionID )
+	{
+		m_freeSessionIDs.push_back( (unsigned short) ( sessionID - 1 ) );
+	}
+
+	unsigned int numSlots = 1;
+	while( numSlots < newCapacity * 2 )
+	{
+		numSlots <<= 1;
+	}
+
+	if( numSlots <= m_slots.size() )
+		return;
+
+	m_slots.assign( numSlots, INVALID_SESSION_ID );
+	m_slotMask = numSlots - 1;
+	for( unsigned int sessionID = 0; sessionID < oldCapacity; ++sessionID )
+	{
+		if( m_sessions[ sessionID ].m_isActive )
+			m_slots[ FindSlot( m_sessions[ sessionID ].m_info ) ] = (unsigned short) sessionID;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int SessionTable::GetHomeSlot( const ClientInfo& info ) const
+{
+	return HashClientInfo( info ) & m_slotMask;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int SessionTable::FindSlot( const ClientInfo& info ) const
+{
+	unsigned int slotIndex = GetHomeSlot( info );
+	while( m_slots[ slotIndex ] != INVALID_SESSION_ID )
+	{
+		if( m_sessions[ m_slots[ slotIndex ] ].m_info == info )
+			break;
+
+		slotIndex = ( slotIndex + 1 ) & m_slotMask;
+	}
+
+	return slotIndex;
+}
\ No newline at end of file
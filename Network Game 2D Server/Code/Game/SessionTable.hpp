@@ -0,0 +1,66 @@
+#ifndef include_SessionTable
+#define include_SessionTable
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <vector>
+#include "ClockSync.hpp"
+#include "ClientInfo.hpp"
+#include "SequenceNumber.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned short INVALID_SESSION_ID = 0xffff;
+const unsigned int MAX_SESSIONS_PER_SERVER = 4096;
+const unsigned int INITIAL_SESSION_CAPACITY = 64;
+
+
+//-----------------------------------------------------------------------------------------------
+struct Session
+{
+	ClientInfo		m_info;
+	bool			m_isActive;
+	SequenceNumber	m_nextSequenceNumber;
+	SequenceWindow	m_receiveWindow;
+	unsigned char	m_generation;
+	bool			m_hasResendTimer;
+	unsigned char	m_pendingAckType;
+	SequenceNumber	m_pendingAckNumber;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Maps client addresses to compact session ids. Only AddSession grows storage, doubling the table
+//when it runs out of ids, so lookups from the receive path never touch the heap. Clock samples
+//are kept apart from the table and only grow as far as the highest id handed out
+class SessionTable
+{
+public:
+	SessionTable();
+	void Initialize( unsigned int maxSessions );
+	unsigned short AddSession( const ClientInfo& info );
+	unsigned short FindSession( const ClientInfo& info ) const;
+	void RemoveSession( const ClientInfo& info );
+	Session& GetSession( unsigned short sessionID );
+	ClockSync& GetClockSync( unsigned short sessionID );
+	unsigned int GetCapacity() const;
+	unsigned int GetNumberOfSessions() const;
+	unsigned int GetTimerIndexForSession( unsigned short sessionID ) const;
+	unsigned short GetSessionForTimerIndex( unsigned int timerIndex ) const;
+
+private:
+	void Grow( unsigned int newCapacity );
+	unsigned int GetHomeSlot( const ClientInfo& info ) const;
+	unsigned int FindSlot( const ClientInfo& info ) const;
+
+	std::vector< Session >			m_sessions;
+	std::vector< ClockSync >		m_clockSyncs;
+	std::vector< unsigned short >	m_freeSessionIDs;
+	std::vector< unsigned short >	m_slots;
+	unsigned int					m_slotMask;
+	unsigned int					m_numSessions;
+	unsigned int					m_maxSessions;
+};
+
+
+#endif // include_SessionTable
\ No newline at end of file
@@ -0,0 +1,462 @@
+#include "SimulatedClient.hpp"
+#include <string.h>
+#include <sstream>
+#include "GameServer.hpp"
+#include "Fragmentation.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+SimulatedClient::SimulatedClient()
+	: m_network( nullptr )
+	, m_endpointIndex( INVALID_ENDPOINT_INDEX )
+	, m_isGameOwner( false )
+	, m_state( SIM_CLIENT_ConnectingToLobby )
+	, m_nextPacketNumber( 0 )
+	, m_cookie( 0 )
+	, m_gameID( 0 )
+	, m_hasFoundGame( false )
+	, m_playerID( INVALID_PLAYER_ID )
+	, m_orientationDegrees( 0.f )
+	, m_lastMoveTime( 0.0 )
+	, m_nextRequestTime( 0.0 )
+	, m_nextHeartbeatTime( 0.0 )
+	, m_nextUpdateTime( 0.0 )
+	, m_leaveTime( 0.0 )
+	, m_randomState( 1 )
+	, m_numUpdatesReceived( 0 )
+	, m_numResetsReceived( 0 )
+	, m_numRebuiltPackets( 0 )
+	, m_hasSeenGameOver( false )
+	, m_stateHash( 2166136261u )
+	, m_pendingAckType( TYPE_None )
+	, m_pendingAckNumber( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The owner's name is built the same way the lobby builds it, so the listing can be matched
+void SimulatedClient::Initialize( MemoryNetwork* network, const ClientInfo& address, const ClientInfo& gameOwner, double leaveTime, unsigned int randomSeed )
+{
+	m_network = network;
+	m_address = address;
+	m_endpointIndex = m_network->AddEndpoint( address );
+
+	m_lobbyAddress.m_ipAddress = htonl( INADDR_LOOPBACK );
+	m_lobbyAddress.m_portNumber = htons( PORT_NUMBER );
+	m_gameAddress = m_lobbyAddress;
+
+	std::ostringstream ownerName;
+	ownerName << gameOwner.GetIPAddressString() << ":" << gameOwner.m_portNumber;
+	m_gameOwnerName = ownerName.str();
+	m_isGameOwner = ( gameOwner == address );
+
+	m_leaveTime = leaveTime;
+	m_randomState = randomSeed != 0 ? randomSeed : 1;
+	m_updateScheduler.Initialize( (float) MAP_SIZE_WIDTH, (float) MAP_SIZE_HEIGHT );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SimulatedClient::Update( double currentTime )
+{
+	if( m_state == SIM_CLIENT_Left )
+		return;
+
+	if( currentTime >= m_leaveTime )
+	{
+		m_state = SIM_CLIENT_Left;
+		return;
+	}
+
+	ReceivePackets( currentTime );
+
+	if( m_state == SIM_CLIENT_InGame )
+	{
+		SendGameUpdate( currentTime );
+		SendPendingAck( currentTime );
+	}
+	else if( m_state != SIM_CLIENT_Left )
+		SendLobbyRequests( currentTime );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+SimulatedClientState SimulatedClient::GetState() const
+{
+	return m_state;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int SimulatedClient::GetNumberOfUpdatesReceived() const
+{
+	return m_numUpdatesReceived;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int SimulatedClient::GetNumberOfResetsReceived() const
+{
+	return m_numResetsReceived;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int SimulatedClient::GetNumberOfRebuiltPackets() const
+{
+	return m_numRebuiltPackets;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool SimulatedClient::HasSeenGameOver() const
+{
+	return m_hasSeenGameOver;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Folds in everything the client was told, so two runs only match if every delivery matched
+unsigned int SimulatedClient::GetStateHash() const
+{
+	return m_stateHash;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Anything not from the lobby's port is from a game. The game's first reset can beat the lobby's
+//reply, so either one moves the client into the game
+void SimulatedClient::ReceivePackets( double currentTime )
+{
+	unsigned int datagramBytes = 0;
+	ClientInfo source;
+	while( m_network->ReceiveDatagram( m_endpointIndex, m_receiveBuffer, sizeof( m_receiveBuffer ), datagramBytes, source, currentTime ) )
+	{
+		if( datagramBytes == 0 || (unsigned char) m_receiveBuffer[ 0 ] == FRAGMENT_PACKET_TYPE )
+			continue;
+
+		if( source == m_lobbyAddress )
+		{
+			LobbyPacket lobbyPacket;
+			memset( &lobbyPacket, 0, sizeof( lobbyPacket ) );
+			memcpy( &lobbyPacket, m_receiveBuffer, datagramBytes < sizeof( lobbyPacket ) ? datagramBytes : sizeof( lobbyPacket ) );
+			ProcessLobbyPacket( lobbyPacket, currentTime );
+		}
+		else if( (unsigned char) m_receiveBuffer[ 0 ] == TYPE_Parity )
+		{
+			CS6ParityPacket parityPacket;
+			memset( &parityPacket, 0, sizeof( parityPacket ) );
+			memcpy( &parityPacket, m_receiveBuffer, datagramBytes < sizeof( parityPacket ) ? datagramBytes : sizeof( parityPacket ) );
+
+			CS6Packet rebuiltPacket;
+			if( m_parityDecoder.RebuildMissingPacket( parityPacket, rebuiltPacket ) )
+			{
+				++m_numRebuiltPackets;
+				ProcessGamePacket( rebuiltPacket, source.m_portNumber, currentTime );
+			}
+		}
+		else
+		{
+			CS6Packet gamePacket;
+			memset( &gamePacket, 0, sizeof( gamePacket ) );
+			memcpy( &gamePacket, m_receiveBuffer, datagramBytes < sizeof( gamePacket ) ? datagramBytes : sizeof( gamePacket ) );
+			if( gamePacket.packetType != TYPE_Update )
+				m_parityDecoder.RememberPacket( gamePacket );
+
+			ProcessGamePacket( gamePacket, source.m_portNumber, currentTime );
+		}
+
+		if( m_state == SIM_CLIENT_Left )
+			return;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SimulatedClient::ProcessLobbyPacket( const LobbyPacket& packet, double currentTime )
+{
+	if( m_state == SIM_CLIENT_ConnectingToLobby )
+	{
+		if( packet.packetType == LOBBY_TYPE_Challenge )
+		{
+			m_cookie = packet.data.challenge.cookie;
+			m_nextRequestTime = currentTime;
+		}
+		else if( packet.packetType == LOBBY_TYPE_Acknowledge && packet.data.acknowledged.packetType == LOBBY_TYPE_Acknowledge )
+		{
+			m_state = SIM_CLIENT_InLobby;
+			m_nextRequestTime = currentTime;
+			m_nextHeartbeatTime = currentTime + SIM_SECONDS_BEFORE_SEND_HEARTBEAT;
+		}
+
+		return;
+	}
+
+	if( m_state != SIM_CLIENT_InLobby )
+		return;
+
+	//The lobby answers an unknown game with its own port, so go back to waiting for the listing
+	bool isGameAck = ( packet.data.acknowledged.packetType == LOBBY_TYPE_CreateGame || packet.data.acknowledged.packetType == LOBBY_TYPE_JoinGame );
+	if( packet.packetType == LOBBY_TYPE_Acknowledge && isGameAck )
+	{
+		if( packet.data.acknowledged.portNumber == PORT_NUMBER )
+		{
+			m_hasFoundGame = false;
+			return;
+		}
+
+		m_gameAddress.m_portNumber = htons( packet.data.acknowledged.portNumber );
+		m_state = SIM_CLIENT_InGame;
+		m_nextUpdateTime = currentTime;
+		return;
+	}
+
+	if( packet.packetType == LOBBY_TYPE_Busy )
+	{
+		m_nextRequestTime = currentTime + packet.data.busy.retryAfterSeconds;
+		return;
+	}
+
+	if( m_isGameOwner || m_hasFoundGame )
+		return;
+
+	if( packet.packetType == LOBBY_TYPE_Update && strncmp( packet.data.update.gameOwner, m_gameOwnerName.c_str(), sizeof( packet.data.update.gameOwner ) ) == 0 )
+	{
+		m_gameID = packet.data.update.gameID;
+		m_hasFoundGame = true;
+		m_nextRequestTime = currentTime;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SimulatedClient::ProcessGamePacket( const CS6Packet& packet, unsigned short gamePortNumber, double currentTime )
+{
+	if( packet.packetType == TYPE_Reset )
+	{
+		m_gameAddress.m_portNumber = gamePortNumber;
+		m_playerID = packet.playerID;
+		m_position = Vector2( packet.data.reset.playerXPosition, packet.data.reset.playerYPosition );
+		m_orientationDegrees = 0.f;
+		m_lastMoveTime = currentTime;
+		m_nextUpdateTime = currentTime;
+		m_updateHistory.Clear();
+		m_updateScheduler.Reset();
+		PickNewTarget();
+
+		m_state = SIM_CLIENT_InGame;
+
+		++m_numResetsReceived;
+		AddToStateHash( packet.playerID );
+		AcknowledgeGamePacket( packet, currentTime );
+	}
+	else if( packet.packetType == TYPE_GameOver )
+	{
+		m_hasSeenGameOver = true;
+		AcknowledgeGamePacket( packet, currentTime );
+		SendPendingAck( currentTime );
+		m_state = SIM_CLIENT_Left;
+	}
+	else if( packet.packetType == TYPE_Update && m_state == SIM_CLIENT_InGame )
+	{
+		++m_numUpdatesReceived;
+
+		unsigned int xBits = 0;
+		unsigned int yBits = 0;
+		memcpy( &xBits, &packet.data.updated.xPosition, sizeof( xBits ) );
+		memcpy( &yBits, &packet.data.updated.yPosition, sizeof( yBits ) );
+		AddToStateHash( packet.playerID );
+		AddToStateHash( xBits );
+		AddToStateHash( yBits );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SimulatedClient::SendLobbyRequests( double currentTime )
+{
+	if( m_state == SIM_CLIENT_InLobby && currentTime >= m_nextHeartbeatTime )
+	{
+		LobbyPacket heartbeatPacket;
+		memset( &heartbeatPacket, 0, sizeof( heartbeatPacket ) );
+		heartbeatPacket.packetType = LOBBY_TYPE_Heartbeat;
+		heartbeatPacket.data.challenge.cookie = m_cookie;
+		SendPacketToLobby( heartbeatPacket, currentTime );
+
+		m_nextHeartbeatTime = currentTime + SIM_SECONDS_BEFORE_SEND_HEARTBEAT;
+	}
+
+	if( currentTime < m_nextRequestTime )
+		return;
+
+	LobbyPacket requestPacket;
+	memset( &requestPacket, 0, sizeof( requestPacket ) );
+
+	if( m_state == SIM_CLIENT_ConnectingToLobby )
+	{
+		requestPacket.packetType = LOBBY_TYPE_Acknowledge;
+		requestPacket.data.acknowledged.packetType = LOBBY_TYPE_Acknowledge;
+		requestPacket.data.acknowledged.cookie = m_cookie;
+		m_nextRequestTime = currentTime + SIM_SECONDS_BEFORE_RESEND_CONNECT;
+	}
+	else if( m_isGameOwner )
+	{
+		requestPacket.packetType = LOBBY_TYPE_CreateGame;
+		m_nextRequestTime = currentTime + SIM_SECONDS_BEFORE_RESEND_GAME_REQUEST;
+	}
+	else if( m_hasFoundGame )
+	{
+		requestPacket.packetType = LOBBY_TYPE_JoinGame;
+		requestPacket.data.join.gameID = m_gameID;
+		m_nextRequestTime = currentTime + SIM_SECONDS_BEFORE_RESEND_GAME_REQUEST;
+	}
+	else
+	{
+		return;
+	}
+
+	SendPacketToLobby( requestPacket, currentTime );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Moves at the real client's speed toward a random point, and picks another once it gets there
+void SimulatedClient::SendGameUpdate( double currentTime )
+{
+	if( m_playerID == INVALID_PLAYER_ID )
+		return;
+
+	if( currentTime < m_nextUpdateTime && m_pendingAckType == TYPE_None )
+		return;
+
+	float deltaSeconds = (float) ( currentTime - m_lastMoveTime );
+	m_lastMoveTime = currentTime;
+
+	Vector2 toTarget = m_target - m_position;
+	float distanceToTarget = toTarget.GetLength();
+	float moveDistance = SIM_SPEED_PIXELS_PER_SECOND * deltaSeconds;
+	Vector2 velocity( 0.f, 0.f );
+	if( distanceToTarget <= moveDistance )
+	{
+		m_position = m_target;
+		PickNewTarget();
+	}
+	else
+	{
+		velocity = toTarget * ( SIM_SPEED_PIXELS_PER_SECOND / distanceToTarget );
+		m_position += velocity * deltaSeconds;
+		m_orientationDegrees = atan2f( velocity.y, velocity.x ) * ( 180.f / 3.14159265f );
+	}
+
+	m_nextUpdateTime = currentTime + SIM_SECONDS_PER_MOVE;
+	UpdateReason reason = m_updateScheduler.GetUpdateReason( m_position, velocity, m_orientationDegrees, currentTime );
+	if( reason == UPDATE_REASON_None && m_pendingAckType != TYPE_None )
+		reason = UPDATE_REASON_CarryAck;
+
+	if( reason == UPDATE_REASON_None )
+		return;
+
+	CS6Packet updatePacket;
+	memset( &updatePacket, 0, sizeof( updatePacket ) );
+	updatePacket.packetType = TYPE_Update;
+	updatePacket.playerID = m_playerID;
+	updatePacket.data.updated.xPosition = m_position.x;
+	updatePacket.data.updated.yPosition = m_position.y;
+	updatePacket.data.updated.xVelocity = velocity.x;
+	updatePacket.data.updated.yVelocity = velocity.y;
+	updatePacket.data.updated.yawDegrees = m_orientationDegrees;
+	SendPacketToGame( updatePacket, currentTime );
+	m_updateScheduler.RecordUpdate( reason, m_position, velocity, m_orientationDegrees, currentTime );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SimulatedClient::SendPacketToLobby( LobbyPacket& packet, double currentTime )
+{
+	packet.packetNumber = m_nextPacketNumber;
+	++m_nextPacketNumber;
+	packet.timestamp = currentTime;
+	packet.echoTimestamp = 0.0;
+	packet.echoHoldSeconds = 0.f;
+
+	m_network->SendDatagram( m_endpointIndex, m_lobbyAddress, (const char*) &packet, sizeof( packet ), currentTime );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SimulatedClient::SendPacketToGame( CS6Packet& packet, double currentTime )
+{
+	packet.packetNumber = m_nextPacketNumber;
+	++m_nextPacketNumber;
+	packet.timestamp = currentTime;
+	packet.echoTimestamp = 0.0;
+	packet.echoHoldSeconds = 0.f;
+	packet.ackedPacketType = m_pendingAckType;
+	packet.ackedPacketNumber = m_pendingAckNumber;
+	m_pendingAckType = TYPE_None;
+	if( packet.packetType == TYPE_Update )
+		m_updateHistory.WriteHistoryAndAddState( packet );
+
+	m_network->SendDatagram( m_endpointIndex, m_gameAddress, (const char*) &packet, GetNumberOfBytesToSend( packet ), currentTime );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Waits for the next packet out, which is the update sent later in this same step, due or not
+void SimulatedClient::AcknowledgeGamePacket( const CS6Packet& packet, double currentTime )
+{
+	SendPendingAck( currentTime );
+
+	m_pendingAckType = packet.packetType;
+	m_pendingAckNumber = packet.packetNumber;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SimulatedClient::SendPendingAck( double currentTime )
+{
+	if( m_pendingAckType == TYPE_None )
+		return;
+
+	CS6Packet ackPacket;
+	memset( &ackPacket, 0, sizeof( ackPacket ) );
+	ackPacket.packetType = TYPE_Acknowledge;
+	ackPacket.playerID = m_playerID;
+	ackPacket.data.acknowledged.packetNumber = m_pendingAckNumber;
+	ackPacket.data.acknowledged.packetType = m_pendingAckType;
+	m_pendingAckType = TYPE_None;
+
+	SendPacketToGame( ackPacket, currentTime );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SimulatedClient::PickNewTarget()
+{
+	m_target.x = (float) ( GetNextRandom() % MAP_SIZE_WIDTH );
+	m_target.y = (float) ( GetNextRandom() % MAP_SIZE_HEIGHT );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//FNV-1a over the value's bytes
+void SimulatedClient::AddToStateHash( unsigned int value )
+{
+	for( unsigned int byteIndex = 0; byteIndex < 4; ++byteIndex )
+	{
+		m_stateHash ^= ( value >> ( byteIndex * 8 ) ) & 0xff;
+		m_stateHash *= 16777619u;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int SimulatedClient::GetNextRandom()
+{
+	m_randomState ^= m_randomState << 13;
+	m_randomState ^= m_randomState >> 17;
+	m_randomState ^= m_randomState << 5;
+	return m_randomState;
+}
\ No newline at end of file
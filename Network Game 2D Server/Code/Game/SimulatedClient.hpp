@@ -0,0 +1,105 @@
+#ifndef include_SimulatedClient
+#define include_SimulatedClient
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <string>
+#include "CS6Packet.hpp"
+#include "ClientInfo.hpp"
+#include "LobbyPacket.hpp"
+#include "MemoryNetwork.hpp"
+#include "ParityGroup.hpp"
+#include "UpdateHistory.hpp"
+#include "UpdateScheduler.hpp"
+#include "../Engine/Vector2.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const double SIM_SECONDS_BEFORE_RESEND_CONNECT = 0.25;
+const double SIM_SECONDS_BEFORE_RESEND_GAME_REQUEST = 1.0;
+const double SIM_SECONDS_BEFORE_SEND_HEARTBEAT = 1.0;
+const double SIM_SECONDS_PER_MOVE = 0.1;
+const float SIM_SPEED_PIXELS_PER_SECOND = 100.f;
+const unsigned int SIM_MAX_RECEIVED_BYTES = 1500;
+
+
+//-----------------------------------------------------------------------------------------------
+enum SimulatedClientState
+{
+	SIM_CLIENT_ConnectingToLobby,
+	SIM_CLIENT_InLobby,
+	SIM_CLIENT_InGame,
+	SIM_CLIENT_Left,
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Plays the client's side of the lobby and game protocols over a MemoryNetwork. The first client
+//of each group creates the game and the rest join it once the lobby lists it. In game it wanders
+//toward random points in steps, sends updates whenever the real client's scheduler would, and
+//acks reliable messages, on an update when one goes out in the same step. Past its leave time it goes silent, so the server has
+//to time it out
+class SimulatedClient
+{
+public:
+	SimulatedClient();
+	void Initialize( MemoryNetwork* network, const ClientInfo& address, const ClientInfo& gameOwner, double leaveTime, unsigned int randomSeed );
+	void Update( double currentTime );
+	SimulatedClientState GetState() const;
+	unsigned int GetNumberOfUpdatesReceived() const;
+	unsigned int GetNumberOfResetsReceived() const;
+	unsigned int GetNumberOfRebuiltPackets() const;
+	bool HasSeenGameOver() const;
+	unsigned int GetStateHash() const;
+
+private:
+	void ReceivePackets( double currentTime );
+	void ProcessLobbyPacket( const LobbyPacket& packet, double currentTime );
+	void ProcessGamePacket( const CS6Packet& packet, unsigned short gamePortNumber, double currentTime );
+	void SendLobbyRequests( double currentTime );
+	void SendGameUpdate( double currentTime );
+	void SendPacketToLobby( LobbyPacket& packet, double currentTime );
+	void SendPacketToGame( CS6Packet& packet, double currentTime );
+	void AcknowledgeGamePacket( const CS6Packet& packet, double currentTime );
+	void SendPendingAck( double currentTime );
+	void PickNewTarget();
+	void AddToStateHash( unsigned int value );
+	unsigned int GetNextRandom();
+
+	MemoryNetwork*				m_network;
+	unsigned int				m_endpointIndex;
+	ClientInfo					m_address;
+	ClientInfo					m_lobbyAddress;
+	ClientInfo					m_gameAddress;
+	std::string					m_gameOwnerName;
+	bool						m_isGameOwner;
+	SimulatedClientState		m_state;
+	SequenceNumber				m_nextPacketNumber;
+	unsigned long long			m_cookie;
+	unsigned int				m_gameID;
+	bool						m_hasFoundGame;
+	unsigned short				m_playerID;
+	Vector2						m_position;
+	Vector2						m_target;
+	float						m_orientationDegrees;
+	double						m_lastMoveTime;
+	double						m_nextRequestTime;
+	double						m_nextHeartbeatTime;
+	double						m_nextUpdateTime;
+	double						m_leaveTime;
+	unsigned int				m_randomState;
+	unsigned int				m_numUpdatesReceived;
+	unsigned int				m_numResetsReceived;
+	unsigned int				m_numRebuiltPackets;
+	bool						m_hasSeenGameOver;
+	unsigned int				m_stateHash;
+	PacketType					m_pendingAckType;
+	SequenceNumber				m_pendingAckNumber;
+	UpdateHistory				m_updateHistory;
+	UpdateScheduler				m_updateScheduler;
+	ParityDecoder				m_parityDecoder;
+	char						m_receiveBuffer[ SIM_MAX_RECEIVED_BYTES ];
+};
+
+
+#endif // include_SimulatedClient
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "Simulation.hpp"
+#include <iostream>
+#include <vector>
+#include "MemoryNetwork.hpp"
+#include "SimulatedClient.hpp"
+#include "UDPServer.hpp"
+#include "../Engine/Time.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+//Starts well clear of zero, since several timeouts treat a zero time as never
+static const double SIMULATION_START_SECONDS = 1000.0;
+static double g_simulationTime = SIMULATION_START_SECONDS;
+
+
+//-----------------------------------------------------------------------------------------------
+static double GetSimulationTimeSeconds()
+{
+	return g_simulationTime;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+SimulationSettings::SimulationSettings()
+	: m_numClients( 1000 )
+	, m_playersPerGame( 8 )
+	, m_durationSeconds( 600.0 )
+	, m_stepSeconds( 0.01 )
+	, m_latencySeconds( 0.05 )
+	, m_lossChance( 0.01f )
+	, m_leaveChance( 0.1f )
+	, m_randomSeed( 1 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Clients are grouped in order, and the first of each group creates the game the rest join. Those
+//picked to leave go silent at a random point in the run instead of staying to the end
+void RunSimulation( Lobby& lobby, const SimulationSettings& settings )
+{
+	InitializeTime();
+	double realStartTime = GetRealTimeSeconds();
+
+	g_simulationTime = SIMULATION_START_SECONDS;
+	SetTimeSource( GetSimulationTimeSeconds );
+
+	MemoryNetwork network;
+	network.Initialize( settings.m_latencySeconds, settings.m_lossChance, settings.m_randomSeed );
+	SetSimulatedNetwork( &network );
+	SetSecondsBetweenMetricsReports( 0.0 );
+	srand( settings.m_randomSeed );
+
+	lobby.Initalize();
+
+	unsigned int playersPerGame = settings.m_playersPerGame > 0 ? settings.m_playersPerGame : 1;
+	double endTime = SIMULATION_START_SECONDS + settings.m_durationSeconds;
+	std::vector< SimulatedClient > clients( settings.m_numClients );
+	for( unsigned int clientIndex = 0; clientIndex < settings.m_numClients; ++clientIndex )
+	{
+		unsigned int ownerIndex = clientIndex - clientIndex % playersPerGame;
+
+		ClientInfo address;
+		address.m_ipAddress = htonl( 0x0a000000 | ( clientIndex + 1 ) );
+		address.m_portNumber = htons( 40000 );
+
+		ClientInfo gameOwner;
+		gameOwner.m_ipAddress = htonl( 0x0a000000 | ( ownerIndex + 1 ) );
+		gameOwner.m_portNumber = htons( 40000 );
+
+		//Multiplying by large odd constants spreads neighbouring indices across the whole range
+		unsigned int clientSeed = ( settings.m_randomSeed * 2654435761u ) ^ ( ( clientIndex + 1 ) * 2246822519u );
+		unsigned int leaveRoll = ( clientSeed * 2654435761u ) >> 16;
+		unsigned int leavePoint = ( clientSeed * 3266489917u ) >> 16;
+
+		double leaveTime = endTime + 1.0;
+		if( (float) leaveRoll < settings.m_leaveChance * 65536.f )
+			leaveTime = SIMULATION_START_SECONDS + settings.m_durationSeconds * (double) leavePoint / 65536.0;
+
+		clients[ clientIndex ].Initialize( &network, address, gameOwner, leaveTime, clientSeed );
+	}
+
+	while( g_simulationTime < endTime )
+	{
+		for( unsigned int clientIndex = 0; clientIndex < clients.size(); ++clientIndex )
+		{
+			clients[ clientIndex ].Update( g_simulationTime );
+		}
+
+		lobby.Update();
+		g_simulationTime += settings.m_stepSeconds;
+	}
+
+	unsigned int numClientsInState[ SIM_CLIENT_Left + 1 ] = { 0 };
+	unsigned int numUpdatesReceived = 0;
+	unsigned int numResetsReceived = 0;
+	unsigned int numRebuiltPackets = 0;
+	unsigned int numGameOversSeen = 0;
+	unsigned int combinedHash = 2166136261u;
+	for( unsigned int clientIndex = 0; clientIndex < clients.size(); ++clientIndex )
+	{
+		const SimulatedClient& client = clients[ clientIndex ];
+		++numClientsInState[ client.GetState() ];
+		numUpdatesReceived += client.GetNumberOfUpdatesReceived();
+		numResetsReceived += client.GetNumberOfResetsReceived();
+		numRebuiltPackets += client.GetNumberOfRebuiltPackets();
+		if( client.HasSeenGameOver() )
+			++numGameOversSeen;
+
+		combinedHash = ( combinedHash ^ client.GetStateHash() ) * 16777619u;
+	}
+
+	std::cout << "Simulated " << settings.m_durationSeconds << " seconds with " << settings.m_numClients << " clients, seed " << settings.m_randomSeed << "\n";
+	std::cout << "Datagrams sent " << network.GetNumberOfSentDatagrams() << ", delivered " << network.GetNumberOfDeliveredDatagrams();
+	std::cout << ", lost " << network.GetNumberOfLostDatagrams() << ", undeliverable " << network.GetNumberOfUndeliverableDatagrams() << "\n";
+	std::cout << "Clients connecting " << numClientsInState[ SIM_CLIENT_ConnectingToLobby ] << ", in lobby " << numClientsInState[ SIM_CLIENT_InLobby ];
+	std::cout << ", in game " << numClientsInState[ SIM_CLIENT_InGame ] << ", left " << numClientsInState[ SIM_CLIENT_Left ] << "\n";
+	std::cout << "Updates received " << numUpdatesReceived << ", resets " << numResetsReceived << ", game overs " << numGameOversSeen;
+	std::cout << ", rebuilt from parity " << numRebuiltPackets << "\n";
+	std::cout << "State hash " << std::hex << combinedHash << std::dec << "\n";
+	std::cout << "Took " << GetRealTimeSeconds() - realStartTime << " real seconds\n";
+
+	SetSimulatedNetwork( nullptr );
+	SetTimeSource( nullptr );
+}
\ No newline at end of file
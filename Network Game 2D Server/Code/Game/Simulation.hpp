@@ -0,0 +1,33 @@
+#ifndef include_Simulation
+#define include_Simulation
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include "Lobby.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+struct SimulationSettings
+{
+	SimulationSettings();
+
+	unsigned int	m_numClients;
+	unsigned int	m_playersPerGame;
+	double			m_durationSeconds;
+	double			m_stepSeconds;
+	double			m_latencySeconds;
+	float			m_lossChance;
+	float			m_leaveChance;
+	unsigned int	m_randomSeed;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Runs the lobby and its games against simulated clients on a MemoryNetwork, on a virtual clock
+//that jumps a fixed step at a time. The same settings always print the same totals, however long
+//the run takes on the wall clock. The lobby stays bound to the finished network, so this is the
+//last thing the process runs
+void RunSimulation( Lobby& lobby, const SimulationSettings& settings );
+
+
+#endif // include_Simulation
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "TickScheduler.hpp"
+#include <algorithm>
+
+
+//-----------------------------------------------------------------------------------------------
+void TickStats::Reset()
+{
+	m_numTicks = 0;
+	m_numMergedTicks = 0;
+	m_numSkippedTicks = 0;
+	m_numOverruns = 0;
+	m_jitterSeconds.Reset();
+	m_tickSeconds.Reset();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void TickScheduler::AddTask( unsigned int taskID, double secondsPerTick, double firstDeadline )
+{
+	Task& task = m_tasks[ taskID ];
+	task.m_secondsPerTick = secondsPerTick;
+	task.m_deadline = firstDeadline;
+	task.m_stats.Reset();
+
+	PushTask( taskID, firstDeadline );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The task's entry is left in the run queue and thrown away when it reaches the front
+void TickScheduler::RemoveTask( unsigned int taskID )
+{
+	m_tasks.erase( taskID );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Takes effect from the task's next deadline on
+void TickScheduler::SetTaskSecondsPerTick( unsigned int taskID, double secondsPerTick )
+{
+	std::map< unsigned int, Task >::iterator taskIter = m_tasks.find( taskID );
+	if( taskIter != m_tasks.end() )
+		taskIter->second.m_secondsPerTick = secondsPerTick;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Hands out the task with the earliest deadline if it is due, and works out its next deadline.
+//A task that missed a few ticks keeps its phase, one that missed more restarts from now
+bool TickScheduler::PopDueTask( double currentTime, unsigned int& out_taskID )
+{
+	while( !m_runQueue.empty() && m_runQueue.front().m_deadline <= currentTime )
+	{
+		QueueEntry entry = m_runQueue.front();
+		std::pop_heap( m_runQueue.begin(), m_runQueue.end(), LaterDeadline() );
+		m_runQueue.pop_back();
+
+		std::map< unsigned int, Task >::iterator taskIter = m_tasks.find( entry.m_taskID );
+		if( taskIter == m_tasks.end() || taskIter->second.m_deadline != entry.m_deadline )
+			continue;
+
+		Task& task = taskIter->second;
+		double lateness = currentTime - task.m_deadline;
+		unsigned int numTicksDue = 1 + (unsigned int) ( lateness / task.m_secondsPerTick );
+
+		task.m_stats.m_jitterSeconds.AddSample( lateness );
+		++task.m_stats.m_numTicks;
+		if( numTicksDue <= MAX_TICKS_TO_MERGE )
+		{
+			task.m_stats.m_numMergedTicks += numTicksDue - 1;
+			task.m_deadline += numTicksDue * task.m_secondsPerTick;
+		}
+		else
+		{
+			task.m_stats.m_numSkippedTicks += numTicksDue - 1;
+			task.m_deadline = currentTime + task.m_secondsPerTick;
+		}
+
+		out_taskID = entry.m_taskID;
+		return true;
+	}
+
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Puts the task back in the run queue. Tasks removed while they ran are simply not put back
+void TickScheduler::FinishTask( unsigned int taskID, double startTime, double finishTime )
+{
+	std::map< unsigned int, Task >::iterator taskIter = m_tasks.find( taskID );
+	if( taskIter == m_tasks.end() )
+		return;
+
+	Task& task = taskIter->second;
+	double tickSeconds = finishTime - startTime;
+	task.m_stats.m_tickSeconds.AddSample( tickSeconds );
+	if( tickSeconds > task.m_secondsPerTick )
+		++task.m_stats.m_numOverruns;
+
+	PushTask( taskID, task.m_deadline );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Returns a negative time when nothing is scheduled
+double TickScheduler::GetNextDeadline() const
+{
+	if( m_runQueue.empty() )
+		return -1.0;
+
+	return m_runQueue.front().m_deadline;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+const TickStats& TickScheduler::GetTickStats( unsigned int taskID ) const
+{
+	return m_tasks.find( taskID )->second.m_stats;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void TickScheduler::ResetTickStats()
+{
+	std::map< unsigned int, Task >::iterator taskIter;
+	for( taskIter = m_tasks.begin(); taskIter != m_tasks.end(); ++taskIter )
+	{
+		taskIter->second.m_stats.Reset();
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void TickScheduler::PushTask( unsigned int taskID, double deadline )
+{
+	QueueEntry entry;
+	entry.m_deadline = deadline;
+	entry.m_taskID = taskID;
+
+	m_runQueue.push_back( entry );
+	std::push_heap( m_runQueue.begin(), m_runQueue.end(), LaterDeadline() );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Ties go to the lower id, so tasks due together always run in the same order
+bool TickScheduler::LaterDeadline::operator()( const QueueEntry& lhs, const QueueEntry& rhs ) const
+{
+	if( lhs.m_deadline != rhs.m_deadline )
+		return lhs.m_deadline > rhs.m_deadline;
+
+	return lhs.m_taskID > rhs.m_taskID;
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#ifndef include_TickScheduler
+#define include_TickScheduler
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+#include <map>
+#include <vector>
+#include "Metrics.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int MAX_TICKS_TO_MERGE = 4;
+
+
+//-----------------------------------------------------------------------------------------------
+//Jitter is how late each tick started against its deadline. A merged tick stood in for up to
+//MAX_TICKS_TO_MERGE missed ones, and skipped ticks were dropped because the task was further
+//behind than that. An overrun is a tick that took longer than its own interval
+struct TickStats
+{
+	TickStats() { Reset(); }
+	void Reset();
+
+	unsigned int	m_numTicks;
+	unsigned int	m_numMergedTicks;
+	unsigned int	m_numSkippedTicks;
+	unsigned int	m_numOverruns;
+	MetricSummary	m_jitterSeconds;
+	MetricSummary	m_tickSeconds;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+//Earliest-deadline-first run queue of periodic tasks, each on its own interval. A task that has
+//fallen behind runs once for all its missed ticks rather than once per tick, so a slow task can't
+//spiral and hold every other one up while it catches up
+class TickScheduler
+{
+public:
+	void AddTask( unsigned int taskID, double secondsPerTick, double firstDeadline );
+	void RemoveTask( unsigned int taskID );
+	void SetTaskSecondsPerTick( unsigned int taskID, double secondsPerTick );
+	bool PopDueTask( double currentTime, unsigned int& out_taskID );
+	void FinishTask( unsigned int taskID, double startTime, double finishTime );
+	double GetNextDeadline() const;
+	const TickStats& GetTickStats( unsigned int taskID ) const;
+	void ResetTickStats();
+
+private:
+	struct Task
+	{
+		double			m_secondsPerTick;
+		double			m_deadline;
+		TickStats		m_stats;
+	};
+
+	struct QueueEntry
+	{
+		double			m_deadline;
+		unsigned int	m_taskID;
+	};
+
+	struct LaterDeadline
+	{
+		bool operator()( const QueueEntry& lhs, const QueueEntry& rhs ) const;
+	};
+
+	void PushTask( unsigned int taskID, double deadline );
+
+	std::map< unsigned int, Task >	m_tasks;
+	std::vector< QueueEntry >		m_runQueue;
+};
+
+
+#endif // include_TickScheduler
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "TimerWheel.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+TimerWheel::TimerWheel()
+	: m_secondsPerTick( SECONDS_PER_TIMER_WHEEL_TICK )
+	, m_currentTick( 0 )
+	, m_numTimers( 0 )
+{
+
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void TimerWheel::Initialize( double startTimeSeconds, double secondsPerTick )
+{
+	for( unsigned int level = 0; level < NUM_TIMER_WHEEL_LEVELS; ++level )
+	{
+		for( unsigned int slotIndex = 0; slotIndex < NUM_TIMER_WHEEL_SLOTS; ++slotIndex )
+		{
+			m_slots[ level ][ slotIndex ].clear();
+		}
+	}
+
+	m_secondsPerTick = secondsPerTick;
+	m_currentTick = 0;
+	if( startTimeSeconds > 0.0 )
+		m_currentTick = (unsigned long long) ( startTimeSeconds / m_secondsPerTick );
+
+	m_numTimers = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void TimerWheel::AddTimer( unsigned int timerID, double deadlineSeconds )
+{
+	//Round up so a timer never fires before its deadline, and never into the tick already processed
+	Timer timer;
+	timer.m_timerID = timerID;
+	timer.m_deadlineTick = m_currentTick + 1;
+
+	double deadlineTicks = deadlineSeconds / m_secondsPerTick;
+	if( deadlineTicks > (double) timer.m_deadlineTick )
+	{
+		timer.m_deadlineTick = (unsigned long long) deadlineTicks;
+		if( (double) timer.m_deadlineTick < deadlineTicks )
+			++timer.m_deadlineTick;
+	}
+
+	InsertTimer( timer );
+	++m_numTimers;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void TimerWheel::AdvanceTime( double currentTimeSeconds, std::vector< unsigned int >& out_expiredTimerIDs )
+{
+	if( currentTimeSeconds <= 0.0 )
+		return;
+
+	unsigned long long targetTick = (unsigned long long) ( currentTimeSeconds / m_secondsPerTick );
+	while( m_currentTick < targetTick )
+	{
+		++m_currentTick;
+
+		//Pull the next stretch of each coarser level down as the level below it wraps around
+		unsigned int cascadeLevel = 1;
+		while( cascadeLevel < NUM_TIMER_WHEEL_LEVELS && ( m_currentTick & ( ( 1ULL << ( TIMER_WHEEL_SLOT_BITS * cascadeLevel ) ) - 1 ) ) == 0 )
+		{
+			++cascadeLevel;
+		}
+
+		for( unsigned int level = cascadeLevel - 1; level > 0; --level )
+		{
+			CascadeTimers( level );
+		}
+
+		std::vector< Timer >& slot = m_slots[ 0 ][ m_currentTick & ( NUM_TIMER_WHEEL_SLOTS - 1 ) ];
+		for( unsigned int timerIndex = 0; timerIndex < slot.size(); ++timerIndex )
+		{
+			out_expiredTimerIDs.push_back( slot[ timerIndex ].m_timerID );
+		}
+
+		m_numTimers -= (unsigned int) slot.size();
+		slot.clear();
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int TimerWheel::GetNumberOfTimers() const
+{
+	return m_numTimers;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void TimerWheel::InsertTimer( const Timer& timer )
+{
+	unsigned long long ticksUntilDeadline = 0;
+	if( timer.m_deadlineTick > m_currentTick )
+		ticksUntilDeadline = timer.m_deadlineTick - m_currentTick;
+
+	unsigned int level = 0;
+	while( level + 1 < NUM_TIMER_WHEEL_LEVELS && ticksUntilDeadline >= ( 1ULL << ( TIMER_WHEEL_SLOT_BITS * ( level + 1 ) ) ) )
+	{
+		++level;
+	}
+
+	//Timers already due land in the slot being expired this tick, and timers past the top level's
+	//reach wait in its farthest slot and get re-bucketed when they cascade
+	unsigned long long slotTick = timer.m_deadlineTick;
+	unsigned long long maxTicks = 1ULL << ( TIMER_WHEEL_SLOT_BITS * NUM_TIMER_WHEEL_LEVELS );
+	if( ticksUntilDeadline == 0 )
+		slotTick = m_currentTick;
+	else if( ticksUntilDeadline >= maxTicks )
+		slotTick = m_currentTick + maxTicks - 1;
+
+	unsigned int slotIndex = (unsigned int) ( ( slotTick >> ( TIMER_WHEEL_SLOT_BITS * level ) ) & ( NUM_TIMER_WHEEL_SLOTS - 1 ) );
+	m_slots[ level ][ slotIndex ].push_back( timer );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void TimerWheel::CascadeTimers( unsigned int level )
+{
+	unsigned int slotIndex = (unsigned int) ( ( m_currentTick >> ( TIMER_WHEEL_SLOT_BITS * level ) ) & ( NUM_TIMER_WHEEL_SLOTS - 1 ) );
+
+	//Swap rather than copy so both vectors keep their capacity from one rotation to the next
+	m_cascadingTimers.clear();
+	m_cascadingTimers.swap( m_slots[ level ][ slotIndex ] );
+
+	for( unsigned int timerIndex = 0; timerIndex < m_cascadingTimers.size(); ++timerIndex )
+	{
+		InsertTimer( m_cascadingTimers[ timerIndex ] );
+	}
+}
\ No newline at end of file
@@ -1,15 +1,121 @@
 #include "UDPServer.hpp"
+#include <WS2tcpip.h>
+#include <iphlpapi.h>
+#include "../Engine/Time.hpp"
+
+
+//-----------------------------------------------------------------------------------------------
+static UDPBackend g_preferredBackend = UDP_BACKEND_Sockets;
+static unsigned int g_preferredOffloads = 0;
+static unsigned int g_preferredMTUBytes = DEFAULT_MTU_BYTES;
+static MemoryNetwork* g_simulatedNetwork = nullptr;
+static int g_sendBufferBytes = 0;
+static int g_receiveBufferBytes = 0;
+
+
+//-----------------------------------------------------------------------------------------------
+//Packs an IPv4 address and port into one key, still in network byte order
+inline unsigned long long GetAddressKey( const struct sockaddr_in& addr )
+{
+	return ( (unsigned long long) addr.sin_addr.s_addr << 16 ) | addr.sin_port;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Only affects servers started afterwards
+void SetPreferredUDPBackend( UDPBackend backend )
+{
+	g_preferredBackend = backend;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Takes UDPOffload flags, and likewise only affects servers started afterwards
+void SetPreferredUDPOffloads( unsigned int offloadFlags )
+{
+	g_preferredOffloads = offloadFlags;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The path MTU servers started afterwards split their messages to fit
+void SetPreferredMTU( unsigned int mtuBytes )
+{
+	g_preferredMTUBytes = mtuBytes;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Servers started while this is set talk over the given network instead of real sockets. Pass
+//nullptr to go back to sockets
+void SetSimulatedNetwork( MemoryNetwork* network )
+{
+	g_simulatedNetwork = network;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Socket buffer sizes in bytes for servers started afterwards. Zero leaves the OS default
+void SetSocketBufferSizes( int sendBufferBytes, int receiveBufferBytes )
+{
+	g_sendBufferBytes = sendBufferBytes;
+	g_receiveBufferBytes = receiveBufferBytes;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+UDPServer::UDPServer()
+	: m_maxDatagramBytes( GetMaxDatagramBytesForMTU( DEFAULT_MTU_BYTES ) )
+	, m_nextMessageID( 0 )
+	, m_isSendOffloadEnabled( false )
+	, m_receiveMessage( nullptr )
+	, m_coalescedOffset( 0 )
+	, m_coalescedBytes( 0 )
+	, m_coalescedSegmentBytes( 0 )
+	, m_simulatedNetwork( nullptr )
+	, m_simulatedEndpoint( INVALID_ENDPOINT_INDEX )
+	, m_numQueuedPackets( 0 )
+	, m_numDroppedUnreliable( 0 )
+	, m_numDroppedReliable( 0 )
+{
+
+}
 
 
 //-----------------------------------------------------------------------------------------------
 bool UDPServer::StartServer( unsigned short desiredPortNumber )
 {
+	SetMTU( g_preferredMTUBytes );
+
+	//A simulated server is the only endpoint on its port, and everything else is left alone
+	if( g_simulatedNetwork )
+	{
+		ClientInfo serverAddress;
+		serverAddress.m_ipAddress = htonl( INADDR_LOOPBACK );
+		serverAddress.m_portNumber = htons( desiredPortNumber );
+
+		m_simulatedEndpoint = g_simulatedNetwork->AddEndpoint( serverAddress );
+		if( m_simulatedEndpoint == INVALID_ENDPOINT_INDEX )
+			return false;
+
+		m_simulatedNetwork = g_simulatedNetwork;
+		m_reassembler.Initialize();
+		return true;
+	}
+
 	if( WSAStartup( 0x202, &m_wsaData ) != 0 )
 	{
 		return false;
 	}
 
-	m_socket = socket( PF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	//A registered I/O socket still works with the plain calls, so it is kept if setup fails later
+	m_socket = INVALID_SOCKET;
+	if( g_preferredBackend == UDP_BACKEND_RegisteredIO )
+		m_socket = WSASocket( PF_INET, SOCK_DGRAM, IPPROTO_UDP, NULL, 0, WSA_FLAG_REGISTERED_IO );
+
+	if( m_socket == INVALID_SOCKET )
+		m_socket = socket( PF_INET, SOCK_DGRAM, IPPROTO_UDP );
+
 	if( m_socket == INVALID_SOCKET )
 	{
 		return false;
@@ -30,6 +136,27 @@ bool UDPServer::StartServer( unsigned short desiredPortNumber )
 		return false;
 	}
 
+	//A datagram too big for the path is refused rather than split up by IP
+	DWORD dontFragment = TRUE;
+	setsockopt( m_socket, IPPROTO_IP, IP_DONTFRAGMENT, (const char*) &dontFragment, sizeof( dontFragment ) );
+
+	ApplySocketBufferSizes();
+	m_reassembler.Initialize();
+
+	if( g_preferredBackend == UDP_BACKEND_RegisteredIO )
+		m_registeredIO.Initialize( m_socket, MAX_DATAGRAM_BYTES );
+
+	//Offloads only apply to the plain socket calls, and each one quietly stays off where the OS
+	//or the network adapter doesn't support it
+	if( !m_registeredIO.IsInitialized() )
+	{
+		if( ( g_preferredOffloads & UDP_OFFLOAD_Send ) != 0 )
+			EnableSendOffload();
+
+		if( ( g_preferredOffloads & UDP_OFFLOAD_Receive ) != 0 )
+			EnableReceiveOffload();
+	}
+
 	return true;
 }
 
@@ -37,30 +164,568 @@ bool UDPServer::StartServer( unsigned short desiredPortNumber )
 //-----------------------------------------------------------------------------------------------
 void UDPServer::EndServer()
 {
+	m_outboundQueues.clear();
+	m_numQueuedPackets = 0;
+
+	if( m_simulatedNetwork )
+	{
+		m_simulatedNetwork->RemoveEndpoint( m_simulatedEndpoint );
+		m_simulatedNetwork = nullptr;
+		m_simulatedEndpoint = INVALID_ENDPOINT_INDEX;
+		return;
+	}
+
 	closesocket( m_socket );
+	m_registeredIO.Shutdown();
 	WSACleanup();
 }
 
 
 //-----------------------------------------------------------------------------------------------
-bool UDPServer::SendPacketToClient( const char* packetInfo, int packetLength, const struct sockaddr_in& clientAddr )
+bool UDPServer::IsUsingRegisteredIO() const
 {
-	if( sendto( m_socket, packetInfo, packetLength, 0, (struct sockaddr*) &clientAddr, sizeof( clientAddr ) ) < 0 )
-	{
+	return m_registeredIO.IsInitialized();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int UDPServer::GetEnabledOffloads() const
+{
+	unsigned int offloadFlags = 0;
+	if( m_isSendOffloadEnabled )
+		offloadFlags |= UDP_OFFLOAD_Send;
+
+	if( m_receiveMessage )
+		offloadFlags |= UDP_OFFLOAD_Receive;
+
+	return offloadFlags;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool UDPServer::IsSimulated() const
+{
+	return m_simulatedNetwork != nullptr;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void UDPServer::SetMTU( unsigned int mtuBytes )
+{
+	m_maxDatagramBytes = GetMaxDatagramBytesForMTU( mtuBytes );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+unsigned int UDPServer::GetMaxDatagramBytes() const
+{
+	return m_maxDatagramBytes;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Returns true once a packet is waiting, or false if the timeout runs out first
+bool UDPServer::WaitForPacketFromClient( long timeoutMicroseconds )
+{
+	//Nothing arrives on a simulated network until its owner moves the clock, so there is no waiting
+	if( m_simulatedNetwork )
 		return false;
+
+	if( m_registeredIO.IsInitialized() )
+		return m_registeredIO.WaitForDatagram( ( timeoutMicroseconds + 999 ) / 1000 );
+
+	if( m_coalescedOffset < m_coalescedBytes )
+		return true;
+
+	fd_set readSockets;
+	FD_ZERO( &readSockets );
+	FD_SET( m_socket, &readSockets );
+
+	struct timeval timeout;
+	timeout.tv_sec = timeoutMicroseconds / 1000000;
+	timeout.tv_usec = timeoutMicroseconds % 1000000;
+
+	return select( 0, &readSockets, nullptr, nullptr, &timeout ) > 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Once a client has packets waiting, everything after them waits too so they arrive in the order
+//they were sent. When the socket can't take a packet it is queued instead of lost
+UDPSendResult UDPServer::SendPacketToClient( const char* packetInfo, int packetLength, const struct sockaddr_in& clientAddr, bool isReliable )
+{
+	if( HasQueuedPackets( clientAddr ) )
+		return QueuePacket( packetInfo, packetLength, clientAddr, isReliable );
+
+	UDPSendResult result = SendMessage( packetInfo, packetLength, clientAddr );
+	if( result == UDP_SEND_WouldBlock )
+		return QueuePacket( packetInfo, packetLength, clientAddr, isReliable );
+
+	if( result == UDP_SEND_Dropped )
+	{
+		if( isReliable )
+			++m_numDroppedReliable;
+		else
+			++m_numDroppedUnreliable;
 	}
 
+	return result;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//For a run of same-sized unreliable packets to one client, like a tick's snapshots. With send
+//offload on they go down in as few calls as possible and the kernel or adapter splits them into
+//datagrams. Whatever the socket can't take is queued one packet at a time
+UDPSendResult UDPServer::SendPacketsToClient( const char* packetInfo, int packetLength, unsigned int numPackets, const struct sockaddr_in& clientAddr )
+{
+	unsigned int firstUnsentPacket = 0;
+	if( m_isSendOffloadEnabled && numPackets > 1 && packetLength > 0 && (unsigned int) packetLength <= m_maxDatagramBytes && !HasQueuedPackets( clientAddr ) )
+	{
+		unsigned int packetsPerSend = MAX_OFFLOADED_SEND_BYTES / packetLength;
+		for( ; firstUnsentPacket < numPackets; firstUnsentPacket += packetsPerSend )
+		{
+			unsigned int numPacketsInSend = numPackets - firstUnsentPacket;
+			if( numPacketsInSend > packetsPerSend )
+				numPacketsInSend = packetsPerSend;
+
+			UDPSendResult result = SendSegmentedDatagrams( packetInfo + firstUnsentPacket * packetLength, numPacketsInSend * packetLength, packetLength, clientAddr );
+			if( result == UDP_SEND_WouldBlock )
+				break;
+
+			if( result == UDP_SEND_Dropped )
+			{
+				m_numDroppedUnreliable += numPacketsInSend;
+				return UDP_SEND_Dropped;
+			}
+		}
+
+		if( firstUnsentPacket >= numPackets )
+			return UDP_SEND_Sent;
+	}
+
+	UDPSendResult batchResult = UDP_SEND_Sent;
+	for( unsigned int packetIndex = firstUnsentPacket; packetIndex < numPackets; ++packetIndex )
+	{
+		//Reports the worst that happened to any of them
+		UDPSendResult result = SendPacketToClient( packetInfo + packetIndex * packetLength, packetLength, clientAddr, false );
+		if( result > batchResult )
+			batchResult = result;
+	}
+
+	return batchResult;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Called once a tick. Stops at the first packet the socket still can't take, since every client
+//shares the one send buffer and the rest would only fail the same way
+void UDPServer::FlushQueuedPackets()
+{
+	std::map< unsigned long long, OutboundQueue >::iterator queueIter = m_outboundQueues.begin();
+	while( queueIter != m_outboundQueues.end() )
+	{
+		OutboundQueue& queue = queueIter->second;
+		unsigned int packetBytes = 0;
+		while( const char* packet = queue.PeekPacket( packetBytes ) )
+		{
+			if( SendMessage( packet, packetBytes, queue.GetDestination() ) == UDP_SEND_WouldBlock )
+				return;
+
+			queue.PopPacket();
+			--m_numQueuedPackets;
+		}
+
+		m_outboundQueues.erase( queueIter++ );
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool UDPServer::HasQueuedPackets( const struct sockaddr_in& clientAddr ) const
+{
+	return m_outboundQueues.find( GetAddressKey( clientAddr ) ) != m_outboundQueues.end();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+UDPSendStats UDPServer::GetSendStats() const
+{
+	UDPSendStats stats;
+	stats.m_numQueuedPackets = m_numQueuedPackets;
+	stats.m_numQueuedClients = m_outboundQueues.size();
+	stats.m_numDroppedUnreliable = m_numDroppedUnreliable;
+	stats.m_numDroppedReliable = m_numDroppedReliable;
+	return stats;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Fragmented messages that timed out or lost their slot before every fragment arrived
+unsigned int UDPServer::GetNumberOfAbandonedMessages() const
+{
+	return m_reassembler.GetNumberOfAbandonedMessages();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Bytes sitting in the socket's receive buffer. Under registered I/O datagrams land straight in
+//the posted receive slots, so this only shows what has backed up past them
+unsigned int UDPServer::GetPendingReceiveBytes() const
+{
+	if( m_simulatedNetwork )
+		return 0;
+
+	u_long pendingBytes = 0;
+	if( ioctlsocket( m_socket, FIONREAD, &pendingBytes ) == SOCKET_ERROR )
+		return 0;
+
+	return pendingBytes;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Windows keeps no overflow count per socket, so this is the machine's count of UDP datagrams it
+//received but couldn't deliver, full receive buffers among them. It only ever goes up, and
+//callers watch how fast. There is nothing to read on a simulated network
+bool UDPServer::GetUDPReceiveErrors( unsigned int& out_numErrors ) const
+{
+	if( m_simulatedNetwork )
+		return false;
+
+	MIB_UDPSTATS udpStats;
+	if( GetUdpStatisticsEx( &udpStats, AF_INET ) != NO_ERROR )
+		return false;
+
+	out_numErrors = udpStats.dwInErrors;
 	return true;
 }
 
 
 //-----------------------------------------------------------------------------------------------
+//Fragments are collected until their message is whole, so this only returns complete packets
 bool UDPServer::ReceivePacketFromClient( char* out_packetInfo, int packetLength, struct sockaddr_in& out_clientAddr, int& out_clientLen )
 {
-	if( recvfrom( m_socket, out_packetInfo, packetLength, 0, (struct sockaddr*) &out_clientAddr, &out_clientLen ) < 0 )
+	for( ;; )
 	{
-		return false;
+		int datagramBytes = 0;
+		const char* datagram = ReceiveDatagram( datagramBytes, out_clientAddr, out_clientLen );
+		if( !datagram )
+		{
+			return false;
+		}
+
+		const char* message = datagram;
+		unsigned int messageBytes = datagramBytes;
+		if( datagramBytes > 0 && (unsigned char) datagram[ 0 ] == FRAGMENT_PACKET_TYPE )
+		{
+			message = m_reassembler.AddFragment( GetAddressKey( out_clientAddr ), datagram, datagramBytes, GetCurrentTimeSeconds(), messageBytes );
+			if( !message )
+			{
+				out_clientLen = sizeof( out_clientAddr );
+				continue;
+			}
+		}
+
+		if( messageBytes > (unsigned int) packetLength )
+			messageBytes = packetLength;
+
+		memcpy( out_packetInfo, message, messageBytes );
+		return true;
 	}
+}
 
-	return true;
+
+//-----------------------------------------------------------------------------------------------
+//Packets that fit in one datagram go out untouched, and anything bigger is split into fragments
+UDPSendResult UDPServer::SendMessage( const char* packetInfo, int packetLength, const struct sockaddr_in& clientAddr )
+{
+	if( (unsigned int) packetLength <= m_maxDatagramBytes )
+		return SendDatagram( packetInfo, packetLength, clientAddr );
+
+	unsigned int numFragments = GetNumberOfFragments( packetLength, m_maxDatagramBytes );
+	if( numFragments == 0 )
+		return UDP_SEND_Dropped;
+
+	unsigned short messageID = m_nextMessageID;
+	++m_nextMessageID;
+
+	//Every fragment but the last fills a whole datagram, so the kernel can split them back out
+	if( m_isSendOffloadEnabled )
+	{
+		unsigned int totalBytes = 0;
+		for( unsigned int fragmentIndex = 0; fragmentIndex < numFragments; ++fragmentIndex )
+		{
+			totalBytes += BuildFragment( packetInfo, packetLength, messageID, fragmentIndex, m_maxDatagramBytes, &m_segmentBuffer[ totalBytes ] );
+		}
+
+		return SendSegmentedDatagrams( &m_segmentBuffer[ 0 ], totalBytes, m_maxDatagramBytes, clientAddr );
+	}
+
+	//A message cut off partway is sent again whole under a new id, and the receiver lets the
+	//fragments it already has expire
+	for( unsigned int fragmentIndex = 0; fragmentIndex < numFragments; ++fragmentIndex )
+	{
+		unsigned int datagramBytes = BuildFragment( packetInfo, packetLength, messageID, fragmentIndex, m_maxDatagramBytes, m_fragmentBuffer );
+		UDPSendResult result = SendDatagram( m_fragmentBuffer, datagramBytes, clientAddr );
+		if( result != UDP_SEND_Sent )
+			return result;
+	}
+
+	return UDP_SEND_Sent;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Registered I/O hands the datagram back in its own buffer, so only the plain path copies it out
+const char* UDPServer::ReceiveDatagram( int& out_datagramBytes, struct sockaddr_in& out_clientAddr, int& out_clientLen )
+{
+	if( m_simulatedNetwork )
+	{
+		unsigned int datagramBytes = 0;
+		ClientInfo source;
+		if( !m_simulatedNetwork->ReceiveDatagram( m_simulatedEndpoint, m_receiveBuffer, sizeof( m_receiveBuffer ), datagramBytes, source, GetCurrentTimeSeconds() ) )
+			return nullptr;
+
+		out_clientAddr.sin_family = AF_INET;
+		out_clientAddr.sin_addr.s_addr = source.m_ipAddress;
+		out_clientAddr.sin_port = source.m_portNumber;
+		out_clientLen = sizeof( out_clientAddr );
+		out_datagramBytes = datagramBytes;
+		return m_receiveBuffer;
+	}
+
+	if( m_registeredIO.IsInitialized() )
+		return m_registeredIO.ReceiveDatagram( out_datagramBytes, out_clientAddr );
+
+	if( m_receiveMessage )
+		return ReceiveCoalescedDatagram( out_datagramBytes, out_clientAddr, out_clientLen );
+
+	out_datagramBytes = recvfrom( m_socket, m_receiveBuffer, sizeof( m_receiveBuffer ), 0, (struct sockaddr*) &out_clientAddr, &out_clientLen );
+	if( out_datagramBytes < 0 )
+		return nullptr;
+
+	return m_receiveBuffer;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//The simulated network never pushes back, it just loses what it would have dropped
+UDPSendResult UDPServer::SendDatagram( const char* datagram, int datagramBytes, const struct sockaddr_in& clientAddr )
+{
+	if( m_simulatedNetwork )
+	{
+		ClientInfo destination;
+		destination.m_ipAddress = clientAddr.sin_addr.s_addr;
+		destination.m_portNumber = clientAddr.sin_port;
+		m_simulatedNetwork->SendDatagram( m_simulatedEndpoint, destination, datagram, datagramBytes, GetCurrentTimeSeconds() );
+		return UDP_SEND_Sent;
+	}
+
+	//Registered I/O only refuses a send when every send slot is still in flight
+	if( m_registeredIO.IsInitialized() )
+		return m_registeredIO.SendDatagram( datagram, datagramBytes, clientAddr ) ? UDP_SEND_Sent : UDP_SEND_WouldBlock;
+
+	if( sendto( m_socket, datagram, datagramBytes, 0, (struct sockaddr*) &clientAddr, sizeof( clientAddr ) ) < 0 )
+	{
+		return GetResultOfFailedSend();
+	}
+
+	return UDP_SEND_Sent;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//A full send buffer is worth waiting out, anything else won't get better by trying again
+UDPSendResult UDPServer::GetResultOfFailedSend() const
+{
+	int error = WSAGetLastError();
+	if( error == WSAEWOULDBLOCK || error == WSAENOBUFS )
+		return UDP_SEND_WouldBlock;
+
+	return UDP_SEND_Dropped;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//A full queue makes room by dropping its oldest unreliable packet, since a newer one will replace
+//it anyway. Only once nothing unreliable is left does the new packet itself get dropped
+UDPSendResult UDPServer::QueuePacket( const char* packetInfo, int packetLength, const struct sockaddr_in& clientAddr, bool isReliable )
+{
+	std::map< unsigned long long, OutboundQueue >::iterator queueIter = m_outboundQueues.find( GetAddressKey( clientAddr ) );
+	if( queueIter == m_outboundQueues.end() )
+	{
+		queueIter = m_outboundQueues.insert( std::make_pair( GetAddressKey( clientAddr ), OutboundQueue() ) ).first;
+		queueIter->second.Initialize( clientAddr );
+	}
+
+	OutboundQueue& queue = queueIter->second;
+	if( queue.IsFull() )
+	{
+		if( queue.RemoveOldestUnreliablePacket() )
+		{
+			++m_numDroppedUnreliable;
+			--m_numQueuedPackets;
+		}
+	}
+
+	if( !queue.PushPacket( packetInfo, packetLength, isReliable ) )
+	{
+		if( isReliable )
+			++m_numDroppedReliable;
+		else
+			++m_numDroppedUnreliable;
+
+		if( queue.IsEmpty() )
+			m_outboundQueues.erase( queueIter );
+
+		return UDP_SEND_Dropped;
+	}
+
+	++m_numQueuedPackets;
+	return UDP_SEND_Queued;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Failures are ignored, the OS just keeps its own sizes
+void UDPServer::ApplySocketBufferSizes()
+{
+	if( g_sendBufferBytes > 0 )
+		setsockopt( m_socket, SOL_SOCKET, SO_SNDBUF, (const char*) &g_sendBufferBytes, sizeof( g_sendBufferBytes ) );
+
+	if( g_receiveBufferBytes > 0 )
+		setsockopt( m_socket, SOL_SOCKET, SO_RCVBUF, (const char*) &g_receiveBufferBytes, sizeof( g_receiveBufferBytes ) );
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Stays off unless the OS knows the send segmentation option
+void UDPServer::EnableSendOffload()
+{
+	DWORD segmentBytes = 0;
+	int optionBytes = sizeof( segmentBytes );
+	if( getsockopt( m_socket, IPPROTO_UDP, UDP_SEND_MSG_SIZE, (char*) &segmentBytes, &optionBytes ) != 0 )
+		return;
+
+	m_segmentBuffer.resize( MAX_OFFLOADED_SEND_BYTES );
+	m_isSendOffloadEnabled = true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//Coalescing is only turned on once there is a way to read back the segment size it reports
+void UDPServer::EnableReceiveOffload()
+{
+	GUID receiveMessageID = WSAID_WSARECVMSG;
+	LPFN_WSARECVMSG receiveMessage = nullptr;
+	DWORD bytesReturned = 0;
+	if( WSAIoctl( m_socket, SIO_GET_EXTENSION_FUNCTION_POINTER, &receiveMessageID, sizeof( receiveMessageID ), &receiveMessage, sizeof( receiveMessage ), &bytesReturned, NULL, NULL ) != 0 )
+		return;
+
+	DWORD maxCoalescedBytes = MAX_COALESCED_RECEIVE_BYTES;
+	if( setsockopt( m_socket, IPPROTO_UDP, UDP_RECV_MAX_COALESCED_SIZE, (const char*) &maxCoalescedBytes, sizeof( maxCoalescedBytes ) ) != 0 )
+		return;
+
+	m_coalescedBuffer.resize( MAX_COALESCED_RECEIVE_BYTES );
+	m_receiveMessage = receiveMessage;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//One call for the whole run, with the segment size passed alongside. Only the last segment may
+//be shorter than the rest
+UDPSendResult UDPServer::SendSegmentedDatagrams( const char* datagrams, unsigned int totalBytes, unsigned int segmentBytes, const struct sockaddr_in& clientAddr )
+{
+	WSABUF dataBuffer;
+	dataBuffer.buf = (CHAR*) datagrams;
+	dataBuffer.len = totalBytes;
+
+	unsigned long long controlBuffer[ UDP_CONTROL_BUFFER_BYTES / sizeof( unsigned long long ) ];
+	memset( controlBuffer, 0, sizeof( controlBuffer ) );
+
+	WSAMSG message;
+	memset( &message, 0, sizeof( message ) );
+	message.name = (LPSOCKADDR) &clientAddr;
+	message.namelen = sizeof( clientAddr );
+	message.lpBuffers = &dataBuffer;
+	message.dwBufferCount = 1;
+	message.Control.buf = (CHAR*) controlBuffer;
+	message.Control.len = WSA_CMSG_SPACE( sizeof( DWORD ) );
+
+	WSACMSGHDR* controlHeader = WSA_CMSG_FIRSTHDR( &message );
+	controlHeader->cmsg_level = IPPROTO_UDP;
+	controlHeader->cmsg_type = UDP_SEND_MSG_SIZE;
+	controlHeader->cmsg_len = WSA_CMSG_LEN( sizeof( DWORD ) );
+	*(DWORD*) WSA_CMSG_DATA( controlHeader ) = segmentBytes;
+
+	DWORD bytesSent = 0;
+	if( WSASendMsg( m_socket, &message, 0, &bytesSent, NULL, NULL ) != 0 )
+	{
+		return GetResultOfFailedSend();
+	}
+
+	return UDP_SEND_Sent;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+//A coalesced receive holds several datagrams from one sender back to back, all but the last of
+//the size reported alongside it, and they are handed out one per call
+const char* UDPServer::ReceiveCoalescedDatagram( int& out_datagramBytes, struct sockaddr_in& out_clientAddr, int& out_clientLen )
+{
+	if( m_coalescedOffset >= m_coalescedBytes )
+	{
+		WSABUF dataBuffer;
+		dataBuffer.buf = &m_coalescedBuffer[ 0 ];
+		dataBuffer.len = m_coalescedBuffer.size();
+
+		unsigned long long controlBuffer[ UDP_CONTROL_BUFFER_BYTES / sizeof( unsigned long long ) ];
+
+		WSAMSG message;
+		memset( &message, 0, sizeof( message ) );
+		message.name = (LPSOCKADDR) &m_coalescedSource;
+		message.namelen = sizeof( m_coalescedSource );
+		message.lpBuffers = &dataBuffer;
+		message.dwBufferCount = 1;
+		message.Control.buf = (CHAR*) controlBuffer;
+		message.Control.len = sizeof( controlBuffer );
+
+		DWORD bytesReceived = 0;
+		if( m_receiveMessage( m_socket, &message, &bytesReceived, NULL, NULL ) != 0 )
+			return nullptr;
+
+		m_coalescedOffset = 0;
+		m_coalescedBytes = bytesReceived;
+		m_coalescedSegmentBytes = bytesReceived;
+		for( WSACMSGHDR* controlHeader = WSA_CMSG_FIRSTHDR( &message ); controlHeader; controlHeader = WSA_CMSG_NXTHDR( &message, controlHeader ) )
+		{
+			if( controlHeader->cmsg_level == IPPROTO_UDP && controlHeader->cmsg_type == UDP_COALESCED_INFO )
+				m_coalescedSegmentBytes = *(DWORD*) WSA_CMSG_DATA( controlHeader );
+		}
+
+		if( m_coalescedSegmentBytes == 0 )
+			m_coalescedSegmentBytes = m_coalescedBytes;
+
+		//An empty datagram is still a datagram
+		if( m_coalescedBytes == 0 )
+		{
+			out_datagramBytes = 0;
+			out_clientAddr = m_coalescedSource;
+			out_clientLen = sizeof( out_clientAddr );
+			return &m_coalescedBuffer[ 0 ];
+		}
+	}
+
+	unsigned int datagramBytes = m_coalescedBytes - m_coalescedOffset;
+	if( datagramBytes > m_coalescedSegmentBytes )
+		datagramBytes = m_coalescedSegmentBytes;
+
+	const char* datagram = &m_coalescedBuffer[ m_coalescedOffset ];
+	m_coalescedOffset += datagramBytes;
+
+	out_datagramBytes = datagramBytes;
+	out_clientAddr = m_coalescedSource;
+	out_clientLen = sizeof( out_clientAddr );
+	return datagram;
 }
\ No newline at end of file
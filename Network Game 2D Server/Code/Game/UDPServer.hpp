@@ -3,24 +3,125 @@
 #pragma once
 
 //-----------------------------------------------------------------------------------------------
+#include <map>
+#include <vector>
 #include <WinSock2.h>
+#include "RegisteredIO.hpp"
+#include "Fragmentation.hpp"
+#include "MemoryNetwork.hpp"
+#include "OutboundQueue.hpp"
 #pragma comment(lib,"ws2_32.lib")
+#pragma comment(lib,"iphlpapi.lib")
+
+
+//-----------------------------------------------------------------------------------------------
+const unsigned int MAX_OFFLOADED_SEND_BYTES = 65000;
+const unsigned int MAX_COALESCED_RECEIVE_BYTES = 65535;
+const unsigned int UDP_CONTROL_BUFFER_BYTES = 64;
+
+
+//-----------------------------------------------------------------------------------------------
+enum UDPBackend
+{
+	UDP_BACKEND_Sockets,
+	UDP_BACKEND_RegisteredIO,
+};
+
+
+//-----------------------------------------------------------------------------------------------
+enum UDPOffload
+{
+	UDP_OFFLOAD_Send = 1,
+	UDP_OFFLOAD_Receive = 2,
+};
+
+
+//-----------------------------------------------------------------------------------------------
+enum UDPSendResult
+{
+	UDP_SEND_Sent,
+	UDP_SEND_Queued,
+	UDP_SEND_Dropped,
+	UDP_SEND_WouldBlock,
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct UDPSendStats
+{
+	unsigned int		m_numQueuedPackets;
+	unsigned int		m_numQueuedClients;
+	unsigned long long	m_numDroppedUnreliable;
+	unsigned long long	m_numDroppedReliable;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+void SetPreferredUDPBackend( UDPBackend backend );
+void SetPreferredUDPOffloads( unsigned int offloadFlags );
+void SetPreferredMTU( unsigned int mtuBytes );
+void SetSimulatedNetwork( MemoryNetwork* network );
+void SetSocketBufferSizes( int sendBufferBytes, int receiveBufferBytes );
 
 
 //-----------------------------------------------------------------------------------------------
 class UDPServer
 {
 public:
-	UDPServer() {}
+	UDPServer();
 	bool StartServer( unsigned short desiredPortNumber );
 	void EndServer();
-	bool SendPacketToClient( const char* packetInfo, int packetLength, const struct sockaddr_in& clientAddr );
+	bool IsUsingRegisteredIO() const;
+	unsigned int GetEnabledOffloads() const;
+	bool IsSimulated() const;
+	void SetMTU( unsigned int mtuBytes );
+	unsigned int GetMaxDatagramBytes() const;
+	bool WaitForPacketFromClient( long timeoutMicroseconds );
+	UDPSendResult SendPacketToClient( const char* packetInfo, int packetLength, const struct sockaddr_in& clientAddr, bool isReliable );
+	UDPSendResult SendPacketsToClient( const char* packetInfo, int packetLength, unsigned int numPackets, const struct sockaddr_in& clientAddr );
+	void FlushQueuedPackets();
+	bool HasQueuedPackets( const struct sockaddr_in& clientAddr ) const;
+	UDPSendStats GetSendStats() const;
+	unsigned int GetNumberOfAbandonedMessages() const;
+	unsigned int GetPendingReceiveBytes() const;
+	bool GetUDPReceiveErrors( unsigned int& out_numErrors ) const;
 	bool ReceivePacketFromClient( char* out_packetInfo, int packetLength, struct sockaddr_in& out_clientAddr, int& out_clientLen );
 
 private:
+	const char* ReceiveDatagram( int& out_datagramBytes, struct sockaddr_in& out_clientAddr, int& out_clientLen );
+	UDPSendResult SendMessage( const char* packetInfo, int packetLength, const struct sockaddr_in& clientAddr );
+	UDPSendResult SendDatagram( const char* datagram, int datagramBytes, const struct sockaddr_in& clientAddr );
+	UDPSendResult GetResultOfFailedSend() const;
+	UDPSendResult QueuePacket( const char* packetInfo, int packetLength, const struct sockaddr_in& clientAddr, bool isReliable );
+	void ApplySocketBufferSizes();
+	void EnableSendOffload();
+	void EnableReceiveOffload();
+	UDPSendResult SendSegmentedDatagrams( const char* datagrams, unsigned int totalBytes, unsigned int segmentBytes, const struct sockaddr_in& clientAddr );
+	const char* ReceiveCoalescedDatagram( int& out_datagramBytes, struct sockaddr_in& out_clientAddr, int& out_clientLen );
+
 	WSADATA				m_wsaData;
 	SOCKET				m_socket;
 	struct sockaddr_in	m_serverAddr;
+	unsigned int		m_maxDatagramBytes;
+	unsigned short		m_nextMessageID;
+	MessageReassembler	m_reassembler;
+	RegisteredIOSocket	m_registeredIO;
+	bool				m_isSendOffloadEnabled;
+	std::vector< char >	m_segmentBuffer;
+	LPFN_WSARECVMSG		m_receiveMessage;
+	std::vector< char >	m_coalescedBuffer;
+	unsigned int		m_coalescedOffset;
+	unsigned int		m_coalescedBytes;
+	unsigned int		m_coalescedSegmentBytes;
+	struct sockaddr_in	m_coalescedSource;
+	MemoryNetwork*		m_simulatedNetwork;
+	unsigned int		m_simulatedEndpoint;
+	std::map< unsigned long long, OutboundQueue >	m_outboundQueues;
+	unsigned int		m_numQueuedPackets;
+	unsigned long long	m_numDroppedUnreliable;
+	unsigned long long	m_numDroppedReliable;
+	char				m_receiveBuffer[ MAX_DATAGRAM_BYTES ];
+	char				m_fragmentBuffer[ MAX_DATAGRAM_BYTES ];
 };
 
 
@@ -1,5 +1,13 @@
 //-----------------------------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include <mmsystem.h>
 #include "Lobby.hpp"
+#include "Simulation.hpp"
+#include "QueueBenchmark.hpp"
+#include "LoopbackBenchmark.hpp"
+#pragma comment(lib,"winmm.lib")
 
 
 //-----------------------------------------------------------------------------------------------
@@ -8,14 +16,112 @@ Lobby g_lobby;
 
 
 //-----------------------------------------------------------------------------------------------
-int main( int, char* )
+//Pass -rio to run every socket on Windows Registered I/O where the OS supports it, and -uso or
+//-uro to ask for UDP send segmentation or receive coalescing on the plain socket path, and -tsc to
+//read time from the CPU's cycle counter where it runs at a constant rate. -sndbuf and -rcvbuf
+//set the socket buffer sizes in bytes, -mtu the path MTU messages are fragmented to fit, and
+//-parityloss the percentage of lost packets above which a client's reliable packets are sent with
+//parity. Pass -simulate to run against simulated clients on virtual time instead, sized by
+//-clients, -seconds and -seed, -benchqueue to time the games' inbound packet queue against a
+//locked one and exit, -benchfrag to time loopback messages of each size and exit, -benchrecv to
+//compare receiving on plain recvfrom and on registered I/O and exit, or -benchoffload to compare
+//a snapshot fan-out with and without send and receive offloads and exit
+int main( int argc, char* argv[] )
 {
+	unsigned int offloadFlags = 0;
+	int sendBufferBytes = 0;
+	int receiveBufferBytes = 0;
+	bool isSimulating = false;
+	bool isBenchmarkingQueue = false;
+	bool isBenchmarkingFragments = false;
+	bool isBenchmarkingReceive = false;
+	bool isBenchmarkingOffloads = false;
+	SimulationSettings simulationSettings;
+	for( int argIndex = 1; argIndex < argc; ++argIndex )
+	{
+		bool hasValue = ( argIndex + 1 < argc );
+		if( strcmp( argv[ argIndex ], "-rio" ) == 0 )
+			SetPreferredUDPBackend( UDP_BACKEND_RegisteredIO );
+		else if( strcmp( argv[ argIndex ], "-uso" ) == 0 )
+			offloadFlags |= UDP_OFFLOAD_Send;
+		else if( strcmp( argv[ argIndex ], "-uro" ) == 0 )
+			offloadFlags |= UDP_OFFLOAD_Receive;
+		else if( strcmp( argv[ argIndex ], "-tsc" ) == 0 )
+		{
+			if( !SetTimeCounter( TIME_COUNTER_Cycle ) )
+				std::cout << "No invariant cycle counter, staying on the performance counter\n";
+		}
+		else if( strcmp( argv[ argIndex ], "-sndbuf" ) == 0 && hasValue )
+			sendBufferBytes = atoi( argv[ ++argIndex ] );
+		else if( strcmp( argv[ argIndex ], "-rcvbuf" ) == 0 && hasValue )
+			receiveBufferBytes = atoi( argv[ ++argIndex ] );
+		else if( strcmp( argv[ argIndex ], "-mtu" ) == 0 && hasValue )
+			SetPreferredMTU( (unsigned int) atoi( argv[ ++argIndex ] ) );
+		else if( strcmp( argv[ argIndex ], "-parityloss" ) == 0 && hasValue )
+			SetParityLossThreshold( (float) atof( argv[ ++argIndex ] ) * 0.01f );
+		else if( strcmp( argv[ argIndex ], "-simulate" ) == 0 )
+			isSimulating = true;
+		else if( strcmp( argv[ argIndex ], "-benchqueue" ) == 0 )
+			isBenchmarkingQueue = true;
+		else if( strcmp( argv[ argIndex ], "-benchfrag" ) == 0 )
+			isBenchmarkingFragments = true;
+		else if( strcmp( argv[ argIndex ], "-benchrecv" ) == 0 )
+			isBenchmarkingReceive = true;
+		else if( strcmp( argv[ argIndex ], "-benchoffload" ) == 0 )
+			isBenchmarkingOffloads = true;
+		else if( strcmp( argv[ argIndex ], "-clients" ) == 0 && hasValue )
+			simulationSettings.m_numClients = (unsigned int) atoi( argv[ ++argIndex ] );
+		else if( strcmp( argv[ argIndex ], "-seconds" ) == 0 && hasValue )
+			simulationSettings.m_durationSeconds = atof( argv[ ++argIndex ] );
+		else if( strcmp( argv[ argIndex ], "-seed" ) == 0 && hasValue )
+			simulationSettings.m_randomSeed = (unsigned int) atoi( argv[ ++argIndex ] );
+	}
+
+	SetPreferredUDPOffloads( offloadFlags );
+	SetSocketBufferSizes( sendBufferBytes, receiveBufferBytes );
+
+	if( isBenchmarkingQueue )
+	{
+		RunQueueBenchmark();
+		return 0;
+	}
+
+	if( isBenchmarkingFragments )
+	{
+		RunFragmentBenchmark();
+		return 0;
+	}
+
+	if( isBenchmarkingReceive )
+	{
+		RunReceiveBenchmark();
+		return 0;
+	}
+
+	if( isBenchmarkingOffloads )
+	{
+		RunOffloadBenchmark();
+		return 0;
+	}
+
+	if( isSimulating )
+	{
+		RunSimulation( g_lobby, simulationSettings );
+		return 0;
+	}
+
 	g_lobby.Initalize();
 
+	//Waits are timed in milliseconds, so ask for a timer that actually wakes up that often
+	timeBeginPeriod( 1 );
+
 	while( !g_isQuitting )
 	{
 		g_lobby.Update();
+		g_lobby.WaitForNextUpdate();
 	}
 
+	timeEndPeriod( 1 );
+
 	return 0;
 }
\ No newline at end of file